@@ -13,26 +13,91 @@
 #include "call_signature.hpp"
 
 namespace call_signature {
-    call_signature::call_signature() : bytes_on_stack(0) {}
+    namespace {
+        enum reg_t { INT, FLOAT };
+
+        /**
+         * @brief Lists the 8-byte scalar slots of a value, in memory order.
+         *
+         * @param r_type The type of the value.
+         * @param offset The byte offset of the value within the outermost value.
+         * @param slots The list to append {offset, register class} pairs to.
+         */
+        void scalar_slots(const std::shared_ptr<resolved_type::resolved_type>& r_type, long offset,
+                          std::vector<std::pair<long, reg_t>>& slots) {
+            constexpr long reg_size = 8;
+
+            switch (r_type->type) {
+                case resolved_type::BOOL_TYPE:
+                case resolved_type::INT_TYPE:
+                    slots.emplace_back(offset, reg_t::INT);
+                    break;
+                case resolved_type::FLOAT_TYPE:
+                    slots.emplace_back(offset, reg_t::FLOAT);
+                    break;
+                case resolved_type::ARRAY_TYPE:
+                    //  The dimensions, then the data pointer.
+                    for (long slot = 0; slot < (long)(r_type->size() / reg_size); ++slot) {
+                        slots.emplace_back(offset + slot * reg_size, reg_t::INT);
+                    }
+                    break;
+                case resolved_type::TUPLE_TYPE: {
+                    const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
+                            = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(r_type);
+                    for (unsigned int index = 0; index < tuple_type->element_types.size(); ++index) {
+                        scalar_slots(tuple_type->element_types[index], offset + (long)tuple_type->offset(index),
+                                     slots);
+                    }
+                    break;
+                }
+            }
+        }
+    }  //  namespace
+
+    call_signature::call_signature() : bytes_on_stack(0), struct_return(false) {}
 
     call_signature::call_signature(const std::vector<std::shared_ptr<resolved_type::resolved_type>>& arg_types,
-                                   const std::shared_ptr<resolved_type::resolved_type>& ret_type)
-        : bytes_on_stack(0), ret_type(ret_type) {
+                                   const std::shared_ptr<resolved_type::resolved_type>& ret_type,
+                                   bool private_convention)
+        : bytes_on_stack(0), ret_type(ret_type), struct_return(false) {
         unsigned int total_ints = 0;
         unsigned int total_floats = 0;
 
-        enum reg_t { INT, FLOAT };
-
-        std::vector<std::tuple<unsigned int, reg_t, std::string>> reg_args;
+        std::vector<std::tuple<unsigned int, long, register_list>> reg_args;
         std::vector<long> stack_arg_indices;
 
-        bool struct_ret_type = this->ret_type->type == resolved_type::ARRAY_TYPE;
-        if (this->ret_type->type == resolved_type::TUPLE_TYPE) {
-            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
-                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(this->ret_type);
-            if (!tuple_type->element_types.empty()) { struct_ret_type = true; }
+        const bool aggregate_ret_type = this->ret_type->type == resolved_type::ARRAY_TYPE
+                                     || (this->ret_type->type == resolved_type::TUPLE_TYPE
+                                         && !std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(
+                                                     this->ret_type)
+                                                     ->element_types.empty());
+        if (aggregate_ret_type) {
+            this->struct_return = true;
+
+            if (private_convention) {
+                const std::vector<std::string> int_ret_regs = {"rax", "rdx"};
+                const std::vector<std::string> float_ret_regs = {"xmm0", "xmm1"};
+
+                std::vector<std::pair<long, reg_t>> slots;
+                scalar_slots(this->ret_type, 0, slots);
+
+                unsigned int ret_ints = 0;
+                unsigned int ret_floats = 0;
+                register_list registers;
+                for (const std::pair<long, reg_t>& slot : slots) {
+                    if (slot.second == reg_t::INT && ret_ints < int_ret_regs.size()) {
+                        registers.emplace_back(slot.first, int_ret_regs[ret_ints++]);
+                    } else if (slot.second == reg_t::FLOAT && ret_floats < float_ret_regs.size()) {
+                        registers.emplace_back(slot.first, float_ret_regs[ret_floats++]);
+                    }
+                }
+                if (!slots.empty() && registers.size() == slots.size()) {
+                    this->struct_return = false;
+                    this->ret_registers = registers;
+                }
+            }
         }
-        if (struct_ret_type) { ++total_ints; }
+        if (this->struct_return) { ++total_ints; }
 
         const std::vector<std::string> int_regs = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
         const std::vector<std::string> float_regs = {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"};
@@ -41,36 +106,50 @@ namespace call_signature {
             const std::shared_ptr<resolved_type::resolved_type>& arg_type = arg_types[arg_index];
 
             bool is_reg = false;
-            std::string reg_name;
-            reg_t reg_type;
+            register_list registers;
             switch (arg_type->type) {
                 case resolved_type::BOOL_TYPE:
                 case resolved_type::INT_TYPE:
                     if (++total_ints <= int_regs.size()) {
                         is_reg = true;
-                        reg_name = int_regs[total_ints - 1];
-                        reg_type = reg_t::INT;
+                        registers.emplace_back(0, int_regs[total_ints - 1]);
                     }
                     break;
                 case resolved_type::FLOAT_TYPE:
                     if (++total_floats <= float_regs.size()) {
                         is_reg = true;
-                        reg_name = float_regs[total_floats - 1];
-                        reg_type = reg_t::FLOAT;
+                        registers.emplace_back(0, float_regs[total_floats - 1]);
                     }
                     break;
                 case resolved_type::ARRAY_TYPE:
-                case resolved_type::TUPLE_TYPE:
+                case resolved_type::TUPLE_TYPE: {
+                    if (!private_convention || arg_type->size() == 0) break;
+
+                    std::vector<std::pair<long, reg_t>> slots;
+                    scalar_slots(arg_type, 0, slots);
+                    if (slots.size() > max_register_slots) break;
+
+                    unsigned int ints = 0;
+                    unsigned int floats = 0;
+                    for (const std::pair<long, reg_t>& slot : slots) { ++(slot.second == reg_t::INT ? ints : floats); }
+                    if (total_ints + ints > int_regs.size() || total_floats + floats > float_regs.size()) break;
+
+                    for (const std::pair<long, reg_t>& slot : slots) {
+                        registers.emplace_back(slot.first, slot.second == reg_t::INT ? int_regs[total_ints++]
+                                                                                     : float_regs[total_floats++]);
+                    }
+                    is_reg = true;
                     break;
+                }
             }
             if (is_reg) {
-                reg_args.emplace_back(arg_index, reg_type, reg_name);
+                reg_args.emplace_back(arg_index, (long)arg_type->size(), registers);
             } else {
                 stack_arg_indices.emplace_back(arg_index);
                 this->bytes_on_stack += arg_type->size();
                 this->stack_args.emplace_back(arg_type->size());
             }
-            this->all_args.emplace_back(arg_type, is_reg, reg_name);
+            this->all_args.emplace_back(arg_type, is_reg, registers);
         }
 
         for (int index = (int)stack_arg_indices.size() - 1; index >= 0; --index) {
@@ -81,15 +160,25 @@ namespace call_signature {
             this->push_order.emplace_back(std::get<0>(reg_args[index]));
         }
 
-        for (const std::tuple<unsigned int, reg_t, std::string>& reg_arg : reg_args) {
-            switch (std::get<1>(reg_arg)) {
-                case INT:
-                    this->pop_assem.emplace_back("\tpop " + std::get<2>(reg_arg) + "\n");
-                    break;
-                case FLOAT:
-                    this->pop_assem.emplace_back("\tmovsd " + std::get<2>(reg_arg) + ", [rsp]\n" + "\tadd rsp, 8\n");
-                    break;
+        for (const std::tuple<unsigned int, long, register_list>& reg_arg : reg_args) {
+            const register_list& registers = std::get<2>(reg_arg);
+            if (registers.size() == 1 && std::get<1>(reg_arg) == 8) {
+                const std::string& reg = registers[0].second;
+                if (reg.rfind("xmm", 0) == 0) {
+                    this->pop_assem.emplace_back("\tmovsd " + reg + ", [rsp]\n" + "\tadd rsp, 8\n");
+                } else {
+                    this->pop_assem.emplace_back("\tpop " + reg + "\n");
+                }
+                continue;
+            }
+
+            std::stringstream assem;
+            for (const std::pair<long, std::string>& reg : registers) {
+                assem << "\t" << (reg.second.rfind("xmm", 0) == 0 ? "movsd " : "mov ") << reg.second << ", [rsp + "
+                      << reg.first << "]\n";
             }
+            assem << "\tadd rsp, " << std::get<1>(reg_arg) << "\n";
+            this->pop_assem.emplace_back(assem.str());
         }
     }
 }  //  namespace call_signature
@@ -10,6 +10,8 @@
 #define CALL_SIGNATURE_HPP
 
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "ast_node/ast_node.hpp"
@@ -21,12 +23,19 @@ namespace call_signature {
      *
      */
     struct call_signature {
+        /**
+         * @brief A list of registers holding one value, encoded as {byte offset within the value, register}.
+         *
+         */
+        typedef std::vector<std::pair<long, std::string>> register_list;
+
         /**
          * @brief The list of all arguments, in the order to save.
-         * @details Each argument is encoded as a tuple of {resolved_type, is_register, register}.
+         * @details Each argument is encoded as a tuple of {resolved_type, is_register, registers}. Scalars use one
+         *     register at offset 0; under the private convention, arrays and tuples may be split across several.
          *
          */
-        std::vector<std::tuple<std::shared_ptr<resolved_type::resolved_type>, bool, std::string>> all_args;
+        std::vector<std::tuple<std::shared_ptr<resolved_type::resolved_type>, bool, register_list>> all_args;
 
         /**
          * @brief The number of bytes that will be pushed onto the stack to call this function.
@@ -60,6 +69,24 @@ namespace call_signature {
          */
         std::shared_ptr<resolved_type::resolved_type> ret_type;
 
+        /**
+         * @brief Whether the caller passes the address for the return value in `rdi`.
+         *
+         */
+        bool struct_return;
+
+        /**
+         * @brief The registers holding an array or tuple return value, when it is not returned through memory.
+         *
+         */
+        register_list ret_registers;
+
+        /**
+         * @brief The largest number of registers an array or tuple may be split across under the private convention.
+         *
+         */
+        static constexpr unsigned int max_register_slots = 4;
+
         /**
          * @brief Default constructor.
          *
@@ -68,12 +95,17 @@ namespace call_signature {
 
         /**
          * @brief Class constructor.
+         * @details The default is the System V convention, which the runtime functions expect. The private convention
+         *     is only used between JPL functions. It additionally passes array headers and tuples of up to
+         *     `max_register_slots` scalars in registers, when enough registers remain, and returns arrays and tuples in
+         *     `rax`/`rdx` and `xmm0`/`xmm1` when they fit.
          *
          * @param arg_types The types of the arguments to be passed to the function.
          * @param ret_type The return type of the function.
+         * @param private_convention Whether to use the private convention for JPL functions.
          */
         call_signature(const std::vector<std::shared_ptr<resolved_type::resolved_type>>& arg_types,
-                       const std::shared_ptr<resolved_type::resolved_type>& ret_type);
+                       const std::shared_ptr<resolved_type::resolved_type>& ret_type, bool private_convention = false);
     };
 }  //  namespace call_signature
 
@@ -0,0 +1,36 @@
+#  Compiles one regression program and compares the specialized clones in its assembly with its `.clones` file.
+#
+#  Expects the following variables:
+#  - JPLC:     The compiler.
+#  - PROGRAM:  The `.jpl` file to test.
+#  - FLAGS:    The flags with which to compile the program, separated by spaces.
+
+get_filename_component(name "${PROGRAM}" NAME_WE)
+get_filename_component(directory "${PROGRAM}" DIRECTORY)
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+
+execute_process(COMMAND "${JPLC}" -s ${flags} "${PROGRAM}"
+                OUTPUT_VARIABLE assembly
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "jplc failed on ${PROGRAM} with `${FLAGS}`")
+endif()
+
+#  Clones are labeled `_<function>.spec<n>`; the order in which they are generated does not matter.
+string(REGEX MATCHALL "\n_[A-Za-z0-9_]+\\.spec[0-9]+:" labels "${assembly}")
+set(actual "")
+foreach(label ${labels})
+    string(REGEX REPLACE "^\n(.*):$" "\\1" label "${label}")
+    list(APPEND actual "${label}")
+endforeach()
+list(SORT actual)
+
+file(STRINGS "${directory}/${name}.clones" expected)
+list(SORT expected)
+
+if(NOT actual STREQUAL expected)
+    string(REPLACE ";" " " actual "${actual}")
+    string(REPLACE ";" " " expected "${expected}")
+    message(FATAL_ERROR "${PROGRAM} with `${FLAGS}` emits the clones [${actual}], but ${name}.clones lists "
+                        "[${expected}]")
+endif()
@@ -0,0 +1,50 @@
+#  Compiles, assembles, links, and runs one regression program, and compares what it prints with its `.out` file.
+#
+#  Expects the following variables:
+#  - JPLC:         The compiler.
+#  - NASM:         The assembler.
+#  - LINKER:       The C compiler used to link the program against the runtime.
+#  - RUNTIME:      The JPL runtime library.
+#  - RUNTIME_LIBS: The extra libraries and linker flags needed by the runtime, separated by spaces.
+#  - PROGRAM:      The `.jpl` file to test.
+#  - FLAGS:        The flags with which to compile the program, separated by spaces.
+#  - WORK_DIR:     A directory for the intermediate files.
+
+get_filename_component(name "${PROGRAM}" NAME_WE)
+get_filename_component(directory "${PROGRAM}" DIRECTORY)
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+separate_arguments(runtime_libs UNIX_COMMAND "${RUNTIME_LIBS}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+execute_process(COMMAND "${JPLC}" -s ${flags} "${PROGRAM}"
+                OUTPUT_VARIABLE assembly
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "jplc failed on ${PROGRAM} with `${FLAGS}`")
+endif()
+
+#  `-s` ends its output with a status line, which is not assembly.
+string(REGEX REPLACE "Compilation succeeded: assembly complete\n$" "" assembly "${assembly}")
+file(WRITE "${WORK_DIR}/${name}.s" "${assembly}")
+
+execute_process(COMMAND "${NASM}" -f elf64 "${WORK_DIR}/${name}.s" -o "${WORK_DIR}/${name}.o" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "nasm failed on the assembly for ${PROGRAM} with `${FLAGS}`")
+endif()
+
+execute_process(COMMAND "${LINKER}" "${WORK_DIR}/${name}.o" "${RUNTIME}" ${runtime_libs} -o "${WORK_DIR}/${name}"
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "linking failed for ${PROGRAM} with `${FLAGS}`")
+endif()
+
+#  Some programs abort on purpose, so only the output is compared, not the exit status.
+execute_process(COMMAND "${WORK_DIR}/${name}"
+                WORKING_DIRECTORY "${directory}"
+                OUTPUT_VARIABLE actual)
+file(READ "${directory}/${name}.out" expected)
+if(NOT actual STREQUAL expected)
+    file(WRITE "${WORK_DIR}/${name}.actual" "${actual}")
+    message(FATAL_ERROR "the output of ${PROGRAM} with `${FLAGS}` does not match ${name}.out; "
+                        "see ${WORK_DIR}/${name}.actual")
+endif()
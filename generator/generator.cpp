@@ -7,7 +7,11 @@
  *
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <functional>
+#include <iostream>
 #include <sstream>
 #include <unordered_map>
 
@@ -78,16 +82,57 @@ namespace generator {
 
     generator::variable_table::variable_table(const std::shared_ptr<variable_table>& parent) : parent(parent) {}
 
-    std::tuple<std::string, long> generator::variable_table::get_variable_address(const std::string& variable,
-                                                                                  bool from_child) const {
-        const std::string reg = (this->parent == nullptr && from_child) ? "r12" : "rbp";
-        if (this->variables.count(variable) > 0) { return {reg, this->variables.at(variable)}; }
+    std::tuple<std::string, long> generator::variable_table::get_variable_address(const std::string& variable) const {
+        if (this->variables.count(variable) > 0) { return {"rbp", this->variables.at(variable)}; }
+        if (this->global_variables.count(variable) > 0) {
+            return {std::string("rel ") + generator::globals_end_label, this->global_variables.at(variable)};
+        }
 
-        return this->parent->get_variable_address(variable, true);
+        return this->parent->get_variable_address(variable);
     }
 
     void generator::variable_table::set_variable_address(const std::string& variable, long offset) {
         this->variables[variable] = offset;
+        this->constant_values.erase(variable);
+        this->loop_constants.erase(variable);
+        this->global_variables.erase(variable);
+    }
+
+    void generator::variable_table::set_global_address(const std::string& variable, long offset) {
+        this->global_variables[variable] = offset;
+        this->constant_values.erase(variable);
+        this->loop_constants.erase(variable);
+        this->variables.erase(variable);
+    }
+
+    void generator::variable_table::set_variable_constant(const std::string& variable, long value,
+                                                          bool loop_variable) {
+        this->constant_values[variable] = value;
+        if (loop_variable) this->loop_constants.insert(variable);
+        else this->loop_constants.erase(variable);
+    }
+
+    void generator::variable_table::clear_variable_constant(const std::string& variable) {
+        this->constant_values.erase(variable);
+        this->loop_constants.erase(variable);
+    }
+
+    bool generator::variable_table::get_variable_constant(const std::string& variable, long& value) const {
+        if (this->constant_values.count(variable) == 0) return false;
+
+        value = this->constant_values.at(variable);
+        return true;
+    }
+
+    bool generator::variable_table::is_loop_constant(const std::string& variable) const {
+        return this->loop_constants.count(variable) > 0;
+    }
+
+    void generator::variable_table::restore(const variable_table& saved) {
+        this->variables = saved.variables;
+        this->constant_values = saved.constant_values;
+        this->loop_constants = saved.loop_constants;
+        this->global_variables = saved.global_variables;
     }
 
     //  =======================
@@ -112,438 +157,511 @@ namespace generator {
         return assembly.str();
     }
 
-    std::string
-    generator::generate_tensor_contraction(const std::shared_ptr<ast_node::array_loop_expr_node>& array_loop) {
+    std::string generator::generate_assem_div(long divisor, bool is_mod) const {
         std::stringstream assembly;
-        const std::shared_ptr<ast_node::sum_loop_expr_node> sum_loop
-                = std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(array_loop->item_expr);
-        const long num_array_bindings = (long)array_loop->binding_pairs.size();
-        const long num_sum_bindings = (long)sum_loop->binding_pairs.size();
-        const long total_bindings = num_array_bindings + num_sum_bindings;
-        const long num_nodes = (long)array_loop->tc_nodes.size();
-        constexpr long reg_size = 8;
 
-        std::unordered_map<std::string, long> node_to_address;
+        if (divisor == 1) {
+            if (is_mod) assembly << "\tmov rax, 0\n";
 
-        for (const std::string& tc_node : array_loop->tc_nodes) {
-            for (long index = 0; index < (long)sum_loop->binding_pairs.size(); ++index) {
-                if (std::get<0>(sum_loop->binding_pairs[index]).text == tc_node) {
-                    node_to_address[tc_node] = reg_size * index;
+            return assembly.str();
+        }
+
+        //  `LONG_MIN / -1` overflows, and `idiv` traps on it. Keep the trap, so that the program behaves the same
+        //  at every optimization level.
+        if (divisor == -1) {
+            assembly << "\tmov r10, -1\n"
+                     << "\tcqo\n"
+                     << "\tidiv r10\n";
+            if (is_mod) assembly << "\tmov rax, rdx\n";
+
+            return assembly.str();
+        }
+
+        //  `LONG_MIN` has no positive counterpart; `log_2` rejects it.
+        const unsigned long magnitude = (divisor < 0) ? 0UL - (unsigned long)divisor : (unsigned long)divisor;
+        const long log = (divisor == LONG_MIN) ? 63 : generator::log_2((long)magnitude);
+
+        if (log > 0) {
+            //  Bias negative dividends by `magnitude - 1` so that the arithmetic shift truncates toward zero.
+            assembly << "\tmov r10, rax\n"
+                     << "\tsar r10, 63\n"
+                     << "\tshr r10, " << 64 - log << "\n"
+                     << "\tadd r10, rax\n";
+            if (is_mod) {
+                if (log < 32) {
+                    assembly << "\tand r10, " << -(1L << log) << "\n";
+                } else {
+                    assembly << "\tmov r11, " << (long)(0UL - (1UL << log)) << "\n"
+                             << "\tand r10, r11\n";
                 }
+                assembly << "\tsub rax, r10\n";
+            } else {
+                assembly << "\tsar r10, " << log << "\n";
+                if (divisor < 0) assembly << "\tneg r10\n";
+                assembly << "\tmov rax, r10\n";
             }
-            for (long index = 0; index < (long)array_loop->binding_pairs.size(); ++index) {
-                if (std::get<0>(array_loop->binding_pairs[index]).text == tc_node) {
-                    node_to_address[tc_node] = reg_size * (index + num_sum_bindings);
-                }
+
+            return assembly.str();
+        }
+
+        long multiplier;
+        long shift;
+        generator::division_magic(divisor, multiplier, shift);
+
+        assembly << "\tmov r10, rax\n"
+                 << "\tmov rax, " << multiplier << "\n"
+                 << "\timul r10\n";
+        if (divisor > 0 && multiplier < 0) assembly << "\tadd rdx, r10\n";
+        if (divisor < 0 && multiplier > 0) assembly << "\tsub rdx, r10\n";
+        if (shift > 0) assembly << "\tsar rdx, " << shift << "\n";
+        assembly << "\tmov rax, rdx\n"
+                 << "\tshr rax, 63\n"
+                 << "\tadd rax, rdx\n";
+
+        if (is_mod) {
+            if (generator::fits_into_32(divisor) || generator::fits_into_32(-divisor)) {
+                assembly << "\timul rax, rax, " << divisor << "\n";
+            } else {
+                assembly << "\tmov r11, " << divisor << "\n"
+                         << "\timul rax, r11\n";
             }
+            assembly << "\tsub r10, rax\n"
+                     << "\tmov rax, r10\n";
         }
 
-        //  Print the variables in topological order, if in debug mode:
-        if (this->debug) {
-            assembly << "\t;  BEGIN generate_tensor_contraction\n"
-                     << "\t;    " << num_nodes << " variable" << ((num_nodes == 1) ? "" : "s")
-                     << ((num_nodes > 0) ? ":" : "") << "\n";
+        return assembly.str();
+    }
 
-            for (const std::string& tc_node : array_loop->tc_nodes) assembly << "\t;      - " << tc_node << "\n";
+    std::string generator::generate_aligned_call(const std::string& callee) const {
+        std::stringstream assembly;
+
+        const unsigned int padding = this->stack.alignment_padding();
+        if (padding > 0) {
+            assembly << "\tsub rsp, " << padding;
+            if (this->debug) assembly << " ; Align stack";
+            assembly << "\n";
         }
 
-        //  1: Allocate 8 bytes for the array pointer.
-        //  ------------------------------------------
+        assembly << "\tcall " << callee << "\n";
 
-        if (this->debug) assembly << "\t;  Allocating 8 bytes for the array pointer\n";
+        if (padding > 0) {
+            assembly << "\tadd rsp, " << padding;
+            if (this->debug) assembly << " ; Remove alignment";
+            assembly << "\n";
+        }
 
-        assembly << "\tsub rsp, 8\n";
-        this->stack.push();
+        return assembly.str();
+    }
 
-        //  2: Compute each loop bound and push onto the stack.
-        //  ---------------------------------------------------
+    std::string generator::generate_fail_assertion(const std::string& message) const {
+        std::stringstream assembly;
 
-        const auto compute_bounds =
-                [&assembly, this](const std::vector<ast_node::array_loop_expr_node::binding_pair_t>& bindings) {
-                    for (long index = (long)bindings.size() - 1; index >= 0; --index) {
-                        const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair = bindings[index];
+        const unsigned int padding = this->stack.alignment_padding();
+        if (padding > 0) {
+            assembly << "\tsub rsp, " << padding;
+            if (this->debug) assembly << " ; Align stack";
+            assembly << "\n";
+        }
 
-                        if (this->debug) assembly << "\t;  Bound: " << std::get<0>(pair).text << "\n";
+        assembly << "\tlea rdi, [rel " << (*this->constants)[message] << "]";
+        if (this->debug) assembly << " ; " << message;
+        assembly << "\n"
+                 << "\tcall _fail_assertion\n";
 
-                        assembly << this->generate_expr(std::get<1>(pair));
+        return assembly.str();
+    }
 
-                        const std::string jump = this->constants->next_jump();
+    std::string generator::generate_cond_jump(const std::shared_ptr<ast_node::expr_node>& condition, bool jump_when,
+                                              const std::string& label) {
+        std::stringstream assembly;
 
-                        assembly << "\tmov rax, [rsp]\n"
-                                 << "\tcmp rax, 0\n"
-                                 << "\tjg " << jump << "\n";
+        long condition_value = 0;
+        if (this->opt_level >= 1 && this->constant_int_value(condition, condition_value)) {
+            if ((condition_value != 0) == jump_when) assembly << "\tjmp " << label << "\n";
+            return assembly.str();
+        }
 
-                        const bool needs_alignment = this->stack.needs_alignment();
-                        if (needs_alignment) {
-                            assembly << "\tsub rsp, 8";
-                            if (this->debug) assembly << " ; Align stack";
-                            assembly << "\n";
-                            this->stack.push();
+        if (this->opt_level >= 1) {
+            switch (condition->type) {
+                case ast_node::TRUE_EXPR:
+                case ast_node::FALSE_EXPR:
+                    if ((condition->type == ast_node::TRUE_EXPR) == jump_when) assembly << "\tjmp " << label << "\n";
+                    return assembly.str();
+                case ast_node::UNOP_EXPR: {
+                    const std::shared_ptr<ast_node::unop_expr_node> unop
+                            = std::reinterpret_pointer_cast<ast_node::unop_expr_node>(condition);
+                    if (unop->operator_type == ast_node::UNOP_INV) {
+                        return this->generate_cond_jump(unop->operand, !jump_when, label);
+                    }
+                } break;
+                case ast_node::BINOP_EXPR: {
+                    const std::shared_ptr<ast_node::binop_expr_node> binop
+                            = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(condition);
+                    const ast_node::op_type op = binop->operator_type;
+
+                    if (op == ast_node::BINOP_AND || op == ast_node::BINOP_OR) {
+                        //  `a && b` jumps when false as soon as either operand is false;
+                        //  `a || b` jumps when true as soon as either operand is true.
+                        if ((op == ast_node::BINOP_AND) != jump_when) {
+                            assembly << this->generate_cond_jump(binop->left_operand, jump_when, label)
+                                     << this->generate_cond_jump(binop->right_operand, jump_when, label);
+                        } else {
+                            const std::string skip = this->constants->next_jump();
+                            assembly << this->generate_cond_jump(binop->left_operand, !jump_when, skip)
+                                     << this->generate_cond_jump(binop->right_operand, jump_when, label) << skip
+                                     << ":\n";
                         }
+                        return assembly.str();
+                    }
 
-                        assembly << "\tlea rdi, [rel " << (*this->constants)[{"non-positive loop bound"}] << "]";
-                        if (this->debug) assembly << " ; non-positive loop bound";
-                        assembly << "\n"
-                                 << "\tcall _fail_assertion\n";
+                    const bool is_comparison = op == ast_node::BINOP_LT || op == ast_node::BINOP_GT
+                                            || op == ast_node::BINOP_EQ || op == ast_node::BINOP_NEQ
+                                            || op == ast_node::BINOP_LEQ || op == ast_node::BINOP_GEQ;
+                    if (!is_comparison) break;
+
+                    if (this->debug) assembly << "\t;  O1: Fused comparison and branch\n";
+
+                    if (binop->left_operand->r_type->type == resolved_type::FLOAT_TYPE) {
+                        assembly << this->generate_expr(binop->right_operand)
+                                 << this->generate_expr(binop->left_operand) << "\tmovsd xmm0, [rsp]\n"
+                                 << "\tmovsd xmm1, [rsp + 8]\n"
+                                 << "\tadd rsp, 16\n";
+                        this->stack.pop();
+                        this->stack.pop();
 
-                        if (needs_alignment) {
-                            assembly << "\tadd rsp, 8";
-                            if (this->debug) assembly << " ; Remove alignment";
-                            assembly << "\n";
-                            this->stack.pop();
+                        //  `ucomisd` sets ZF, PF, and CF when either operand is NaN, so only the "above" conditions
+                        //  are false for unordered operands.
+                        switch (op) {
+                            case ast_node::BINOP_LT:
+                                assembly << "\tucomisd xmm1, xmm0\n"
+                                         << "\t" << (jump_when ? "ja" : "jbe") << " " << label << "\n";
+                                break;
+                            case ast_node::BINOP_GT:
+                                assembly << "\tucomisd xmm0, xmm1\n"
+                                         << "\t" << (jump_when ? "ja" : "jbe") << " " << label << "\n";
+                                break;
+                            case ast_node::BINOP_LEQ:
+                                assembly << "\tucomisd xmm1, xmm0\n"
+                                         << "\t" << (jump_when ? "jae" : "jb") << " " << label << "\n";
+                                break;
+                            case ast_node::BINOP_GEQ:
+                                assembly << "\tucomisd xmm0, xmm1\n"
+                                         << "\t" << (jump_when ? "jae" : "jb") << " " << label << "\n";
+                                break;
+                            default: {
+                                assembly << "\tucomisd xmm0, xmm1\n";
+                                //  Equal means ZF set and PF clear.
+                                if ((op == ast_node::BINOP_EQ) == jump_when) {
+                                    const std::string skip = this->constants->next_jump();
+                                    assembly << "\tjp " << skip << "\n"
+                                             << "\tje " << label << "\n"
+                                             << skip << ":\n";
+                                } else {
+                                    assembly << "\tjp " << label << "\n"
+                                             << "\tjne " << label << "\n";
+                                }
+                            } break;
                         }
 
-                        assembly << jump << ":\n";
+                        return assembly.str();
                     }
-                };
 
-        if (this->debug) assembly << "\t;  Compute all bounds:\n";
-        if (this->debug) assembly << "\t;  Array bounds:\n";
+                    const bool right_is_immediate = binop->right_operand->type == ast_node::INTEGER_EXPR
+                                                 && generator::fits_into_32(
+                                                         std::reinterpret_pointer_cast<ast_node::integer_expr_node>(
+                                                                 binop->right_operand)
+                                                                 ->value);
+                    std::string right_reg;
+                    long right_offset = 0;
+                    if (right_is_immediate) {
+                        assembly << this->generate_expr(binop->left_operand) << "\tpop rax\n"
+                                 << "\tcmp rax, "
+                                 << std::reinterpret_pointer_cast<ast_node::integer_expr_node>(binop->right_operand)
+                                            ->value
+                                 << "\n";
+                        this->stack.pop();
+                    } else if (binop->right_operand->cp_val.type != ast_node::INT_VALUE
+                               && this->memory_operand(binop->right_operand, right_reg, right_offset)) {
+                        assembly << this->generate_expr(binop->left_operand) << "\tpop rax\n"
+                                 << "\tcmp rax, [" << right_reg << " - " << right_offset << "]\n";
+                        this->stack.pop();
+                    } else {
+                        assembly << this->generate_expr(binop->right_operand)
+                                 << this->generate_expr(binop->left_operand) << "\tpop rax\n"
+                                 << "\tpop r10\n"
+                                 << "\tcmp rax, r10\n";
+                        this->stack.pop();
+                        this->stack.pop();
+                    }
 
-        compute_bounds(array_loop->binding_pairs);
+                    std::string jump_instruction;
+                    switch (op) {
+                        case ast_node::BINOP_LT:
+                            jump_instruction = jump_when ? "jl" : "jge";
+                            break;
+                        case ast_node::BINOP_GT:
+                            jump_instruction = jump_when ? "jg" : "jle";
+                            break;
+                        case ast_node::BINOP_EQ:
+                            jump_instruction = jump_when ? "je" : "jne";
+                            break;
+                        case ast_node::BINOP_NEQ:
+                            jump_instruction = jump_when ? "jne" : "je";
+                            break;
+                        case ast_node::BINOP_LEQ:
+                            jump_instruction = jump_when ? "jle" : "jg";
+                            break;
+                        default:
+                            jump_instruction = jump_when ? "jge" : "jl";
+                            break;
+                    }
+                    assembly << "\t" << jump_instruction << " " << label << "\n";
 
-        if (this->debug) assembly << "\t;  Sum bounds:\n";
-        compute_bounds(sum_loop->binding_pairs);
+                    return assembly.str();
+                }
+                default:
+                    break;
+            }
+        }
 
-        //  3: Multiply all the array bounds and call `jpl_alloc`.
-        //  ------------------------------------------------------
+        assembly << this->generate_expr(condition) << "\tpop rax\n";
+        this->stack.pop();
+        assembly << "\tcmp rax, 0\n"
+                 << "\t" << (jump_when ? "jne" : "je") << " " << label << "\n";
 
-        if (this->debug) assembly << "\t;  Computing total heap size to allocate\n";
+        return assembly.str();
+    }
 
-        assembly << "\tmov rdi, " << reg_size;
-        if (this->debug) assembly << " ; Size of one element";
-        assembly << "\n";
+    std::string
+    generator::generate_unrolled_array_loop(const std::shared_ptr<ast_node::array_loop_expr_node>& expression,
+                                            const std::vector<long>& bounds) {
+        constexpr long reg_size = 8;
+        std::stringstream assembly;
 
-        for (long index = 0; index < num_array_bindings; ++index) {
-            const long offset = reg_size * (num_sum_bindings + index);
+        if (this->debug) assembly << "\t;  O2: Fully unrolled array loop\n";
 
-            assembly << "\timul rdi, [rsp + " << offset << "]";
-            if (this->debug) assembly << "; Multiply by one dimension";
+        const long item_size = (long)std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(
+                                        expression->r_type)
+                                        ->element_type->size();
+        const long rank = (long)bounds.size();
+
+        long trip_count = 1;
+        for (const long bound : bounds) trip_count *= bound;
+
+        //  Field `f` of element `n` is at `8 * (f * trip_count + n)` in a planar array.
+        const bool is_planar = this->is_planar(expression->r_type);
+
+        assembly << "\tsub rsp, " << reg_size * (rank + 1) << "\n";
+        this->stack.push(reg_size * (rank + 1));
+
+        for (long index = 0; index < rank; ++index) {
+            assembly << "\tmov qword [rsp + " << reg_size * index << "], " << bounds[index];
+            if (this->debug) assembly << " ; Bound for " << std::get<0>(expression->binding_pairs[index]).text;
             assembly << "\n";
+        }
 
-            const std::string next_jump = this->constants->next_jump();
-            assembly << "\tjno " << next_jump << "\n";
+        assembly << "\tmov rdi, " << item_size * trip_count;
+        if (this->debug) assembly << " ; Total heap size";
+        assembly << "\n";
 
-            const bool needs_alignment = this->stack.needs_alignment();
-            if (needs_alignment) {
-                assembly << "\tsub rsp, 8";
-                if (this->debug) assembly << " ; Align stack";
-                assembly << "\n";
-                this->stack.push();
-            }
+        assembly << this->generate_aligned_call("_jpl_alloc");
 
-            assembly << "\tlea rdi, [rel " << (*this->constants)[{"overflow computing array size"}] << "]";
-            if (this->debug) assembly << " ; overflow computing array size";
-            assembly << "\n"
-                     << "\tcall _fail_assertion\n";
+        assembly << "\tmov [rsp + " << reg_size * rank << "], rax";
+        if (this->debug) assembly << " ; Move array pointer to previously-allocated space";
+        assembly << "\n";
 
-            if (needs_alignment) {
-                assembly << "\tadd rsp, 8";
-                if (this->debug) assembly << " ; Remove alignment";
-                assembly << "\n";
-                this->stack.pop();
+        //  Iterate in row-major order, so that the flat index is the iteration number.
+        std::vector<long> indices(rank, 0);
+        for (long iteration = 0; iteration < trip_count; ++iteration) {
+            for (long index = 0; index < rank; ++index) {
+                this->variables.set_variable_constant(std::get<0>(expression->binding_pairs[index]).text,
+                                                      indices[index], true);
             }
 
-            assembly << next_jump << ":\n";
-        }
+            assembly << this->generate_expr(expression->item_expr);
 
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            assembly << "\tsub rsp, 8";
-            if (this->debug) assembly << " ; Align stack";
+            assembly << "\tmov rax, [rsp + " << item_size + reg_size * rank << "]";
+            if (this->debug) assembly << " ; Load array pointer";
             assembly << "\n";
-            this->stack.push();
-        }
 
-        assembly << "\tcall _jpl_alloc\n";
+            if (this->debug)
+                assembly << "\t;  Moving " << item_size << "-byte body from [rsp] to element " << iteration << "\n";
+            for (long offset = item_size - reg_size; offset >= 0; offset -= reg_size) {
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov r10, [rsp + " << offset << "]\n";
 
-        if (needs_alignment) {
-            assembly << "\tadd rsp, 8";
-            if (this->debug) assembly << " ; Remove alignment";
-            assembly << "\n";
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov [rax + "
+                         << (is_planar ? offset * trip_count + reg_size * iteration : item_size * iteration + offset)
+                         << "], r10\n";
+            }
+
+            assembly << "\tadd rsp, " << item_size << "\n";
             this->stack.pop();
+
+            for (long index = rank - 1; index >= 0; --index) {
+                if (++indices[index] < bounds[index]) break;
+                indices[index] = 0;
+            }
         }
 
-        //  4: Save the allocated pointer to the stack in the right place.
-        //  --------------------------------------------------------------
+        for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : expression->binding_pairs) {
+            this->variables.clear_variable_constant(std::get<0>(pair).text);
+        }
 
-        assembly << "\tmov [rsp + " << reg_size * total_bindings << "], rax";
-        if (this->debug) assembly << " ; Move array pointer to pre-allocated space";
-        assembly << "\n";
+        return assembly.str();
+    }
 
-        //  5: Push a `0` onto the stack for each array/sum variable.
-        //  ---------------------------------------------------------
+    std::string generator::generate_unrolled_sum_loop(const std::shared_ptr<ast_node::sum_loop_expr_node>& expression,
+                                                      const std::vector<long>& bounds) {
+        std::stringstream assembly;
 
-        const auto initialize_vars =
-                [&assembly, this](const std::vector<ast_node::array_loop_expr_node::binding_pair_t>& bindings) {
-                    for (long index = (long)(bindings.size() - 1); index >= 0; --index) {
-                        const std::string& name = std::get<0>(bindings[index]).text;
-                        if (this->debug) assembly << "\t;  Initialize " << name << " to 0\n";
+        if (this->debug) assembly << "\t;  O2: Fully unrolled sum loop\n";
 
-                        assembly << "\tmov rax, 0\n"
-                                 << "\tpush rax\n";
+        const bool is_int = expression->r_type->type == resolved_type::INT_TYPE;
+        const long rank = (long)bounds.size();
 
-                        this->stack.push();
-                        this->variables.set_variable_address(name, this->stack.size());
-                    }
-                };
+        long trip_count = 1;
+        for (const long bound : bounds) trip_count *= bound;
 
-        initialize_vars(array_loop->binding_pairs);
-        initialize_vars(sum_loop->binding_pairs);
+        assembly << "\tpush qword 0";
+        if (this->debug) assembly << " ; Initialize sum to 0";
+        assembly << "\n";
+        this->stack.push();
 
-        //  6: Begin the loop.
-        //  ------------------
+        std::vector<long> indices(rank, 0);
+        for (long iteration = 0; iteration < trip_count; ++iteration) {
+            for (long index = 0; index < rank; ++index) {
+                this->variables.set_variable_constant(std::get<0>(expression->binding_pairs[index]).text,
+                                                      indices[index], true);
+            }
 
-        const std::string body_start = this->constants->next_jump();
+            assembly << this->generate_expr(expression->sum_expr);
 
-        assembly << body_start << ":";
-        if (this->debug) assembly << " ; Begin loop body";
-        assembly << "\n";
+            if (is_int) {
+                assembly << "\tpop rax\n"
+                         << "\tadd [rsp], rax";
+            } else {
+                assembly << "\tmovsd xmm0, [rsp]\n"
+                         << "\tadd rsp, 8\n"
+                         << "\taddsd xmm0, [rsp]\n"
+                         << "\tmovsd [rsp], xmm0";
+            }
+            if (this->debug) assembly << " ; Add loop body to sum";
+            assembly << "\n";
+            this->stack.pop();
 
-        //  7: Compute the body of the sum loop.
-        //  ------------------------------------
+            for (long index = rank - 1; index >= 0; --index) {
+                if (++indices[index] < bounds[index]) break;
+                indices[index] = 0;
+            }
+        }
 
-        if (this->debug) assembly << "\t;  Compute sum loop body\n";
+        for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : expression->binding_pairs) {
+            this->variables.clear_variable_constant(std::get<0>(pair).text);
+        }
 
-        assembly << this->generate_expr(sum_loop->sum_expr);
+        return assembly.str();
+    }
 
-        //  8: Compute pointer into the array using the array indices.
-        //  ----------------------------------------------------------
+    std::string
+    generator::generate_element_address(const std::shared_ptr<ast_node::array_index_expr_node>& expression) {
+        std::stringstream assembly;
 
-        if (this->debug) assembly << "\t;  Compute pointer into the array\n";
+        constexpr long reg_size = 8;
+        const long rank = (long)expression->params.size();
 
-        const long var_start = reg_size * (num_sum_bindings + 1);
-        const long bound_start = reg_size * (total_bindings + num_sum_bindings + 1);
-        assembly << "\tmov rax, [rsp + " << var_start << "]\n";
+        const long array_offset = reg_size * rank;
 
-        for (long index = 1; index < num_array_bindings; ++index) {
-            const long offset = reg_size * index;
-            const std::shared_ptr<ast_node::expr_node>& binding = std::get<1>(array_loop->binding_pairs[index]);
-            if (binding->cp_val.type == ast_node::INT_VALUE) {
-                assembly << this->generate_assem_mul("rax", binding->cp_val.int_value);
+        std::string header_reg;
+        long header_offset = 0;
+        const bool is_in_place = this->opt_level >= 1
+                              && this->memory_operand(expression->array, header_reg, header_offset);
+
+        //  Planar arrays hold one 8-byte field of each element per plane.
+        const bool is_planar = this->is_planar(expression->array->r_type);
+        const long element_size = is_planar ? reg_size : (long)expression->r_type->size();
+
+        //  Computes the distance between planes into RCX, given the operand for each header field.
+        const auto plane_stride = [&](const std::function<std::string(long)>& field) {
+            std::stringstream stride;
+            if (this->debug) stride << "\t;  Distance between planes\n";
+            stride << "\tmov rcx, " << reg_size << "\n";
+            for (long dim = 0; dim < rank; ++dim) {
+                const std::vector<ast_node::cp_value>& dims = expression->array->cp_val.array_value;
+                if (this->opt_level >= 2 && (long)dims.size() > dim && dims[dim].type == ast_node::INT_VALUE) {
+                    stride << this->generate_assem_mul("rcx", dims[dim].int_value);
+                } else {
+                    stride << "\timul rcx, " << field(reg_size * dim) << "\n";
+                }
+            }
+            return stride.str();
+        };
+
+        const auto linear_read = this->linear_reads.find(expression.get());
+        if (linear_read != this->linear_reads.end()) {
+            if (this->debug) assembly << "\t;  O2: Reading at the linear index of a collapsed loop\n";
+            assembly << "\tmov rax, [rsp + " << (long)this->stack.size() - linear_read->second << "]\n"
+                     << this->generate_assem_mul("rax", element_size) << "\tadd rax, [" << header_reg << " - "
+                     << header_offset - array_offset << "]\n";
+            if (is_planar) {
+                assembly << plane_stride([&](long field) {
+                    return "[" + header_reg + " - " + std::to_string(header_offset - field) + "]";
+                });
+            }
+
+            return assembly.str();
+        }
+
+        //  Returns the operand for the header field at the given offset, once the indices are on the stack.
+        const std::function<std::string(long)> header = [&](long field) {
+            std::stringstream operand;
+            if (is_in_place) {
+                operand << "[" << header_reg << " - " << header_offset - field << "]";
             } else {
-                assembly << "\timul rax, [rsp + " << bound_start + offset << "]\n";
+                operand << "[rsp + " << array_offset + field << "]";
             }
-            assembly << "\tadd rax, [rsp + " << var_start + offset << "]\n";
+            return operand.str();
+        };
+
+        if (is_in_place) {
+            if (this->debug) assembly << "\t;  O1: Reading the array header in place\n";
+        } else {
+            assembly << this->generate_expr(expression->array);
         }
 
-        assembly << "\tshl rax, 3";
-        if (this->debug) assembly << " ; Multiply by size of value";
-        assembly << "\n";
+        //  Put each index expression onto the stack.
+        for (long index = rank - 1; index >= 0; --index) { assembly << generate_expr(expression->params[index]); }
 
-        assembly << "\tadd rax, [rsp + " << reg_size * (2 * total_bindings + 1) << "]\n";
+        for (long offset = 0; offset < array_offset; offset += reg_size) {
+            //  Known dimensions (e.g. propagated from every caller) allow immediate compares, or no check at all.
+            const std::vector<ast_node::cp_value>& dims = expression->array->cp_val.array_value;
+            const long dim_index = offset / reg_size;
+            const bool is_known_dim = this->opt_level >= 2 && (long)dims.size() > dim_index
+                                   && dims[dim_index].type == ast_node::INT_VALUE
+                                   && generator::fits_into_32(dims[dim_index].int_value);
+            long index_value = 0;
+            if (is_known_dim && this->constant_int_value(expression->params[dim_index], index_value)
+                && index_value >= 0 && index_value < dims[dim_index].int_value) {
+                if (this->debug) assembly << "\t;  O2: Index " << dim_index << " is in bounds\n";
+                continue;
+            }
 
-        //  9: Add the body to the computed pointer.
-        //  ----------------------------------------
+            const std::string jump_1 = this->constants->next_jump();
+            const std::string jump_2 = this->constants->next_jump();
 
-        if (this->debug) assembly << "\t;  Add the body to the pointer\n";
+            assembly << "\tmov rax, [rsp + " << offset << "]\n"
+                     << "\tcmp rax, 0\n"
+                     << "\tjge " << jump_1 << "\n";
 
-        if (sum_loop->r_type->type == resolved_type::INT_TYPE) {
-            assembly << "\tpop r10\n"
-                     << "\tadd [rax], r10\n";
-        } else {
-            assembly << "\tmovsd xmm0, [rsp]\n"
-                     << "\tadd rsp, 8\n"
-                     << "\taddsd xmm0, [rax]\n"
-                     << "\tmovsd [rax], xmm0\n";
-        }
-
-        //  10: Increment the indices.
-        //  --------------------------
-
-        if (this->debug) assembly << "\t;  Increment the indices\n";
-
-        const long offset = reg_size * total_bindings;
-
-        for (long index = (long)array_loop->tc_nodes.size() - 1; index >= 0; --index) {
-            const std::string& name = array_loop->tc_nodes[index];
-            const long base_addr = node_to_address[name];
-
-            if (this->debug) assembly << "\t;  Increment `" << name << "`\n";
-            assembly << "\tadd qword [rsp + " << base_addr << "], 1\n";
-
-            assembly << "\tmov rax, [rsp + " << base_addr << "]\n"
-                     << "\tcmp rax, [rsp + " << base_addr + offset << "]\n"
-                     << "\tjl " << body_start;
-            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
-            assembly << "\n";
-
-            if (index > 0) {
-                assembly << "\tmov qword [rsp + " << base_addr << "], 0";
-                if (this->debug) assembly << " ; " << name << " = 0";
-                assembly << "\n";
-            }
-        }
-
-        //        assembly << "\tadd rsp, " << item_size << "\n";
-        //        this->stack.pop();
-        //
-        //        for (long index = rank - 1; index >= 0; --index) {
-        //            const std::string& name = std::get<0>(array_loop->binding_pairs[index]).text;
-        //
-        //            if (this->debug) assembly << "\t;  Increment " << name << "\n";
-        //            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
-        //
-        //            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
-        //            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
-        //                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
-        //                     << "\tjl " << body_start;
-        //            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
-        //            assembly << "\n";
-        //
-        //            if (index > 0) {
-        //                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
-        //                if (this->debug) assembly << " ; Set " << name << " = 0";
-        //                assembly << "\n";
-        //            }
-        //        }
-
-        //  11: Free array and sum indices and sum bounds.
-        //  ----------------------------------------------
-
-        if (this->debug) assembly << "\t;  Clean up\n";
-
-        assembly << "\tadd rsp, " << reg_size * total_bindings;
-        if (this->debug) assembly << " ; Free all loop variables";
-        assembly << "\n";
-
-        assembly << "\tadd rsp, " << reg_size * num_sum_bindings;
-        if (this->debug) assembly << " ; Free all loop bounds";
-        assembly << "\n";
-
-        for (long index = 0; index < 2 * (total_bindings + 1); ++index) this->stack.pop();
-
-        this->stack.push(reg_size * (num_array_bindings + 1));
-
-        if (this->debug) assembly << "\t;  END generate_tensor_contraction\n";
-
-        return assembly.str();
-    }
-
-    std::string generator::generate_expr(const std::shared_ptr<ast_node::expr_node>& expression) {
-        switch (expression->type) {
-            case ast_node::ARRAY_INDEX_EXPR:
-                return this->generate_expr_array_index(
-                        std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression));
-            case ast_node::ARRAY_LITERAL_EXPR:
-                return this->generate_expr_array_literal(
-                        std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(expression));
-            case ast_node::ARRAY_LOOP_EXPR:
-                return this->generate_expr_array_loop(
-                        std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(expression));
-            case ast_node::BINOP_EXPR:
-                return this->generate_expr_binop(std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression));
-            case ast_node::CALL_EXPR:
-                return this->generate_expr_call(std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression));
-            case ast_node::FALSE_EXPR:
-                return this->generate_expr_false(std::reinterpret_pointer_cast<ast_node::false_expr_node>(expression));
-            case ast_node::FLOAT_EXPR:
-                return this->generate_expr_float(std::reinterpret_pointer_cast<ast_node::float_expr_node>(expression));
-            case ast_node::IF_EXPR:
-                return this->generate_expr_if(std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression));
-            case ast_node::INTEGER_EXPR:
-                return this->generate_expr_integer(
-                        std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression));
-            case ast_node::SUM_LOOP_EXPR:
-                return this->generate_expr_sum_loop(
-                        std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(expression));
-            case ast_node::TRUE_EXPR:
-                return this->generate_expr_true(std::reinterpret_pointer_cast<ast_node::true_expr_node>(expression));
-            case ast_node::TUPLE_INDEX_EXPR:
-                return this->generate_expr_tuple_index(
-                        std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression));
-            case ast_node::TUPLE_LITERAL_EXPR:
-                return this->generate_expr_tuple_literal(
-                        std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression));
-            case ast_node::UNOP_EXPR:
-                return this->generate_expr_unop(std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression));
-            case ast_node::VARIABLE_EXPR:
-                return this->generate_expr_variable(
-                        std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression));
-            default:
-                throw std::runtime_error("`generate_expr`: invalid expression: \"" + expression->s_expression() + "\"");
-        }
-    }
-
-    std::string
-    generator::generate_expr_array_index(const std::shared_ptr<ast_node::array_index_expr_node>& expression) {
-        std::stringstream assembly;
-
-        if (this->debug) assembly << "\t;  START generate_expr_array_index\n";
-
-        constexpr long reg_size = 8;
-        const long rank = (long)expression->params.size();
-
-        const long array_offset = reg_size * rank;
-
-        const bool is_variable = this->opt_level >= 1 && expression->array->type == ast_node::node_type::VARIABLE_EXPR;
-        bool is_local_variable = false;
-        long gap = 0;
-        if (is_variable) {
-            const std::shared_ptr<ast_node::variable_expr_node> var_expr
-                    = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression->array);
-            const std::tuple<std::string, long> variable_address = this->variables.get_variable_address(var_expr->name);
-            is_local_variable = std::get<0>(variable_address) == "rbp";
-            gap = this->stack.size() - std::get<1>(variable_address);
-        }
-
-        if (!is_local_variable) assembly << this->generate_expr(expression->array);
-
-        //  Put each index expression onto the stack.
-        for (long index = rank - 1; index >= 0; --index) { assembly << generate_expr(expression->params[index]); }
-
-        for (long offset = 0; offset < array_offset; offset += reg_size) {
-            const std::string jump_1 = this->constants->next_jump();
-            const std::string jump_2 = this->constants->next_jump();
-
-            assembly << "\tmov rax, [rsp + " << offset << "]\n"
-                     << "\tcmp rax, 0\n"
-                     << "\tjge " << jump_1 << "\n";
-
-            const bool needs_alignment = this->stack.needs_alignment();
-            if (needs_alignment) {
-                assembly << "\tsub rsp, 8";
-                if (this->debug) assembly << " ; Align stack";
-                assembly << "\n";
-                this->stack.push();
-            }
-
-            assembly << "\tlea rdi, [rel " << (*this->constants)[{"negative array index"}] << "]";
-            if (this->debug) assembly << " ; negative array index";
-            assembly << "\n";
-
-            assembly << "\tcall _fail_assertion\n";
-
-            if (needs_alignment) {
-                assembly << "\tadd rsp, 8";
-                if (this->debug) assembly << " ; Remove alignment";
-                assembly << "\n";
-                this->stack.pop();
-            }
+            assembly << this->generate_fail_assertion("negative array index");
 
             assembly << jump_1 << ":\n"
-                     << "\tcmp rax, [rsp + " << array_offset + offset + gap << "]\n"
+                     << "\tcmp rax, "
+                     << (is_known_dim ? std::to_string(dims[dim_index].int_value) : header(offset)) << "\n"
                      << "\tjl " << jump_2 << "\n";
 
-            if (needs_alignment) {
-                assembly << "\tsub rsp, 8";
-                if (this->debug) assembly << " ; Align stack";
-                assembly << "\n";
-                this->stack.push();
-            }
-
-            assembly << "\tlea rdi, [rel " << (*this->constants)[{"index too large"}] << "]";
-            if (this->debug) assembly << " ; index too large";
-            assembly << "\n";
-
-            assembly << "\tcall _fail_assertion\n";
-
-            if (needs_alignment) {
-                assembly << "\tadd rsp, 8";
-                if (this->debug) assembly << " ; Remove alignment";
-                assembly << "\n";
-                this->stack.pop();
-            }
+            assembly << this->generate_fail_assertion("index too large");
 
             assembly << jump_2 << ":\n";
         }
@@ -552,7 +670,7 @@ namespace generator {
             assembly << "\tmov rax, [rsp + 0]\n";
         } else {
             assembly << "\tmov rax, 0\n"
-                     << "\timul rax, [rsp + " << array_offset + gap << "]\n"
+                     << "\timul rax, " << header(0) << "\n"
                      << "\tadd rax, [rsp + 0]\n";
         }
 
@@ -564,18 +682,19 @@ namespace generator {
             if (is_constant) {
                 assembly << this->generate_assem_mul("rax", expression->array->cp_val.array_value[index].int_value);
             } else {
-                assembly << "\timul rax, [rsp + " << array_offset + offset + gap << "]\n";
+                assembly << "\timul rax, " << header(offset) << "\n";
             }
             assembly << "\tadd rax, [rsp + " << offset << "]\n";
         }
 
-        assembly << this->generate_assem_mul("rax", expression->r_type->size());
+        assembly << this->generate_assem_mul("rax", element_size);
 
-        assembly << "\tadd rax, [rsp + " << array_offset * 2 + gap << "]\n";
+        assembly << "\tadd rax, " << header(array_offset) << "\n";
+        if (is_planar) assembly << plane_stride(header);
 
         if (this->debug) assembly << "\t;  Remove index variables\n";
         long total = 0;
-        const bool combine_adds = this->opt_level >= 1 && is_variable;
+        const bool combine_adds = this->opt_level >= 1;
         for (long offset = 0; offset < rank; ++offset) {
             const long val = this->stack.pop();
             if (combine_adds) {
@@ -586,160 +705,211 @@ namespace generator {
         }
         if (combine_adds) { assembly << "\tadd rsp, " << total << "\n"; }
 
-        if (!is_local_variable) {
+        if (!is_in_place) {
             assembly << "\tadd rsp, " << array_offset + reg_size;
             if (this->debug) assembly << " ; Remove array";
             assembly << "\n";
             this->stack.pop();
         }
 
-        const long return_size = (long)expression->r_type->size();
-        assembly << "\tsub rsp, " << return_size << "\n";
-        this->stack.push(return_size);
-
-        if (this->debug) assembly << "\t;  Moving " << return_size << " bytes from [rax] to [rsp]\n";
-        for (long offset = return_size - reg_size; offset >= 0; offset -= reg_size) {
-            if (this->debug) assembly << "\t";  //  Extra indentation for debug mode.
-            assembly << "\tmov r10, [rax + " << offset << "]\n";
-
-            if (this->debug) assembly << "\t";  //  Extra indentation for debug mode.
-            assembly << "\tmov [rsp + " << offset << "], r10\n";
-        }
-
-        if (this->debug) assembly << "\t;  END generate_expr_array_index\n";
-
         return assembly.str();
     }
 
-    std::string
-    generator::generate_expr_array_literal(const std::shared_ptr<ast_node::array_literal_expr_node>& expression) {
+    std::string generator::generate_partial_unroll(const std::function<std::string(long)>& generate_iteration,
+                                                   const std::string& body_start, long unroll_factor,
+                                                   long inner_offset, long inner_bound_offset, bool reset_inner) {
         std::stringstream assembly;
-        constexpr unsigned int reg_size = 8;
-
-        if (this->debug) assembly << "\t;  START generate_expr_array_literal\n";
-
-        //  Generate assembly from right to left.
-        for (long index = (long)(expression->expressions.size() - 1); index >= 0; index--) {
-            assembly << this->generate_expr(expression->expressions[index]);
-        }
-
-        //  We don't pop from the stack as we go, because sub-expressions need to know the status of the stack.
-        //  We need to pop it all now, though, and replace it with one number.
-        unsigned long total_size = 0;
-        for (long index = 0; index < (long)expression->expressions.size(); index++) { total_size += this->stack.pop(); }
-        this->stack.push(total_size);
-
-        assembly << "\tmov rdi, " << total_size << "\n";
-
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            assembly << "\tsub rsp, 8";
-            if (this->debug) assembly << " ; Align stack";
-            assembly << "\n";
-            this->stack.push();
-        }
 
-        assembly << "\tcall _jpl_alloc\n";
-
-        if (needs_alignment) {
-            assembly << "\tadd rsp, 8";
-            if (this->debug) assembly << " ; Remove alignment";
-            assembly << "\n";
-            this->stack.pop();
-        }
+        if (this->debug) assembly << "\t;  O2: Innermost loop unrolled by " << unroll_factor << "\n";
 
-        if (this->debug) assembly << "\t;  Moving " << total_size << " bytes from rsp to rax\n";
+        const std::string remainder_start = this->constants->next_jump();
+        const std::string inner_done = this->constants->next_jump();
 
-        for (long offset = reg_size; offset <= (long)total_size; offset += reg_size) {
-            //  Extra indentation for debug mode.
-            if (this->debug) assembly << "\t";
-            assembly << "\tmov r10, [rsp + " << total_size - offset << "]\n";
+        assembly << "\tmov rax, [rsp + " << inner_offset << "]\n"
+                 << "\tadd rax, " << unroll_factor - 1 << "\n"
+                 << "\tcmp rax, [rsp + " << inner_bound_offset << "]\n"
+                 << "\tjge " << remainder_start;
+        if (this->debug) assembly << " ; Fewer than " << unroll_factor << " iterations left";
+        assembly << "\n";
 
-            if (this->debug) assembly << "\t";
-            assembly << "\tmov [rax + " << total_size - offset << "], r10\n";
+        for (long copy = 0; copy < unroll_factor; ++copy) {
+            assembly << generate_iteration(copy) << "\tadd qword [rsp + " << inner_offset << "], 1\n";
         }
+        assembly << "\tjmp " << body_start << "\n";
 
-        assembly << "\tadd rsp, " << total_size << "\n";
-        this->stack.pop();
-
-        assembly << "\tpush rax\n";
-        //  NOTE: This will probably need to be updated for a rank-2 array.
-        assembly << "\tmov rax, " << expression->expressions.size() << "\n"
-                 << "\tpush rax\n";
-        this->stack.push(expression->r_type->size());
+        assembly << remainder_start << ":";
+        if (this->debug) assembly << " ; Remainder loop";
+        assembly << "\n"
+                 << "\tmov rax, [rsp + " << inner_offset << "]\n"
+                 << "\tcmp rax, [rsp + " << inner_bound_offset << "]\n"
+                 << "\tjge " << inner_done << "\n"
+                 << generate_iteration(unroll_factor - 1) << "\tadd qword [rsp + " << inner_offset << "], 1\n"
+                 << "\tjmp " << remainder_start << "\n"
+                 << inner_done << ":\n";
 
-        if (this->debug) assembly << "\t;  END generate_expr_array_literal\n";
+        if (reset_inner) assembly << "\tmov qword [rsp + " << inner_offset << "], 0\n";
 
         return assembly.str();
     }
 
-    std::string generator::generate_expr_array_loop(const std::shared_ptr<ast_node::array_loop_expr_node>& expression) {
+    std::string generator::generate_layout_conversion(const std::shared_ptr<resolved_type::resolved_type>& type,
+                                                      long offset, bool to_planes) {
         constexpr long reg_size = 8;
         std::stringstream assembly;
 
-        if (this->debug) assembly << "\t;  START generate_expr_array_loop\n";
-
-        if (expression->is_tc) {
-            assembly << this->generate_tensor_contraction(expression);
-
-            if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
-
+        if (type->type == resolved_type::TUPLE_TYPE) {
+            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
+                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(type);
+            for (unsigned int index = 0; index < tuple_type->element_types.size(); ++index) {
+                assembly << this->generate_layout_conversion(tuple_type->element_types[index],
+                                                             offset + (long)tuple_type->offset(index), to_planes);
+            }
             return assembly.str();
         }
+        if (type->type != resolved_type::ARRAY_TYPE) return assembly.str();
 
-        if (this->debug) assembly << "\t;  Allocating 8 bytes for the array pointer\n";
-
-        assembly << "\tsub rsp, 8\n";
-        this->stack.push();
+        const std::shared_ptr<resolved_type::array_resolved_type> array_type
+                = std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(type);
+        if (!this->is_planar(type)) return assembly.str();
 
-        const std::shared_ptr<resolved_type::array_resolved_type> array_r_type
-                = std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(expression->r_type);
-        const long item_size = (long)array_r_type->element_type->size();
-        const long rank = (long)expression->binding_pairs.size();
+        const long rank = (long)array_type->rank;
+        const long fields = (long)array_type->element_type->size() / reg_size;
 
-        for (long index = rank - 1; index >= 0; --index) {
-            const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair
-                    = expression->binding_pairs[index];
-            if (this->debug) assembly << "\t;  Computing bound for " << std::get<0>(pair).text << "\n";
+        if (this->debug) {
+            assembly << "\t;  Converting an array of " << fields << "-float tuples "
+                     << (to_planes ? "to planes" : "from planes") << "\n";
+        }
 
-            assembly << this->generate_expr(std::get<1>(pair));
+        assembly << "\tmov rdi, " << reg_size * fields << "\n";
+        for (long dim = 0; dim < rank; ++dim) {
+            assembly << "\timul rdi, [rsp + " << offset + reg_size * dim << "]\n";
+        }
+        assembly << this->generate_aligned_call("_jpl_alloc");
+
+        //  R8 walks the interleaved elements and R9 the first plane; R11 is the distance between planes.
+        const std::string loop_start = this->constants->next_jump();
+        const std::string loop_done = this->constants->next_jump();
+        const long pointer_offset = offset + reg_size * rank;
+        assembly << "\tmov rcx, 1\n";
+        for (long dim = 0; dim < rank; ++dim) {
+            assembly << "\timul rcx, [rsp + " << offset + reg_size * dim << "]\n";
+        }
+        assembly << "\tmov r11, rcx\n"
+                 << "\tshl r11, 3\n"
+                 << "\tmov " << (to_planes ? "r8" : "r9") << ", [rsp + " << pointer_offset << "]\n"
+                 << "\tmov " << (to_planes ? "r9" : "r8") << ", rax\n"
+                 << "\tmov [rsp + " << pointer_offset << "], rax\n"
+                 << "\tmov rdx, 0\n"
+                 << loop_start << ":\n"
+                 << "\tcmp rdx, rcx\n"
+                 << "\tjge " << loop_done << "\n"
+                 << "\tmov r10, r9\n";
+        for (long field = 0; field < fields; ++field) {
+            if (to_planes) {
+                assembly << "\tmov rdi, [r8 + " << reg_size * field << "]\n"
+                         << "\tmov [r10], rdi\n";
+            } else {
+                assembly << "\tmov rdi, [r10]\n"
+                         << "\tmov [r8 + " << reg_size * field << "], rdi\n";
+            }
+            if (field < fields - 1) assembly << "\tadd r10, r11\n";
+        }
+        assembly << "\tadd r8, " << reg_size * fields << "\n"
+                 << "\tadd r9, 8\n"
+                 << "\tadd rdx, 1\n"
+                 << "\tjmp " << loop_start << "\n"
+                 << loop_done << ":\n";
 
-            const std::string jump = this->constants->next_jump();
+        return assembly.str();
+    }
 
-            assembly << "\tmov rax, [rsp]\n"
-                     << "\tcmp rax, 0\n"
-                     << "\tjg " << jump << "\n";
-
-            const bool needs_alignment = this->stack.needs_alignment();
-            if (needs_alignment) {
-                assembly << "\tsub rsp, 8";
-                if (this->debug) assembly << " ; Align stack";
-                assembly << "\n";
-                this->stack.push();
-            }
+    std::string
+    generator::generate_tensor_contraction(const std::shared_ptr<ast_node::array_loop_expr_node>& array_loop) {
+        std::stringstream assembly;
+        const std::shared_ptr<ast_node::sum_loop_expr_node> sum_loop
+                = std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(array_loop->item_expr);
+        const long num_array_bindings = (long)array_loop->binding_pairs.size();
+        const long num_sum_bindings = (long)sum_loop->binding_pairs.size();
+        const long total_bindings = num_array_bindings + num_sum_bindings;
+        const long num_nodes = (long)array_loop->tc_nodes.size();
+        constexpr long reg_size = 8;
 
-            assembly << "\tlea rdi, [rel " << (*this->constants)[{"non-positive loop bound"}] << "]";
-            if (this->debug) assembly << " ; non-positive loop bound";
-            assembly << "\n"
-                     << "\tcall _fail_assertion\n";
+        std::unordered_map<std::string, long> node_to_address;
 
-            if (needs_alignment) {
-                assembly << "\tadd rsp, 8";
-                if (this->debug) assembly << " ; Remove alignment";
-                assembly << "\n";
-                this->stack.pop();
+        for (const std::string& tc_node : array_loop->tc_nodes) {
+            for (long index = 0; index < (long)sum_loop->binding_pairs.size(); ++index) {
+                if (std::get<0>(sum_loop->binding_pairs[index]).text == tc_node) {
+                    node_to_address[tc_node] = reg_size * index;
+                }
+            }
+            for (long index = 0; index < (long)array_loop->binding_pairs.size(); ++index) {
+                if (std::get<0>(array_loop->binding_pairs[index]).text == tc_node) {
+                    node_to_address[tc_node] = reg_size * (index + num_sum_bindings);
+                }
             }
+        }
 
-            assembly << jump << ":\n";
+        //  Print the variables in topological order, if in debug mode:
+        if (this->debug) {
+            assembly << "\t;  BEGIN generate_tensor_contraction\n"
+                     << "\t;    " << num_nodes << " variable" << ((num_nodes == 1) ? "" : "s")
+                     << ((num_nodes > 0) ? ":" : "") << "\n";
+
+            for (const std::string& tc_node : array_loop->tc_nodes) assembly << "\t;      - " << tc_node << "\n";
         }
 
+        //  1: Allocate 8 bytes for the array pointer.
+        //  ------------------------------------------
+
+        if (this->debug) assembly << "\t;  Allocating 8 bytes for the array pointer\n";
+
+        assembly << "\tsub rsp, 8\n";
+        this->stack.push();
+
+        //  2: Compute each loop bound and push onto the stack.
+        //  ---------------------------------------------------
+
+        const auto compute_bounds =
+                [&assembly, this](const std::vector<ast_node::array_loop_expr_node::binding_pair_t>& bindings) {
+                    for (long index = (long)bindings.size() - 1; index >= 0; --index) {
+                        const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair = bindings[index];
+
+                        if (this->debug) assembly << "\t;  Bound: " << std::get<0>(pair).text << "\n";
+
+                        assembly << this->generate_expr(std::get<1>(pair));
+
+                        const std::string jump = this->constants->next_jump();
+
+                        assembly << "\tmov rax, [rsp]\n"
+                                 << "\tcmp rax, 0\n"
+                                 << "\tjg " << jump << "\n";
+
+                        assembly << this->generate_fail_assertion("non-positive loop bound");
+
+                        assembly << jump << ":\n";
+                    }
+                };
+
+        if (this->debug) assembly << "\t;  Compute all bounds:\n";
+        if (this->debug) assembly << "\t;  Array bounds:\n";
+
+        compute_bounds(array_loop->binding_pairs);
+
+        if (this->debug) assembly << "\t;  Sum bounds:\n";
+        compute_bounds(sum_loop->binding_pairs);
+
+        //  3: Multiply all the array bounds and call `jpl_alloc`.
+        //  ------------------------------------------------------
+
         if (this->debug) assembly << "\t;  Computing total heap size to allocate\n";
 
-        assembly << "\tmov rdi, " << item_size;
+        assembly << "\tmov rdi, " << reg_size;
         if (this->debug) assembly << " ; Size of one element";
         assembly << "\n";
 
-        for (long offset = 0; offset < reg_size * rank; offset += reg_size) {
+        for (long index = 0; index < num_array_bindings; ++index) {
+            const long offset = reg_size * (num_sum_bindings + index);
+
             assembly << "\timul rdi, [rsp + " << offset << "]";
             if (this->debug) assembly << "; Multiply by one dimension";
             assembly << "\n";
@@ -747,59 +917,42 @@ namespace generator {
             const std::string next_jump = this->constants->next_jump();
             assembly << "\tjno " << next_jump << "\n";
 
-            const bool needs_alignment = this->stack.needs_alignment();
-            if (needs_alignment) {
-                assembly << "\tsub rsp, 8";
-                if (this->debug) assembly << " ; Align stack";
-                assembly << "\n";
-                this->stack.push();
-            }
-
-            assembly << "\tlea rdi, [rel " << (*this->constants)[{"overflow computing array size"}] << "]";
-            if (this->debug) assembly << " ; overflow computing array size";
-            assembly << "\n"
-                     << "\tcall _fail_assertion\n";
-
-            if (needs_alignment) {
-                assembly << "\tadd rsp, 8";
-                if (this->debug) assembly << " ; Remove alignment";
-                assembly << "\n";
-                this->stack.pop();
-            }
+            assembly << this->generate_fail_assertion("overflow computing array size");
 
             assembly << next_jump << ":\n";
         }
 
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            assembly << "\tsub rsp, 8";
-            if (this->debug) assembly << " ; Align stack";
-            assembly << "\n";
-            this->stack.push();
-        }
+        assembly << this->generate_aligned_call("_jpl_alloc");
 
-        assembly << "\tcall _jpl_alloc\n";
-
-        if (needs_alignment) {
-            assembly << "\tadd rsp, 8";
-            if (this->debug) assembly << " ; Remove alignment";
-            assembly << "\n";
-            this->stack.pop();
-        }
+        //  4: Save the allocated pointer to the stack in the right place.
+        //  --------------------------------------------------------------
 
-        assembly << "\tmov [rsp + " << reg_size * rank << "], rax";
-        if (this->debug) assembly << " ; Move array pointer to previously-allocated space";
+        assembly << "\tmov [rsp + " << reg_size * total_bindings << "], rax";
+        if (this->debug) assembly << " ; Move array pointer to pre-allocated space";
         assembly << "\n";
 
-        for (long index = rank - 1; index >= 0; --index) {
-            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
-            assembly << "\tmov rax, 0";
-            if (this->debug) assembly << " ; Initialize " << name << " to 0";
-            assembly << "\n"
-                     << "\tpush rax\n";
-            this->stack.push();
-            this->variables.set_variable_address(name, (long)this->stack.size());
-        }
+        //  5: Push a `0` onto the stack for each array/sum variable.
+        //  ---------------------------------------------------------
+
+        const auto initialize_vars =
+                [&assembly, this](const std::vector<ast_node::array_loop_expr_node::binding_pair_t>& bindings) {
+                    for (long index = (long)(bindings.size() - 1); index >= 0; --index) {
+                        const std::string& name = std::get<0>(bindings[index]).text;
+                        if (this->debug) assembly << "\t;  Initialize " << name << " to 0\n";
+
+                        assembly << "\tmov rax, 0\n"
+                                 << "\tpush rax\n";
+
+                        this->stack.push();
+                        this->variables.set_variable_address(name, this->stack.size());
+                    }
+                };
+
+        initialize_vars(array_loop->binding_pairs);
+        initialize_vars(sum_loop->binding_pairs);
+
+        //  6: Begin the loop.
+        //  ------------------
 
         const std::string body_start = this->constants->next_jump();
 
@@ -807,930 +960,3891 @@ namespace generator {
         if (this->debug) assembly << " ; Begin loop body";
         assembly << "\n";
 
-        assembly << this->generate_expr(expression->item_expr);
+        //  7: Compute the body of the sum loop.
+        //  ------------------------------------
+
+        if (this->debug) assembly << "\t;  Compute sum loop body\n";
 
-        if (this->debug) assembly << "\t;  Calculate the index to store the result\n";
+        assembly << this->generate_expr(sum_loop->sum_expr);
 
-        if (this->opt_level >= 1) {
-            assembly << "\tmov rax, [rsp + " << item_size << "]\n";
-        } else {
-            assembly << "\tmov rax, 0\n"
-                     << "\timul rax, [rsp + " << rank * reg_size + item_size << "]\n"
-                     << "\tadd rax, [rsp + " << item_size << "]\n";
-        }
+        //  8: Compute pointer into the array using the array indices.
+        //  ----------------------------------------------------------
 
-        for (long index = 1; index < rank; ++index) {
-            const long offset = reg_size * index + item_size;
-            const std::shared_ptr<ast_node::expr_node>& binding = std::get<1>(expression->binding_pairs[index]);
-            const bool is_literal = this->opt_level >= 1 && binding->type == ast_node::node_type::INTEGER_EXPR;
-            const bool is_const = this->opt_level >= 2 && binding->cp_val.type == ast_node::INT_VALUE;
-            if (is_literal) {
-                assembly << this->generate_assem_mul(
-                        "rax", std::reinterpret_pointer_cast<ast_node::integer_expr_node>(binding)->value);
-            } else if (is_const) {
+        if (this->debug) assembly << "\t;  Compute pointer into the array\n";
+
+        const long var_start = reg_size * (num_sum_bindings + 1);
+        const long bound_start = reg_size * (total_bindings + num_sum_bindings + 1);
+        assembly << "\tmov rax, [rsp + " << var_start << "]\n";
+
+        for (long index = 1; index < num_array_bindings; ++index) {
+            const long offset = reg_size * index;
+            const std::shared_ptr<ast_node::expr_node>& binding = std::get<1>(array_loop->binding_pairs[index]);
+            if (binding->cp_val.type == ast_node::INT_VALUE) {
                 assembly << this->generate_assem_mul("rax", binding->cp_val.int_value);
             } else {
-                assembly << "\timul rax, [rsp + " << rank * reg_size + offset << "]\n";
+                assembly << "\timul rax, [rsp + " << bound_start + offset << "]\n";
             }
-            assembly << "\tadd rax, [rsp + " << offset << "]\n";
+            assembly << "\tadd rax, [rsp + " << var_start + offset << "]\n";
         }
 
-        assembly << this->generate_assem_mul("rax", item_size) << "\tadd rax, [rsp + "
-                 << 2 * rank * reg_size + item_size << "]\n";
+        assembly << "\tshl rax, 3";
+        if (this->debug) assembly << " ; Multiply by size of value";
+        assembly << "\n";
+
+        assembly << "\tadd rax, [rsp + " << reg_size * (2 * total_bindings + 1) << "]\n";
 
-        if (this->debug) assembly << "\t;  Moving " << item_size << "-byte body from [rsp] to [rax]\n";
-        for (long offset = item_size - reg_size; offset >= 0; offset -= reg_size) {
-            if (this->debug) assembly << "\t";
-            assembly << "\tmov r10, [rsp + " << offset << "]\n";
+        //  9: Add the body to the computed pointer.
+        //  ----------------------------------------
 
-            if (this->debug) assembly << "\t";
-            assembly << "\tmov [rax + " << offset << "], r10\n";
+        if (this->debug) assembly << "\t;  Add the body to the pointer\n";
+
+        if (sum_loop->r_type->type == resolved_type::INT_TYPE) {
+            assembly << "\tpop r10\n"
+                     << "\tadd [rax], r10\n";
+        } else {
+            assembly << "\tmovsd xmm0, [rsp]\n"
+                     << "\tadd rsp, 8\n"
+                     << "\taddsd xmm0, [rax]\n"
+                     << "\tmovsd [rax], xmm0\n";
         }
 
-        assembly << "\tadd rsp, " << item_size << "\n";
-        this->stack.pop();
+        //  10: Increment the indices.
+        //  --------------------------
 
-        for (long index = rank - 1; index >= 0; --index) {
-            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
+        if (this->debug) assembly << "\t;  Increment the indices\n";
 
-            if (this->debug) assembly << "\t;  Increment " << name << "\n";
-            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
+        const long offset = reg_size * total_bindings;
 
-            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
-            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
-                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
+        for (long index = (long)array_loop->tc_nodes.size() - 1; index >= 0; --index) {
+            const std::string& name = array_loop->tc_nodes[index];
+            const long base_addr = node_to_address[name];
+
+            if (this->debug) assembly << "\t;  Increment `" << name << "`\n";
+            assembly << "\tadd qword [rsp + " << base_addr << "], 1\n";
+
+            assembly << "\tmov rax, [rsp + " << base_addr << "]\n"
+                     << "\tcmp rax, [rsp + " << base_addr + offset << "]\n"
                      << "\tjl " << body_start;
             if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
             assembly << "\n";
 
             if (index > 0) {
-                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
-                if (this->debug) assembly << " ; Set " << name << " = 0";
+                assembly << "\tmov qword [rsp + " << base_addr << "], 0";
+                if (this->debug) assembly << " ; " << name << " = 0";
                 assembly << "\n";
             }
         }
 
-        assembly << "\tadd rsp, " << reg_size * rank;
+        //        assembly << "\tadd rsp, " << item_size << "\n";
+        //        this->stack.pop();
+        //
+        //        for (long index = rank - 1; index >= 0; --index) {
+        //            const std::string& name = std::get<0>(array_loop->binding_pairs[index]).text;
+        //
+        //            if (this->debug) assembly << "\t;  Increment " << name << "\n";
+        //            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
+        //
+        //            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
+        //            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
+        //                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
+        //                     << "\tjl " << body_start;
+        //            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
+        //            assembly << "\n";
+        //
+        //            if (index > 0) {
+        //                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
+        //                if (this->debug) assembly << " ; Set " << name << " = 0";
+        //                assembly << "\n";
+        //            }
+        //        }
+
+        //  11: Free array and sum indices and sum bounds.
+        //  ----------------------------------------------
+
+        if (this->debug) assembly << "\t;  Clean up\n";
+
+        assembly << "\tadd rsp, " << reg_size * total_bindings;
         if (this->debug) assembly << " ; Free all loop variables";
         assembly << "\n";
-        for (long index = 0; index < 2 * rank + 1; ++index) { this->stack.pop(); }
-        this->stack.push(reg_size * (rank + 1));
 
-        if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
+        assembly << "\tadd rsp, " << reg_size * num_sum_bindings;
+        if (this->debug) assembly << " ; Free all loop bounds";
+        assembly << "\n";
 
-        return assembly.str();
-    }
+        for (long index = 0; index < 2 * (total_bindings + 1); ++index) this->stack.pop();
 
-    std::string generator::generate_expr_binop(const std::shared_ptr<ast_node::binop_expr_node>& expression) {
-        std::stringstream assembly;
+        this->stack.push(reg_size * (num_array_bindings + 1));
 
-        if (this->debug) assembly << "\t;  START generate_expr_binop\n";
+        if (this->debug) assembly << "\t;  END generate_tensor_contraction\n";
 
-        const resolved_type::resolved_type_type operand_type = expression->left_operand->r_type->type;
+        return assembly.str();
+    }
 
-        if (expression->operator_type == ast_node::op_type::BINOP_AND
-            || expression->operator_type == ast_node::op_type::BINOP_OR) {
-            assembly << this->generate_expr(expression->left_operand);
+    std::string generator::generate_expr(const std::shared_ptr<ast_node::expr_node>& expression) {
+        long folded_value;
+        const bool is_foldable = this->opt_level >= 1
+                              && (expression->type == ast_node::BINOP_EXPR || expression->type == ast_node::UNOP_EXPR
+                                  || expression->type == ast_node::IF_EXPR)
+                              && this->constant_int_value(expression, folded_value);
+        if (is_foldable) {
+            std::stringstream assembly;
+
+            if (this->debug) assembly << "\t;  O1: Folded constant expression\n";
+
+            if (generator::fits_into_32(folded_value)) {
+                assembly << "\tpush qword " << folded_value << "\n";
+            } else {
+                assembly << "\tmov rax, " << folded_value << "\n"
+                         << "\tpush rax\n";
+            }
+            this->stack.push();
 
-            const std::string short_circuit_jump = this->constants->next_jump();
-            assembly << "\tpop rax\n";
-            this->stack.pop();
-            assembly << "\tcmp rax, 0\n"
-                     << "\t" << (expression->operator_type == ast_node::op_type::BINOP_AND ? "je" : "jne") << " "
-                     << short_circuit_jump << "\n";
+            return assembly.str();
+        }
 
-            assembly << this->generate_expr(expression->right_operand) << "\tpop rax\n"
-                     << short_circuit_jump << ":\n"
-                     << "\tpush rax\n";
+        if (this->opt_level >= 2
+            && (expression->type == ast_node::ARRAY_LITERAL_EXPR || expression->type == ast_node::BINOP_EXPR
+                || expression->type == ast_node::TUPLE_LITERAL_EXPR)) {
+            std::string assembly;
+            if (this->generate_fused_sums(expression, assembly)) return assembly;
+        }
 
-            if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+        switch (expression->type) {
+            case ast_node::ARRAY_INDEX_EXPR:
+                return this->generate_expr_array_index(
+                        std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression));
+            case ast_node::ARRAY_LITERAL_EXPR:
+                return this->generate_expr_array_literal(
+                        std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(expression));
+            case ast_node::ARRAY_LOOP_EXPR:
+                return this->generate_expr_array_loop(
+                        std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(expression));
+            case ast_node::BINOP_EXPR:
+                return this->generate_expr_binop(std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression));
+            case ast_node::CALL_EXPR:
+                return this->generate_expr_call(std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression));
+            case ast_node::FALSE_EXPR:
+                return this->generate_expr_false(std::reinterpret_pointer_cast<ast_node::false_expr_node>(expression));
+            case ast_node::FLOAT_EXPR:
+                return this->generate_expr_float(std::reinterpret_pointer_cast<ast_node::float_expr_node>(expression));
+            case ast_node::IF_EXPR:
+                return this->generate_expr_if(std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression));
+            case ast_node::INTEGER_EXPR:
+                return this->generate_expr_integer(
+                        std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression));
+            case ast_node::SUM_LOOP_EXPR:
+                return this->generate_expr_sum_loop(
+                        std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(expression));
+            case ast_node::TRUE_EXPR:
+                return this->generate_expr_true(std::reinterpret_pointer_cast<ast_node::true_expr_node>(expression));
+            case ast_node::TUPLE_INDEX_EXPR:
+                return this->generate_expr_tuple_index(
+                        std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression));
+            case ast_node::TUPLE_LITERAL_EXPR:
+                return this->generate_expr_tuple_literal(
+                        std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression));
+            case ast_node::UNOP_EXPR:
+                return this->generate_expr_unop(std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression));
+            case ast_node::VARIABLE_EXPR:
+                return this->generate_expr_variable(
+                        std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression));
+            default:
+                throw std::runtime_error("`generate_expr`: invalid expression: \"" + expression->s_expression() + "\"");
+        }
+    }
+
+    std::string
+    generator::generate_expr_array_index(const std::shared_ptr<ast_node::array_index_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_array_index\n";
+
+        constexpr long reg_size = 8;
+        const long return_size = (long)expression->r_type->size();
+
+        const std::shared_ptr<ast_node::array_loop_expr_node> stage = this->read_stage(expression);
+        if (stage != nullptr) {
+            assembly << this->generate_stage_element(expression, stage, stage->item_expr);
+
+            if (this->debug) assembly << "\t;  END generate_expr_array_index\n";
 
             return assembly.str();
         }
 
-        if (this->opt_level >= 1 && operand_type == resolved_type::resolved_type_type::INT_TYPE
-            && expression->operator_type == ast_node::op_type::BINOP_TIMES) {
-            const bool left_is_literal = expression->left_operand->type == ast_node::node_type::INTEGER_EXPR;
-            const bool left_has_literal_val = expression->left_operand->cp_val.type == ast_node::INT_VALUE;
-            long left_value = 0;
-            if (left_is_literal) {
-                left_value
-                        = std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->left_operand)->value;
-            } else if (left_has_literal_val) {
-                left_value = expression->left_operand->cp_val.int_value;
+        //  An element in a stencil window is read from the window, unless it is out of bounds; then the usual checks
+        //  below fail as they would have.
+        const auto window_use = this->window_uses.find(expression.get());
+        const std::string window_done = (window_use != this->window_uses.end()) ? this->constants->next_jump() : "";
+        if (window_use != this->window_uses.end()) {
+            const std::string out_of_bounds = this->constants->next_jump();
+            const stack_info::stack_info saved_stack = this->stack;
+
+            if (this->debug) assembly << "\t;  O2: Reading from a stencil window\n";
+            assembly << "\tcmp qword [rsp + " << (long)this->stack.size() - window_use->second.second << "], 0\n"
+                     << "\tje " << out_of_bounds << "\n"
+                     << "\tsub rsp, " << return_size << "\n";
+            this->stack.push(return_size);
+
+            const long value_offset = (long)this->stack.size() - window_use->second.first;
+            for (long offset = return_size - reg_size; offset >= 0; offset -= reg_size) {
+                assembly << "\tmov r10, [rsp + " << value_offset + offset << "]\n"
+                         << "\tmov [rsp + " << offset << "], r10\n";
             }
-            const long left_log = generator::log_2(left_value);
+            assembly << "\tjmp " << window_done << "\n" << out_of_bounds << ":\n";
 
-            const bool right_is_literal = expression->right_operand->type == ast_node::node_type::INTEGER_EXPR;
-            const bool right_has_literal_val = expression->right_operand->cp_val.type == ast_node::INT_VALUE;
-            long right_value = 0;
-            if (right_is_literal) {
-                right_value
-                        = std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->right_operand)->value;
-            } else if (right_has_literal_val) {
-                right_value = expression->right_operand->cp_val.int_value;
-            }
-            const long right_log = generator::log_2(right_value);
+            this->stack = saved_stack;
+        }
 
-            if ((left_is_literal || left_has_literal_val) && left_value == 1) {
-                assembly << this->generate_expr(expression->right_operand);
+        assembly << this->generate_element_address(expression);
 
-                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+        assembly << "\tsub rsp, " << return_size << "\n";
+        this->stack.push(return_size);
 
-                return assembly.str();
+        if (this->is_planar(expression->array->r_type)) {
+            if (this->debug) assembly << "\t;  Gathering " << return_size << " bytes from the planes to [rsp]\n";
+            for (long offset = 0; offset < return_size; offset += reg_size) {
+                if (offset > 0) assembly << "\tadd rax, rcx\n";
+                assembly << "\tmov r10, [rax]\n"
+                         << "\tmov [rsp + " << offset << "], r10\n";
             }
+        } else {
+            if (this->debug) assembly << "\t;  Moving " << return_size << " bytes from [rax] to [rsp]\n";
+            for (long offset = return_size - reg_size; offset >= 0; offset -= reg_size) {
+                if (this->debug) assembly << "\t";  //  Extra indentation for debug mode.
+                assembly << "\tmov r10, [rax + " << offset << "]\n";
 
-            if ((right_is_literal || right_has_literal_val) && right_value == 1) {
-                assembly << this->generate_expr(expression->left_operand);
+                if (this->debug) assembly << "\t";  //  Extra indentation for debug mode.
+                assembly << "\tmov [rsp + " << offset << "], r10\n";
+            }
+        }
 
-                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+        if (!window_done.empty()) assembly << window_done << ":\n";
 
-                return assembly.str();
-            }
+        if (this->debug) assembly << "\t;  END generate_expr_array_index\n";
 
-            if ((left_is_literal || left_has_literal_val) && left_log > 0) {
-                assembly << this->generate_expr(expression->right_operand) << "\tpop rax\n"
-                         << "\tshl rax, " << left_log << "\n"
-                         << "\tpush rax\n";
+        return assembly.str();
+    }
 
-                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+    std::string
+    generator::generate_expr_array_literal(const std::shared_ptr<ast_node::array_literal_expr_node>& expression) {
+        std::stringstream assembly;
+        constexpr unsigned int reg_size = 8;
 
-                return assembly.str();
-            }
+        if (this->debug) assembly << "\t;  START generate_expr_array_literal\n";
 
-            if ((right_is_literal || right_has_literal_val) && right_log > 0) {
-                assembly << this->generate_expr(expression->left_operand) << "\tpop rax\n"
-                         << "\tshl rax, " << right_log << "\n"
-                         << "\tpush rax\n";
+        //  Generate assembly from right to left.
+        for (long index = (long)(expression->expressions.size() - 1); index >= 0; index--) {
+            assembly << this->generate_expr(expression->expressions[index]);
+        }
 
-                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+        //  We don't pop from the stack as we go, because sub-expressions need to know the status of the stack.
+        //  We need to pop it all now, though, and replace it with one number.
+        unsigned long total_size = 0;
+        for (long index = 0; index < (long)expression->expressions.size(); index++) { total_size += this->stack.pop(); }
+        this->stack.push(total_size);
 
-                return assembly.str();
+        assembly << "\tmov rdi, " << total_size << "\n";
+
+        assembly << this->generate_aligned_call("_jpl_alloc");
+
+        if (this->debug) assembly << "\t;  Moving " << total_size << " bytes from rsp to rax\n";
+
+        //  Field `f` of element `n` is at `8 * (f * count + n)` in a planar array.
+        const bool is_planar = this->is_planar(expression->r_type);
+        const long count = (long)expression->expressions.size();
+        const long item_size = count > 0 ? (long)total_size / count : 0;
+        for (long offset = reg_size; offset <= (long)total_size; offset += reg_size) {
+            const long source = (long)total_size - offset;
+            const long destination
+                    = is_planar ? (source % item_size) * count + reg_size * (source / item_size) : source;
+
+            //  Extra indentation for debug mode.
+            if (this->debug) assembly << "\t";
+            assembly << "\tmov r10, [rsp + " << source << "]\n";
+
+            if (this->debug) assembly << "\t";
+            assembly << "\tmov [rax + " << destination << "], r10\n";
+        }
+
+        assembly << "\tadd rsp, " << total_size << "\n";
+        this->stack.pop();
+
+        assembly << "\tpush rax\n";
+        //  NOTE: This will probably need to be updated for a rank-2 array.
+        assembly << "\tmov rax, " << expression->expressions.size() << "\n"
+                 << "\tpush rax\n";
+        this->stack.push(expression->r_type->size());
+
+        if (this->debug) assembly << "\t;  END generate_expr_array_literal\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_array_loop(const std::shared_ptr<ast_node::array_loop_expr_node>& expression) {
+        constexpr long reg_size = 8;
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_array_loop\n";
+
+        if (expression->is_tc) {
+            assembly << this->generate_tensor_contraction(expression);
+
+            if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
+
+            return assembly.str();
+        }
+
+        //  A fused pipeline stage only builds its header; its elements are computed where they are read.
+        bool is_pipeline_stage = false;
+        for (const auto& stage : this->pipeline_stages) is_pipeline_stage |= stage.second == expression;
+
+        std::string unswitched;
+        if (!is_pipeline_stage && this->generate_unswitched_loop(expression, unswitched)) {
+            assembly << unswitched;
+
+            if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
+
+            return assembly.str();
+        }
+
+        const std::vector<long> unroll_bounds
+                = is_pipeline_stage ? std::vector<long>() : this->constant_trip_counts(expression->binding_pairs);
+        if (!unroll_bounds.empty()) {
+            assembly << this->generate_unrolled_array_loop(expression, unroll_bounds);
+
+            if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
+
+            return assembly.str();
+        }
+
+        //  A loop over whole arrays runs as one loop over all of its elements.
+        std::vector<std::shared_ptr<ast_node::array_index_expr_node>> linear_reads;
+        const bool is_collapsed = !is_pipeline_stage && this->collapsible_loop(expression, linear_reads);
+        if (is_collapsed) {
+            if (this->debug) assembly << "\t;  O2: Collapsed loop over " << linear_reads.size() << " whole arrays\n";
+            this->remark(expression, "collapsed", "into a single loop");
+        }
+
+        //  Index-set splitting keeps the written order of the loops; otherwise, a dimension may be interchanged to run
+        //  innermost.
+        std::vector<std::pair<long, long>> peels;
+        std::vector<std::unordered_map<const ast_node::expr_node*, long>> decided;
+        const bool is_split = !is_pipeline_stage && !is_collapsed && this->index_set_split(expression, peels, decided);
+        const long inner = (is_split || is_pipeline_stage || is_collapsed) ? (long)expression->binding_pairs.size() - 1
+                                                                           : this->interchanged_dimension(expression);
+        if (inner != (long)expression->binding_pairs.size() - 1) {
+            const std::string& name = std::get<0>(expression->binding_pairs[inner]).text;
+            if (this->debug) assembly << "\t;  O2: Interchanged loops, " << name << " runs innermost\n";
+            this->remark(expression, "interchanged", "so that " + name + " runs innermost");
+        }
+
+        long tile = 0;
+        const long tiled
+                = (is_split || is_pipeline_stage || is_collapsed) ? -1 : this->tiled_dimension(expression, inner, tile);
+        if (tiled >= 0) {
+            const std::string& name = std::get<0>(expression->binding_pairs[tiled]).text;
+            const std::string& inner_name = std::get<0>(expression->binding_pairs[inner]).text;
+            if (this->debug) {
+                assembly << "\t;  O2: Tiled loops, " << tile << "x" << tile << " tiles of " << name << " and "
+                         << inner_name << "\n";
             }
+            this->remark(expression, "tiled",
+                         "in " + std::to_string(tile) + "x" + std::to_string(tile) + " tiles of " + name + " and "
+                                 + inner_name);
         }
 
-        assembly << this->generate_expr(expression->right_operand) << this->generate_expr(expression->left_operand);
+        //  Stencil windows, tile origins, and the element count of a collapsed loop live below the array, and are freed
+        //  once it is built.
+        std::vector<stencil_window> windows = (is_pipeline_stage || is_collapsed || tiled >= 0)
+                                                    ? std::vector<stencil_window>()
+                                                    : this->stencil_windows(expression, inner);
+        long scratch_size = 0;
+        long scratch_pushes = 0;
+        for (stencil_window& window : windows) {
+            this->stack.push();
+            window.row_position = (long)this->stack.size();
+            this->stack.push(window.width * window.element_size);
+            window.values_position = (long)this->stack.size();
+            this->stack.push(8 * window.width);
+            window.flags_position = (long)this->stack.size();
+            scratch_size += 8 + window.width * (window.element_size + 8);
+            scratch_pushes += 3;
+
+            for (const std::pair<std::shared_ptr<ast_node::array_index_expr_node>, long>& use : window.uses) {
+                const long position = use.second - window.offset;
+                this->window_uses[use.first.get()] = {window.values_position - position * window.element_size,
+                                                      window.flags_position - 8 * position};
+            }
+        }
+        if (!windows.empty() && this->debug) {
+            assembly << "\t;  O2: Allocating " << windows.size() << " stencil windows\n";
+        }
 
-        const bool needs_alignment = this->stack.needs_alignment();
+        //  The origins of the current tile along the tiled and innermost dimensions, then the end of the current row.
+        long tile_position = 0;
+        if (tiled >= 0) {
+            this->stack.push(3 * reg_size);
+            tile_position = (long)this->stack.size();
+            scratch_size += 3 * reg_size;
+            scratch_pushes += 1;
+            if (this->debug) assembly << "\t;  O2: Allocating tile origins\n";
+        }
 
-        std::string next_jump;
-        if (operand_type == resolved_type::resolved_type_type::INT_TYPE) {
-            assembly << "\tpop rax\n";
-            this->stack.pop();
-            assembly << "\tpop r10\n";
-            this->stack.pop();
-            switch (expression->operator_type) {
-                case ast_node::BINOP_PLUS:
-                    assembly << "\tadd rax, r10\n";
-                    break;
-                case ast_node::BINOP_MINUS:
-                    assembly << "\tsub rax, r10\n";
-                    break;
-                case ast_node::BINOP_TIMES:
-                    assembly << "\timul rax, r10\n";
-                    break;
-                case ast_node::BINOP_DIVIDE:
-                    next_jump = constants->next_jump();
-                    assembly << "\tcmp r10, 0\n"
-                             << "\tjne " << next_jump << "\n";
+        //  The number of elements of a collapsed loop.
+        long count_position = 0;
+        if (is_collapsed) {
+            this->stack.push();
+            count_position = (long)this->stack.size();
+            scratch_size += reg_size;
+            scratch_pushes += 1;
+        }
+        if (scratch_size > 0) assembly << "\tsub rsp, " << scratch_size << "\n";
 
-                    if (needs_alignment) {
-                        assembly << "\tsub rsp, 8";
-                        if (this->debug) assembly << " ; Align stack";
-                        assembly << "\n";
-                        this->stack.push();
-                    }
+        if (this->debug) assembly << "\t;  Allocating 8 bytes for the array pointer\n";
 
-                    assembly << "\tlea rdi, [rel " << (*this->constants)[{"divide by zero"}] << "]\n"
-                             << "\tcall _fail_assertion\n";
+        assembly << "\tsub rsp, 8\n";
+        this->stack.push();
 
-                    if (needs_alignment) {
-                        assembly << "\tadd rsp, 8";
-                        if (this->debug) assembly << " ; Remove alignment";
-                        assembly << "\n";
-                        this->stack.pop();
-                    }
+        const std::shared_ptr<resolved_type::array_resolved_type> array_r_type
+                = std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(expression->r_type);
+        const long item_size = (long)array_r_type->element_type->size();
+        const long rank = (long)expression->binding_pairs.size();
 
-                    assembly << next_jump << ":\n"
-                             << "\tcqo\n"
-                             << "\tidiv r10\n";
-                    break;
-                case ast_node::BINOP_MOD:
-                    next_jump = constants->next_jump();
-                    assembly << "\tcmp r10, 0\n"
-                             << "\tjne " << next_jump << "\n";
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair
+                    = expression->binding_pairs[index];
+            if (this->debug) assembly << "\t;  Computing bound for " << std::get<0>(pair).text << "\n";
 
-                    if (needs_alignment) {
-                        assembly << "\tsub rsp, 8";
-                        if (this->debug) assembly << " ; Align stack";
-                        assembly << "\n";
-                        this->stack.push();
-                    }
-                    assembly << "\tlea rdi, [rel " << (*this->constants)[{"mod by zero"}] << "]\n"
-                             << "\tcall _fail_assertion\n";
-                    if (needs_alignment) {
-                        assembly << "\tadd rsp, 8";
-                        if (this->debug) assembly << " ; Remove alignment";
-                        assembly << "\n";
-                        this->stack.pop();
-                    }
+            assembly << this->generate_expr(std::get<1>(pair));
 
-                    assembly << next_jump << ":\n"
-                             << "\tcqo\n"
-                             << "\tidiv r10\n"
-                             << "\tmov rax, rdx\n";
-                    break;
-                case ast_node::BINOP_LT:
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsetl al\n"
-                             << "\tand rax, 1\n";
-                    break;
-                case ast_node::BINOP_GT:
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsetg al\n"
-                             << "\tand rax, 1\n";
-                    break;
-                case ast_node::BINOP_EQ:
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsete al\n"
-                             << "\tand rax, 1\n";
-                    break;
-                case ast_node::BINOP_NEQ:
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsetne al\n"
-                             << "\tand rax, 1\n";
-                    break;
-                case ast_node::BINOP_LEQ:
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsetle al\n"
-                             << "\tand rax, 1\n";
-                    break;
-                case ast_node::BINOP_GEQ:
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsetge al\n"
-                             << "\tand rax, 1\n";
-                    break;
-                default:
-                    throw std::runtime_error("`generate_expr_binop`: Invalid expression: \""
-                                             + expression->s_expression() + "\"");
-            }
-            assembly << "\tpush rax\n";
+            const std::string jump = this->constants->next_jump();
+
+            assembly << "\tmov rax, [rsp]\n"
+                     << "\tcmp rax, 0\n"
+                     << "\tjg " << jump << "\n";
+
+            assembly << this->generate_fail_assertion("non-positive loop bound");
+
+            assembly << jump << ":\n";
+        }
+
+        if (this->debug) assembly << "\t;  Computing total heap size to allocate\n";
+
+        assembly << "\tmov rdi, " << item_size;
+        if (this->debug) assembly << " ; Size of one element";
+        assembly << "\n";
+
+        for (long offset = 0; offset < reg_size * rank; offset += reg_size) {
+            assembly << "\timul rdi, [rsp + " << offset << "]";
+            if (this->debug) assembly << "; Multiply by one dimension";
+            assembly << "\n";
+
+            const std::string next_jump = this->constants->next_jump();
+            assembly << "\tjno " << next_jump << "\n";
+
+            assembly << this->generate_fail_assertion("overflow computing array size");
+
+            assembly << next_jump << ":\n";
+        }
+
+        if (is_pipeline_stage) {
+            assembly << "\tmov qword [rsp + " << reg_size * rank << "], 0";
+            if (this->debug) assembly << " ; O2: Fused pipeline stage, no array to allocate";
+            assembly << "\n";
+            for (long index = 0; index < rank + 1; ++index) { this->stack.pop(); }
+            this->stack.push(reg_size * (rank + 1));
+
+            if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
+
+            return assembly.str();
+        }
+
+        assembly << this->generate_aligned_call("_jpl_alloc");
+
+        assembly << "\tmov [rsp + " << reg_size * rank << "], rax";
+        if (this->debug) assembly << " ; Move array pointer to previously-allocated space";
+        assembly << "\n";
+
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
+            assembly << "\tmov rax, 0";
+            if (this->debug) assembly << " ; Initialize " << name << " to 0";
+            assembly << "\n"
+                     << "\tpush rax\n";
             this->stack.push();
-        } else if (operand_type == resolved_type::resolved_type_type::FLOAT_TYPE) {
-            assembly << "\tmovsd xmm0, [rsp]\n"
-                     << "\tadd rsp, 8\n";
-            this->stack.pop();
-            assembly << "\tmovsd xmm1, [rsp]\n"
-                     << "\tadd rsp, 8\n";
+            this->variables.set_variable_address(name, (long)this->stack.size());
+        }
+
+        //  A collapsed loop counts its linear index in its innermost loop variable; the others stay 0.
+        if (is_collapsed) {
+            const long linear_position = (long)this->stack.size() - reg_size * (rank - 1);
+            for (const std::shared_ptr<ast_node::array_index_expr_node>& read : linear_reads) {
+                this->linear_reads[read.get()] = linear_position;
+            }
+
+            assembly << "\tmov rax, [rsp + " << reg_size * rank << "]\n";
+            for (long index = 1; index < rank; ++index) {
+                assembly << "\timul rax, [rsp + " << reg_size * (index + rank) << "]\n";
+            }
+            assembly << "\tmov [rsp + " << (long)this->stack.size() - count_position << "], rax";
+            if (this->debug) assembly << " ; Number of elements";
+            assembly << "\n";
+        }
+
+        const long unroll_factor = this->partial_unroll_factor(expression->item_expr);
+        const long inner_offset = reg_size * inner;
+        const long inner_bound_offset = reg_size * (inner + rank);
+
+        //  The dimensions from outermost to innermost.
+        std::vector<long> order;
+        for (long index = 0; index < rank; ++index) {
+            if (index != inner && index != tiled) order.push_back(index);
+        }
+        if (tiled >= 0) order.push_back(tiled);
+        order.push_back(inner);
+
+        //  Planar arrays hold one 8-byte field of each element per plane.
+        const bool is_planar = this->is_planar(expression->r_type);
+
+        //  Computes the address of the current element into RAX, given the number of bytes above the loop variables.
+        //  For a planar array, that is the address of the first field, and RCX holds the distance between planes.
+        const std::function<std::string(long)> element_address = [&](long extra) {
+            std::stringstream address;
+
+            if (this->debug) address << "\t;  Calculate the index to store the result\n";
+
+            if (is_collapsed) {
+                address << "\tmov rax, [rsp + " << inner_offset + extra << "]\n";
+            } else if (this->opt_level >= 1) {
+                address << "\tmov rax, [rsp + " << extra << "]\n";
+            } else {
+                address << "\tmov rax, 0\n"
+                        << "\timul rax, [rsp + " << rank * reg_size + extra << "]\n"
+                        << "\tadd rax, [rsp + " << extra << "]\n";
+            }
+
+            for (long index = 1; index < rank && !is_collapsed; ++index) {
+                const long offset = reg_size * index + extra;
+                const std::shared_ptr<ast_node::expr_node>& binding = std::get<1>(expression->binding_pairs[index]);
+                const bool is_literal = this->opt_level >= 1 && binding->type == ast_node::node_type::INTEGER_EXPR;
+                const bool is_const = this->opt_level >= 2 && binding->cp_val.type == ast_node::INT_VALUE;
+                if (is_literal) {
+                    address << this->generate_assem_mul(
+                            "rax", std::reinterpret_pointer_cast<ast_node::integer_expr_node>(binding)->value);
+                } else if (is_const) {
+                    address << this->generate_assem_mul("rax", binding->cp_val.int_value);
+                } else {
+                    address << "\timul rax, [rsp + " << rank * reg_size + offset << "]\n";
+                }
+                address << "\tadd rax, [rsp + " << offset << "]\n";
+            }
+
+            address << this->generate_assem_mul("rax", is_planar ? reg_size : item_size) << "\tadd rax, [rsp + "
+                    << 2 * rank * reg_size + extra << "]\n";
+
+            if (is_planar) {
+                address << "\tmov rcx, " << reg_size << "\n";
+                for (long index = 0; index < rank; ++index) {
+                    const std::shared_ptr<ast_node::expr_node>& binding = std::get<1>(expression->binding_pairs[index]);
+                    if (this->opt_level >= 2 && binding->cp_val.type == ast_node::INT_VALUE) {
+                        address << this->generate_assem_mul("rcx", binding->cp_val.int_value);
+                    } else {
+                        address << "\timul rcx, [rsp + " << reg_size * (index + rank) + extra << "]\n";
+                    }
+                }
+            }
+
+            return address.str();
+        };
+
+        //  Generates one copy of the loop body, which stores its result into the array.
+        const std::function<std::string(long)> generate_iteration = [&](long) {
+            std::stringstream iteration;
+
+            if (!windows.empty()) iteration << this->generate_window_update(windows, inner_offset);
+
+            //  A call returning through memory builds its result in the array element itself, unless it is planar.
+            if (!is_planar && this->returns_in_memory(expression->item_expr)) {
+                iteration << this->generate_expr_call(
+                        std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression->item_expr),
+                        element_address);
+
+                return iteration.str();
+            }
+
+            iteration << this->generate_expr(expression->item_expr) << element_address(item_size);
+
+            if (is_planar) {
+                if (this->debug) {
+                    iteration << "\t;  Scattering " << item_size << "-byte body from [rsp] to the planes\n";
+                }
+                for (long offset = 0; offset < item_size; offset += reg_size) {
+                    if (offset > 0) iteration << "\tadd rax, rcx\n";
+                    iteration << "\tmov r10, [rsp + " << offset << "]\n"
+                              << "\tmov [rax], r10\n";
+                }
+            } else {
+                if (this->debug) iteration << "\t;  Moving " << item_size << "-byte body from [rsp] to [rax]\n";
+                for (long offset = item_size - reg_size; offset >= 0; offset -= reg_size) {
+                    if (this->debug) iteration << "\t";
+                    iteration << "\tmov r10, [rsp + " << offset << "]\n";
+
+                    if (this->debug) iteration << "\t";
+                    iteration << "\tmov [rax + " << offset << "], r10\n";
+                }
+            }
+
+            iteration << "\tadd rsp, " << item_size << "\n";
             this->stack.pop();
-            switch (expression->operator_type) {
-                case ast_node::BINOP_PLUS:
-                    assembly << "\taddsd xmm0, xmm1\n"
-                             << "\tsub rsp, 8\n";
-                    this->stack.push();
-                    assembly << "\tmovsd [rsp], xmm0\n";
-                    break;
-                case ast_node::BINOP_MINUS:
-                    assembly << "\tsubsd xmm0, xmm1\n"
-                             << "\tsub rsp, 8\n";
-                    this->stack.push();
-                    assembly << "\tmovsd [rsp], xmm0\n";
-                    break;
-                case ast_node::BINOP_TIMES:
-                    assembly << "\tmulsd xmm0, xmm1\n"
-                             << "\tsub rsp, 8\n";
-                    this->stack.push();
-                    assembly << "\tmovsd [rsp], xmm0\n";
-                    break;
-                case ast_node::BINOP_DIVIDE:
-                    assembly << "\tdivsd xmm0, xmm1\n"
-                             << "\tsub rsp, 8\n";
-                    this->stack.push();
-                    assembly << "\tmovsd [rsp], xmm0\n";
-                    break;
-                case ast_node::BINOP_MOD:
-                    assembly << "\tcall _fmod\n"
-                             << "\tsub rsp, 8\n";
-                    this->stack.push();
-                    assembly << "\tmovsd [rsp], xmm0\n";
-                    break;
-                case ast_node::BINOP_LT:
-                    assembly << "\tcmpltsd xmm0, xmm1\n"
-                             << "\tmovq rax, xmm0\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                case ast_node::BINOP_GT:
-                    assembly << "\tcmpltsd xmm1, xmm0\n"
-                             << "\tmovq rax, xmm1\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                case ast_node::BINOP_EQ:
-                    assembly << "\tcmpeqsd xmm0, xmm1\n"
-                             << "\tmovq rax, xmm0\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                case ast_node::BINOP_NEQ:
-                    assembly << "\tcmpneqsd xmm0, xmm1\n"
-                             << "\tmovq rax, xmm0\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                case ast_node::BINOP_LEQ:
-                    assembly << "\tcmplesd xmm0, xmm1\n"
-                             << "\tmovq rax, xmm0\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                case ast_node::BINOP_GEQ:
-                    assembly << "\tcmplesd xmm1, xmm0\n"
-                             << "\tmovq rax, xmm1\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                default:
-                    throw std::runtime_error("`generate_expr_binop`: invalid expression: \""
-                                             + expression->s_expression() + "\"");
+
+            return iteration.str();
+        };
+
+        const std::string general_start = is_split ? this->constants->next_jump() : "";
+        const std::string loop_end = is_split ? this->constants->next_jump() : "";
+
+        if (is_split) {
+            if (this->debug) assembly << "\t;  O2: Index-set split loop\n";
+
+            //  Every border and interior must be non-empty; otherwise, run the general loop.
+            for (long index = 0; index < rank; ++index) {
+                if (peels[index].first + peels[index].second == 0) continue;
+                assembly << "\tmov rax, [rsp + " << reg_size * (index + rank) << "]\n"
+                         << "\tcmp rax, " << peels[index].first + peels[index].second << "\n"
+                         << "\tjle " << general_start << "\n";
             }
-        } else if (operand_type == resolved_type::resolved_type_type::BOOL_TYPE) {
-            switch (expression->operator_type) {
-                case ast_node::BINOP_EQ:
-                    assembly << "\tpop rax\n";
-                    this->stack.pop();
-                    assembly << "\tpop r10\n";
-                    this->stack.pop();
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsete al\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                case ast_node::BINOP_NEQ:
-                    assembly << "\tpop rax\n";
-                    this->stack.pop();
-                    assembly << "\tpop r10\n";
-                    this->stack.pop();
-                    assembly << "\tcmp rax, r10\n"
-                             << "\tsetne al\n"
-                             << "\tand rax, 1\n"
-                             << "\tpush rax\n";
-                    this->stack.push();
-                    break;
-                default:
-                    throw std::runtime_error("`generate_expr_binop`: invalid expression: \""
-                                             + expression->s_expression() + "\"");
+
+            //  Generates the loops over the given dimension and those inside it. The borders of a split dimension run
+            //  the inner dimensions unsplit; its interior splits them too, and knows its comparisons.
+            const std::function<std::string(long, bool)> generate_dimension = [&](long dim, bool split) {
+                std::stringstream code;
+                if (dim == rank) return generate_iteration(0);
+
+                const std::string& name = std::get<0>(expression->binding_pairs[dim]).text;
+                const long var_offset = reg_size * dim;
+                const long bound_offset = reg_size * (dim + rank);
+                const long lower = peels[dim].first;
+                const long upper = peels[dim].second;
+
+                //  Each segment runs from `start` to `end`, each relative to 0 or to the bound.
+                struct segment {
+                    bool start_relative;
+                    long start;
+                    bool end_relative;
+                    long end;
+                    bool is_interior;
+                };
+                std::vector<segment> segments;
+                if (!split || lower + upper == 0) {
+                    segments.push_back({false, 0, true, 0, split});
+                } else {
+                    if (lower > 0) segments.push_back({false, 0, false, lower, false});
+                    segments.push_back({false, lower, true, -upper, true});
+                    if (upper > 0) segments.push_back({true, -upper, true, 0, false});
+                }
+
+                for (const segment& range : segments) {
+                    if (this->debug && split && lower + upper > 0) {
+                        code << "\t;  O2: " << (range.is_interior ? "Interior" : "Border") << " of " << name << "\n";
+                    }
+
+                    if (range.start_relative) {
+                        code << "\tmov rax, [rsp + " << bound_offset << "]\n"
+                             << "\tadd rax, " << range.start << "\n"
+                             << "\tmov [rsp + " << var_offset << "], rax\n";
+                    } else {
+                        code << "\tmov qword [rsp + " << var_offset << "], " << range.start << "\n";
+                    }
+
+                    const std::string segment_start = this->constants->next_jump();
+                    code << segment_start << ":\n";
+
+                    if (range.is_interior) this->folded_comparisons.insert(decided[dim].begin(), decided[dim].end());
+                    code << generate_dimension(dim + 1, range.is_interior);
+                    if (range.is_interior) {
+                        for (const std::pair<const ast_node::expr_node* const, long>& comparison : decided[dim]) {
+                            this->folded_comparisons.erase(comparison.first);
+                        }
+                    }
+
+                    code << "\tadd qword [rsp + " << var_offset << "], 1\n"
+                         << "\tmov rax, [rsp + " << var_offset << "]\n";
+                    if (range.end_relative) {
+                        code << "\tmov rcx, [rsp + " << bound_offset << "]\n";
+                        if (range.end != 0) code << "\tadd rcx, " << range.end << "\n";
+                        code << "\tcmp rax, rcx\n";
+                    } else {
+                        code << "\tcmp rax, " << range.end << "\n";
+                    }
+                    code << "\tjl " << segment_start;
+                    if (this->debug) code << " ; If " << name << " < end of segment, run next iteration";
+                    code << "\n";
+                }
+
+                return code.str();
+            };
+
+            assembly << generate_dimension(0, true);
+            assembly << "\tjmp " << loop_end << "\n" << general_start << ":\n";
+        }
+
+        const std::string body_start = this->constants->next_jump();
+
+        assembly << body_start << ":";
+        if (this->debug) assembly << " ; Begin loop body";
+        assembly << "\n";
+
+        long first_level = (unroll_factor > 1) ? rank - 2 : rank - 1;
+        if (tiled >= 0) {
+            //  The tiles run over the tiled and innermost dimensions, each tile row by row, inside the loops over the
+            //  other dimensions.
+            const std::string& name = std::get<0>(expression->binding_pairs[tiled]).text;
+            const long tiled_offset = reg_size * tiled;
+            const long tiled_bound_offset = reg_size * (tiled + rank);
+            const long origin_offset = (long)this->stack.size() - tile_position;
+            const long inner_origin_offset = origin_offset + reg_size;
+            const long row_end_offset = origin_offset + 2 * reg_size;
+            const std::string tile_start = this->constants->next_jump();
+            const std::string inner_tile_start = this->constants->next_jump();
+            const std::string row_start = this->constants->next_jump();
+            const std::string row_body = this->constants->next_jump();
+
+            assembly << "\tmov qword [rsp + " << origin_offset << "], 0\n"
+                     << tile_start << ":\n"
+                     << "\tmov qword [rsp + " << inner_origin_offset << "], 0\n"
+                     << inner_tile_start << ":";
+            if (this->debug) assembly << " ; Begin tile";
+            assembly << "\n"
+                     << "\tmov rax, [rsp + " << origin_offset << "]\n"
+                     << "\tmov [rsp + " << tiled_offset << "], rax\n"
+                     << row_start << ":\n"
+                     << "\tmov rax, [rsp + " << inner_origin_offset << "]\n"
+                     << "\tmov [rsp + " << inner_offset << "], rax\n"
+                     << "\tadd rax, " << tile << "\n"
+                     << "\tcmp rax, [rsp + " << inner_bound_offset << "]\n"
+                     << "\tcmovg rax, [rsp + " << inner_bound_offset << "]\n"
+                     << "\tmov [rsp + " << row_end_offset << "], rax";
+            if (this->debug) assembly << " ; End of the row within the tile";
+            assembly << "\n" << row_body << ":\n";
+
+            if (unroll_factor > 1) {
+                assembly << this->generate_partial_unroll(generate_iteration, row_body, unroll_factor, inner_offset,
+                                                          row_end_offset, false);
+            } else {
+                assembly << generate_iteration(0) << "\tadd qword [rsp + " << inner_offset << "], 1\n"
+                         << "\tmov rax, [rsp + " << inner_offset << "]\n"
+                         << "\tcmp rax, [rsp + " << row_end_offset << "]\n"
+                         << "\tjl " << row_body << "\n";
+            }
+
+            if (this->debug) assembly << "\t;  Next row of the tile\n";
+            assembly << "\tadd qword [rsp + " << tiled_offset << "], 1\n"
+                     << "\tmov rax, [rsp + " << origin_offset << "]\n"
+                     << "\tadd rax, " << tile << "\n"
+                     << "\tcmp rax, [rsp + " << tiled_bound_offset << "]\n"
+                     << "\tcmovg rax, [rsp + " << tiled_bound_offset << "]\n"
+                     << "\tcmp [rsp + " << tiled_offset << "], rax\n"
+                     << "\tjl " << row_start;
+            if (this->debug) assembly << " ; If " << name << " < end of tile, run next row";
+            assembly << "\n";
+
+            if (this->debug) assembly << "\t;  Next tile\n";
+            for (const std::pair<long, long>& origin :
+                 {std::make_pair(inner_origin_offset, inner_bound_offset),
+                  std::make_pair(origin_offset, tiled_bound_offset)}) {
+                assembly << "\tmov rax, [rsp + " << origin.first << "]\n"
+                         << "\tadd rax, " << tile << "\n"
+                         << "\tmov [rsp + " << origin.first << "], rax\n"
+                         << "\tcmp rax, [rsp + " << origin.second << "]\n"
+                         << "\tjl " << (origin.first == origin_offset ? tile_start : inner_tile_start) << "\n";
+            }
+
+            first_level = rank - 3;
+        } else if (is_collapsed) {
+            const long count_offset = (long)this->stack.size() - count_position;
+            if (unroll_factor > 1) {
+                assembly << this->generate_partial_unroll(generate_iteration, body_start, unroll_factor, inner_offset,
+                                                          count_offset, false);
+            } else {
+                assembly << generate_iteration(0) << "\tadd qword [rsp + " << inner_offset << "], 1\n"
+                         << "\tmov rax, [rsp + " << inner_offset << "]\n"
+                         << "\tcmp rax, [rsp + " << count_offset << "]\n"
+                         << "\tjl " << body_start << "\n";
+            }
+
+            first_level = -1;
+        } else if (unroll_factor > 1) {
+            assembly << this->generate_partial_unroll(generate_iteration, body_start, unroll_factor, inner_offset,
+                                                      inner_bound_offset, rank > 1);
+        } else {
+            assembly << generate_iteration(0);
+        }
+
+        for (long level = first_level; level >= 0; --level) {
+            const long index = order[level];
+            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
+
+            if (this->debug) assembly << "\t;  Increment " << name << "\n";
+            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
+
+            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
+            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
+                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
+                     << "\tjl " << body_start;
+            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
+            assembly << "\n";
+
+            if (level > 0) {
+                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
+                if (this->debug) assembly << " ; Set " << name << " = 0";
+                assembly << "\n";
+            }
+        }
+
+        if (is_split) assembly << loop_end << ":\n";
+
+        assembly << "\tadd rsp, " << reg_size * rank;
+        if (this->debug) assembly << " ; Free all loop variables";
+        assembly << "\n";
+        for (long index = 0; index < 2 * rank + 1; ++index) { this->stack.pop(); }
+        this->stack.push(reg_size * (rank + 1));
+
+        if (scratch_size > 0) {
+            //  Slide the array down over the stencil windows, tile origins, and element count.
+            for (long offset = reg_size * rank; offset >= 0; offset -= reg_size) {
+                assembly << "\tmov rax, [rsp + " << offset << "]\n"
+                         << "\tmov [rsp + " << offset + scratch_size << "], rax\n";
+            }
+            assembly << "\tadd rsp, " << scratch_size;
+            if (this->debug) assembly << " ; Free stencil windows, tile origins, and element count";
+            assembly << "\n";
+
+            this->stack.pop();
+            for (long index = 0; index < scratch_pushes; ++index) this->stack.pop();
+            this->stack.push(reg_size * (rank + 1));
+
+            for (const stencil_window& window : windows) {
+                for (const std::pair<std::shared_ptr<ast_node::array_index_expr_node>, long>& use : window.uses) {
+                    this->window_uses.erase(use.first.get());
+                }
+            }
+            for (const std::shared_ptr<ast_node::array_index_expr_node>& read : linear_reads) {
+                this->linear_reads.erase(read.get());
+            }
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_array_loop\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_binop(const std::shared_ptr<ast_node::binop_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_binop\n";
+
+        const resolved_type::resolved_type_type operand_type = expression->left_operand->r_type->type;
+
+        if (expression->operator_type == ast_node::op_type::BINOP_AND
+            || expression->operator_type == ast_node::op_type::BINOP_OR) {
+            const bool is_and = expression->operator_type == ast_node::op_type::BINOP_AND;
+            const std::string short_circuit_jump = this->constants->next_jump();
+
+            if (this->opt_level >= 1) {
+                const std::string end_jump = this->constants->next_jump();
+
+                assembly << this->generate_cond_jump(expression->left_operand, !is_and, short_circuit_jump)
+                         << this->generate_expr(expression->right_operand) << "\tjmp " << end_jump << "\n"
+                         << short_circuit_jump << ":\n"
+                         << "\tpush qword " << (is_and ? 0 : 1) << "\n"
+                         << end_jump << ":\n";
+            } else {
+                assembly << this->generate_expr(expression->left_operand);
+
+                assembly << "\tpop rax\n";
+                this->stack.pop();
+                assembly << "\tcmp rax, 0\n"
+                         << "\t" << (is_and ? "je" : "jne") << " " << short_circuit_jump << "\n";
+
+                assembly << this->generate_expr(expression->right_operand) << "\tpop rax\n"
+                         << short_circuit_jump << ":\n"
+                         << "\tpush rax\n";
+            }
+
+            if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+            return assembly.str();
+        }
+
+        if (this->opt_level >= 1 && operand_type == resolved_type::resolved_type_type::INT_TYPE
+            && expression->operator_type == ast_node::op_type::BINOP_TIMES) {
+            const bool left_is_literal = expression->left_operand->type == ast_node::node_type::INTEGER_EXPR;
+            const bool left_has_literal_val = expression->left_operand->cp_val.type == ast_node::INT_VALUE;
+            long left_value = 0;
+            if (left_is_literal) {
+                left_value
+                        = std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->left_operand)->value;
+            } else if (left_has_literal_val) {
+                left_value = expression->left_operand->cp_val.int_value;
+            }
+            const long left_log = generator::log_2(left_value);
+
+            const bool right_is_literal = expression->right_operand->type == ast_node::node_type::INTEGER_EXPR;
+            const bool right_has_literal_val = expression->right_operand->cp_val.type == ast_node::INT_VALUE;
+            long right_value = 0;
+            if (right_is_literal) {
+                right_value
+                        = std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->right_operand)->value;
+            } else if (right_has_literal_val) {
+                right_value = expression->right_operand->cp_val.int_value;
+            }
+            const long right_log = generator::log_2(right_value);
+
+            if ((left_is_literal || left_has_literal_val) && left_value == 1) {
+                assembly << this->generate_expr(expression->right_operand);
+
+                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+                return assembly.str();
+            }
+
+            if ((right_is_literal || right_has_literal_val) && right_value == 1) {
+                assembly << this->generate_expr(expression->left_operand);
+
+                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+                return assembly.str();
+            }
+
+            if ((left_is_literal || left_has_literal_val) && left_log > 0) {
+                assembly << this->generate_expr(expression->right_operand) << "\tpop rax\n"
+                         << "\tshl rax, " << left_log << "\n"
+                         << "\tpush rax\n";
+
+                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+                return assembly.str();
+            }
+
+            if ((right_is_literal || right_has_literal_val) && right_log > 0) {
+                assembly << this->generate_expr(expression->left_operand) << "\tpop rax\n"
+                         << "\tshl rax, " << right_log << "\n"
+                         << "\tpush rax\n";
+
+                if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+                return assembly.str();
+            }
+        }
+
+        long divisor;
+        const bool is_constant_division = this->opt_level >= 1 && operand_type == resolved_type::INT_TYPE
+                                       && (expression->operator_type == ast_node::BINOP_DIVIDE
+                                           || expression->operator_type == ast_node::BINOP_MOD)
+                                       && this->constant_int_value(expression->right_operand, divisor)
+                                       && divisor != 0;
+        if (is_constant_division) {
+            if (this->debug) assembly << "\t;  O1: Division by constant " << divisor << "\n";
+
+            assembly << this->generate_expr(expression->left_operand) << "\tpop rax\n"
+                     << this->generate_assem_div(divisor, expression->operator_type == ast_node::BINOP_MOD)
+                     << "\tpush rax\n";
+
+            if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+            return assembly.str();
+        }
+
+        assembly << this->generate_expr(expression->right_operand) << this->generate_expr(expression->left_operand);
+
+        std::string next_jump;
+        if (operand_type == resolved_type::resolved_type_type::INT_TYPE) {
+            assembly << "\tpop rax\n";
+            this->stack.pop();
+            assembly << "\tpop r10\n";
+            this->stack.pop();
+            switch (expression->operator_type) {
+                case ast_node::BINOP_PLUS:
+                    assembly << "\tadd rax, r10\n";
+                    break;
+                case ast_node::BINOP_MINUS:
+                    assembly << "\tsub rax, r10\n";
+                    break;
+                case ast_node::BINOP_TIMES:
+                    assembly << "\timul rax, r10\n";
+                    break;
+                case ast_node::BINOP_DIVIDE:
+                    next_jump = constants->next_jump();
+                    assembly << "\tcmp r10, 0\n"
+                             << "\tjne " << next_jump << "\n";
+
+                    assembly << this->generate_fail_assertion("divide by zero");
+
+                    assembly << next_jump << ":\n"
+                             << "\tcqo\n"
+                             << "\tidiv r10\n";
+                    break;
+                case ast_node::BINOP_MOD:
+                    next_jump = constants->next_jump();
+                    assembly << "\tcmp r10, 0\n"
+                             << "\tjne " << next_jump << "\n";
+
+                    assembly << this->generate_fail_assertion("mod by zero");
+
+                    assembly << next_jump << ":\n"
+                             << "\tcqo\n"
+                             << "\tidiv r10\n"
+                             << "\tmov rax, rdx\n";
+                    break;
+                case ast_node::BINOP_LT:
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsetl al\n"
+                             << "\tand rax, 1\n";
+                    break;
+                case ast_node::BINOP_GT:
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsetg al\n"
+                             << "\tand rax, 1\n";
+                    break;
+                case ast_node::BINOP_EQ:
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsete al\n"
+                             << "\tand rax, 1\n";
+                    break;
+                case ast_node::BINOP_NEQ:
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsetne al\n"
+                             << "\tand rax, 1\n";
+                    break;
+                case ast_node::BINOP_LEQ:
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsetle al\n"
+                             << "\tand rax, 1\n";
+                    break;
+                case ast_node::BINOP_GEQ:
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsetge al\n"
+                             << "\tand rax, 1\n";
+                    break;
+                default:
+                    throw std::runtime_error("`generate_expr_binop`: Invalid expression: \""
+                                             + expression->s_expression() + "\"");
+            }
+            assembly << "\tpush rax\n";
+            this->stack.push();
+        } else if (operand_type == resolved_type::resolved_type_type::FLOAT_TYPE) {
+            assembly << "\tmovsd xmm0, [rsp]\n"
+                     << "\tadd rsp, 8\n";
+            this->stack.pop();
+            assembly << "\tmovsd xmm1, [rsp]\n"
+                     << "\tadd rsp, 8\n";
+            this->stack.pop();
+            switch (expression->operator_type) {
+                case ast_node::BINOP_PLUS:
+                    assembly << "\taddsd xmm0, xmm1\n"
+                             << "\tsub rsp, 8\n";
+                    this->stack.push();
+                    assembly << "\tmovsd [rsp], xmm0\n";
+                    break;
+                case ast_node::BINOP_MINUS:
+                    assembly << "\tsubsd xmm0, xmm1\n"
+                             << "\tsub rsp, 8\n";
+                    this->stack.push();
+                    assembly << "\tmovsd [rsp], xmm0\n";
+                    break;
+                case ast_node::BINOP_TIMES:
+                    assembly << "\tmulsd xmm0, xmm1\n"
+                             << "\tsub rsp, 8\n";
+                    this->stack.push();
+                    assembly << "\tmovsd [rsp], xmm0\n";
+                    break;
+                case ast_node::BINOP_DIVIDE:
+                    assembly << "\tdivsd xmm0, xmm1\n"
+                             << "\tsub rsp, 8\n";
+                    this->stack.push();
+                    assembly << "\tmovsd [rsp], xmm0\n";
+                    break;
+                case ast_node::BINOP_MOD:
+                    if (this->flags.fast_math) {
+                        if (this->debug) assembly << "\t;  Inline floating-point modulo\n";
+
+                        //  Truncate with SSE2 only. `cvttsd2si` returns `LONG_MIN` for quotients that do not fit,
+                        //  which are either already integers or NaN or infinite, so those are kept as they are.
+                        const std::string truncated = this->constants->next_jump();
+                        assembly << "\tmovapd xmm2, xmm0\n"
+                                 << "\tdivsd xmm2, xmm1\n"
+                                 << "\tcvttsd2si rax, xmm2";
+                        if (this->debug) assembly << " ; Truncate";
+                        assembly << "\n"
+                                 << "\tmov r10, " << LONG_MIN << "\n"
+                                 << "\tcmp rax, r10\n"
+                                 << "\tje " << truncated << "\n"
+                                 << "\tcvtsi2sd xmm2, rax\n"
+                                 << truncated << ":\n"
+                                 << "\tmulsd xmm2, xmm1\n"
+                                 << "\tsubsd xmm0, xmm2\n";
+                    } else {
+                        assembly << this->generate_aligned_call("_fmod");
+                    }
+                    assembly << "\tsub rsp, 8\n";
+                    this->stack.push();
+                    assembly << "\tmovsd [rsp], xmm0\n";
+                    break;
+                case ast_node::BINOP_LT:
+                    assembly << "\tcmpltsd xmm0, xmm1\n"
+                             << "\tmovq rax, xmm0\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                case ast_node::BINOP_GT:
+                    assembly << "\tcmpltsd xmm1, xmm0\n"
+                             << "\tmovq rax, xmm1\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                case ast_node::BINOP_EQ:
+                    assembly << "\tcmpeqsd xmm0, xmm1\n"
+                             << "\tmovq rax, xmm0\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                case ast_node::BINOP_NEQ:
+                    assembly << "\tcmpneqsd xmm0, xmm1\n"
+                             << "\tmovq rax, xmm0\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                case ast_node::BINOP_LEQ:
+                    assembly << "\tcmplesd xmm0, xmm1\n"
+                             << "\tmovq rax, xmm0\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                case ast_node::BINOP_GEQ:
+                    assembly << "\tcmplesd xmm1, xmm0\n"
+                             << "\tmovq rax, xmm1\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                default:
+                    throw std::runtime_error("`generate_expr_binop`: invalid expression: \""
+                                             + expression->s_expression() + "\"");
+            }
+        } else if (operand_type == resolved_type::resolved_type_type::BOOL_TYPE) {
+            switch (expression->operator_type) {
+                case ast_node::BINOP_EQ:
+                    assembly << "\tpop rax\n";
+                    this->stack.pop();
+                    assembly << "\tpop r10\n";
+                    this->stack.pop();
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsete al\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                case ast_node::BINOP_NEQ:
+                    assembly << "\tpop rax\n";
+                    this->stack.pop();
+                    assembly << "\tpop r10\n";
+                    this->stack.pop();
+                    assembly << "\tcmp rax, r10\n"
+                             << "\tsetne al\n"
+                             << "\tand rax, 1\n"
+                             << "\tpush rax\n";
+                    this->stack.push();
+                    break;
+                default:
+                    throw std::runtime_error("`generate_expr_binop`: invalid expression: \""
+                                             + expression->s_expression() + "\"");
+            }
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_call(const std::shared_ptr<ast_node::call_expr_node>& expression,
+                                              const std::function<std::string(long)>& destination) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_call\n";
+
+        const bool is_inline_builtin = this->opt_level >= 1
+                                    && (expression->name == "sqrt" || expression->name == "to_float"
+                                        || expression->name == "to_int");
+        if (is_inline_builtin) {
+            if (this->debug) assembly << "\t;  O1: Inline " << expression->name << "\n";
+
+            assembly << this->generate_expr(expression->call_args[0]);
+
+            if (expression->name == "sqrt") {
+                assembly << "\tsqrtsd xmm0, [rsp]\n"
+                         << "\tmovsd [rsp], xmm0\n";
+            } else if (expression->name == "to_float") {
+                assembly << "\tpxor xmm0, xmm0\n"
+                         << "\tcvtsi2sd xmm0, qword [rsp]\n"
+                         << "\tmovsd [rsp], xmm0\n";
+            } else {
+                //  `cvttsd2si` returns `LONG_MIN` for NaN and out-of-range inputs.
+                //  Map NaN to 0, and saturate large positive values to `LONG_MAX`.
+                const std::string done = this->constants->next_jump();
+                const std::string not_nan = this->constants->next_jump();
+
+                assembly << "\tmovsd xmm0, [rsp]\n"
+                         << "\tcvttsd2si rax, xmm0\n"
+                         << "\tmov r10, " << LONG_MIN << "\n"
+                         << "\tcmp rax, r10\n"
+                         << "\tjne " << done << "\n"
+                         << "\tucomisd xmm0, xmm0\n"
+                         << "\tjnp " << not_nan << "\n"
+                         << "\tmov rax, 0\n"
+                         << "\tjmp " << done << "\n"
+                         << not_nan << ":\n"
+                         << "\tpxor xmm1, xmm1\n"
+                         << "\tucomisd xmm0, xmm1\n"
+                         << "\tjb " << done << "\n"
+                         << "\tmov rax, " << LONG_MAX << "\n"
+                         << done << ":\n"
+                         << "\tmov [rsp], rax\n";
+            }
+
+            if (this->debug) assembly << "\t;  END generate_expr_call\n";
+
+            return assembly.str();
+        }
+
+        const call_signature::call_signature& function = (*this->function_signatures)[expression->name];
+
+        //  1.  If there's a struct return value, allocate space for it on the stack.
+        //  2.  Add padding so the final stack size, before the call, is a multiple of 16 bytes.
+        //  Both are reserved with a single instruction.
+        const bool has_struct_return = function.struct_return;
+        const long struct_bytes = has_struct_return && !destination ? (long)function.ret_type->size() : 0;
+        const long padding = this->stack.alignment_padding(struct_bytes + function.bytes_on_stack);
+        if (struct_bytes + padding > 0) {
+            assembly << "\tsub rsp, " << struct_bytes + padding;
+            if (this->debug) {
+                if (struct_bytes > 0) assembly << (padding > 0 ? " ; Return struct and align stack" : " ; Return struct");
+                else assembly << " ; Align stack";
+            }
+            assembly << "\n";
+        }
+        if (struct_bytes > 0) this->stack.push(struct_bytes);
+        if (padding > 0) this->stack.push(padding);
+
+        //  3.  Compute every stack argument in reverse order (so that they end up on the stack in the normal
+        //  order).
+        //  4.  Compute every register argument in reverse order.
+        for (const unsigned int& index : function.push_order) {
+            assembly << generate_expr(expression->call_args[index]);
+        }
+
+        //  5.  Pop all register arguments into their correct registers.
+        for (const std::string& assem : function.pop_assem) {
+            assembly << assem;
+            this->stack.pop();
+        }
+
+        //  6.  If there's a struct return value, load its address into RDI.
+        if (has_struct_return && destination) {
+            if (this->debug) assembly << "\t;  O1: Returning directly into the destination\n";
+
+            assembly << destination(function.bytes_on_stack + padding) << "\tmov rdi, rax\n";
+        } else if (has_struct_return) {
+            assembly << "\tlea rdi, [rsp + " << function.bytes_on_stack + padding << "]\n";
+        }
+
+        //  7.  Execute the `call` instruction.
+        assembly << "\tcall " << this->callee_symbol(expression) << "\n";
+
+        //  8.  Drop every stack argument.
+        //  9.  Drop the padding, if any. Both are dropped with a single instruction.
+        long dropped_bytes = padding;
+        for (const long arg : function.stack_args) {
+            dropped_bytes += arg;
+            this->stack.pop();
+        }
+        if (padding > 0) {
+            while (this->stack.pop() == 0) {}
+        }
+        if (dropped_bytes > 0) {
+            assembly << "\tadd rsp, " << dropped_bytes;
+            if (this->debug && padding > 0) assembly << " ; Drop stack arguments and alignment";
+            assembly << "\n";
+        }
+
+        //  10. If the return value is in a register, push it onto the stack.
+        switch (function.ret_type->type) {
+            case resolved_type::FLOAT_TYPE:
+                assembly << "\tsub rsp, 8\n"
+                         << "\tmovsd [rsp], xmm0\n";
+                this->stack.push();
+                break;
+            case resolved_type::BOOL_TYPE:
+            case resolved_type::INT_TYPE:
+                assembly << "\tpush rax\n";
+                this->stack.push();
+                break;
+            default:
+                if (!function.ret_registers.empty()) {
+                    if (this->debug) assembly << "\t;  O1: Spilling the returned registers\n";
+
+                    assembly << "\tsub rsp, " << function.ret_type->size() << "\n";
+                    for (const std::pair<long, std::string>& reg : function.ret_registers) {
+                        assembly << "\t" << (reg.second.rfind("xmm", 0) == 0 ? "movsd" : "mov") << " [rsp + "
+                                 << reg.first << "], " << reg.second << "\n";
+                    }
+                    this->stack.push(function.ret_type->size());
+                } else if (!has_struct_return) {
+                    this->stack.push(0);
+                }
+                break;
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_call\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_false(const std::shared_ptr<ast_node::false_expr_node>&) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_false\n";
+
+        if (this->opt_level >= 1) {
+            assembly << "\tpush qword 0";
+            if (this->debug) assembly << " ; False";
+            assembly << "\n";
+            this->stack.push();
+        } else {
+            assembly << "\tmov rax, [rel " << (*this->constants)[(long)0] << "]";
+            if (this->debug) assembly << " ; False";
+            assembly << "\n"
+                     << "\tpush rax\n";
+            this->stack.push();
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_false\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_float(const std::shared_ptr<ast_node::float_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_float\n";
+
+        assembly << "\tmov rax, [rel " << (*this->constants)[expression->value] << "]";
+        if (this->debug) assembly << " ; " << expression->value;
+        assembly << "\n\tpush rax\n";
+        this->stack.push();
+
+        if (this->debug) assembly << "\t;  END generate_expr_float\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_if(const std::shared_ptr<ast_node::if_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_if\n";
+
+        const auto unswitched = this->unswitched_ifs.find(expression.get());
+        if (unswitched != this->unswitched_ifs.end()) {
+            if (this->debug) assembly << "\t;  O2: Condition tested outside the loop\n";
+            assembly << this->generate_expr(unswitched->second ? expression->affirmative_expr
+                                                               : expression->negative_expr);
+
+            if (this->debug) assembly << "\t;  END generate_expr_if\n";
+
+            return assembly.str();
+        }
+
+        const bool is_bool_cast
+                = (this->opt_level >= 1)
+               && ((expression->affirmative_expr->cp_val.type == ast_node::INT_VALUE
+                    && expression->negative_expr->cp_val.type == ast_node::INT_VALUE
+                    && expression->affirmative_expr->cp_val.int_value == 1
+                    && expression->negative_expr->cp_val.int_value == 0)
+                   || (expression->affirmative_expr->type == ast_node::node_type::INTEGER_EXPR
+                       && expression->negative_expr->type == ast_node::node_type::INTEGER_EXPR
+                       && std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->affirmative_expr)
+                                          ->value
+                                  == 1
+                       && std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->negative_expr)->value
+                                  == 0));
+
+        const long affirmative_cost = generator::speculation_cost(expression->affirmative_expr);
+        const long negative_cost = generator::speculation_cost(expression->negative_expr);
+        const resolved_type::resolved_type_type result_type = expression->r_type->type;
+        const bool is_branchless = (this->opt_level >= 1) && affirmative_cost >= 0 && negative_cost >= 0
+                                && affirmative_cost + negative_cost <= generator::max_branchless_cost
+                                && (result_type == resolved_type::INT_TYPE || result_type == resolved_type::BOOL_TYPE
+                                    || result_type == resolved_type::FLOAT_TYPE);
+
+        long condition_value;
+        if (this->opt_level >= 1 && this->constant_int_value(expression->conditional_expr, condition_value)) {
+            if (this->debug) assembly << "\t;  O1: Constant condition\n";
+
+            assembly << this->generate_expr(condition_value != 0 ? expression->affirmative_expr
+                                                                 : expression->negative_expr);
+        } else if (is_bool_cast) {
+            if (this->debug) assembly << "\t;  O1: Boolean cast\n";
+
+            assembly << this->generate_expr(expression->conditional_expr);
+        } else if (is_branchless) {
+            if (this->debug) assembly << "\t;  O1: Branchless select\n";
+
+            assembly << this->generate_expr(expression->conditional_expr)
+                     << this->generate_expr(expression->affirmative_expr)
+                     << this->generate_expr(expression->negative_expr);
+
+            if (result_type == resolved_type::FLOAT_TYPE) {
+                assembly << "\tmovsd xmm1, [rsp]\n"
+                         << "\tmovsd xmm0, [rsp + 8]\n"
+                         << "\tmov rax, [rsp + 16]\n"
+                         << "\tadd rsp, 16\n"
+                         << "\tneg rax";
+                if (this->debug) assembly << " ; All ones if the condition is true";
+                assembly << "\n"
+                         << "\tmovq xmm2, rax\n"
+                         << "\tandpd xmm0, xmm2\n"
+                         << "\tandnpd xmm2, xmm1\n"
+                         << "\torpd xmm0, xmm2\n"
+                         << "\tmovsd [rsp], xmm0\n";
+            } else {
+                assembly << "\tpop r10\n"
+                         << "\tpop rax\n"
+                         << "\tpop r11\n"
+                         << "\tcmp r11, 0\n"
+                         << "\tcmove rax, r10\n"
+                         << "\tpush rax\n";
+            }
+            this->stack.pop();
+            this->stack.pop();
+        } else {
+            const std::string jump_1 = this->constants->next_jump();
+            const std::string jump_2 = this->constants->next_jump();
+
+            assembly << this->generate_cond_jump(expression->conditional_expr, false, jump_1);
+
+            assembly << this->generate_expr(expression->affirmative_expr);
+            this->stack.pop();
+
+            assembly << "\tjmp " << jump_2 << "\n";
+
+            assembly << jump_1 << ":\n";
+            assembly << this->generate_expr(expression->negative_expr);
+
+            assembly << jump_2 << ":\n";
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_if\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_integer(const std::shared_ptr<ast_node::integer_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_integer\n";
+
+        const bool push_literal = (this->opt_level >= 1) && generator::fits_into_32(expression->value);
+
+        if (push_literal) {
+            assembly << "\tpush qword " << expression->value << "\n";
+            this->stack.push();
+        } else {
+            assembly << "\tmov rax, [rel " << (*this->constants)[expression->value] << "]";
+            if (this->debug) assembly << " ; " << expression->value;
+            assembly << "\n"
+                     << "\tpush rax\n";
+            this->stack.push();
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_integer\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_sum_loop(const std::shared_ptr<ast_node::sum_loop_expr_node>& expression) {
+        constexpr long reg_size = 8;
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_sum_loop\n";
+
+        const auto fused = this->fused_sums.find(expression.get());
+        if (fused != this->fused_sums.end()) {
+            assembly << "\tpush qword [rsp + " << (long)this->stack.size() - fused->second << "]";
+            if (this->debug) assembly << " ; Fused sum";
+            assembly << "\n";
+            this->stack.push();
+
+            if (this->debug) assembly << "\t;  END generate_expr_sum_loop\n";
+
+            return assembly.str();
+        }
+
+        std::string unswitched;
+        if (this->generate_unswitched_loop(expression, unswitched)) {
+            assembly << unswitched;
+
+            if (this->debug) assembly << "\t;  END generate_expr_sum_loop\n";
+
+            return assembly.str();
+        }
+
+        const bool is_int = expression->r_type->type == resolved_type::INT_TYPE;
+
+        //  At O2, an integer sum whose body is a low-degree polynomial in the loop variables has a closed form.
+        loop_polynomial polynomial;
+        bool closed_form = false;
+        if (this->opt_level >= 2 && is_int) {
+            std::vector<std::string> loop_vars;
+            for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair :
+                 expression->binding_pairs) {
+                loop_vars.push_back(std::get<0>(pair).text);
+            }
+            closed_form = this->polynomial_form(expression->sum_expr, loop_vars, polynomial);
+        }
+
+        const std::vector<long> unroll_bounds
+                = closed_form ? std::vector<long>() : this->constant_trip_counts(expression->binding_pairs);
+        if (!unroll_bounds.empty()) {
+            assembly << this->generate_unrolled_sum_loop(expression, unroll_bounds);
+
+            if (this->debug) assembly << "\t;  END generate_expr_sum_loop\n";
+
+            return assembly.str();
+        }
+
+        const long unroll_factor = closed_form ? 1 : this->partial_unroll_factor(expression->sum_expr);
+        //  Integer addition is associative, even with wraparound; floating-point addition is not.
+        const long accumulators = (unroll_factor > 1 && (is_int || this->flags.fast_math)) ? unroll_factor : 1;
+
+        if (this->debug) assembly << "\t;  Allocating " << reg_size * accumulators << " bytes for the sum\n";
+
+        assembly << "\tsub rsp, " << reg_size * accumulators << "\n";
+        this->stack.push(reg_size * accumulators);
+
+        const long rank = (long)expression->binding_pairs.size();
+
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair
+                    = expression->binding_pairs[index];
+            if (this->debug) assembly << "\t;  Computing bound for " << std::get<0>(pair).text << "\n";
+
+            assembly << this->generate_expr(std::get<1>(pair));
+
+            const std::string jump = this->constants->next_jump();
+
+            assembly << "\tmov rax, [rsp]\n"
+                     << "\tcmp rax, 0\n"
+                     << "\tjg " << jump << "\n";
+
+            assembly << this->generate_fail_assertion("non-positive loop bound");
+
+            assembly << jump << ":\n";
+        }
+
+        if (this->debug) assembly << "\t;  Initializing sum to 0\n";
+
+        assembly << "\tmov rax, 0\n";
+        for (long accumulator = 0; accumulator < accumulators; ++accumulator) {
+            assembly << "\tmov [rsp + " << reg_size * (rank + accumulator) << "], rax";
+            if (this->debug) assembly << " ; Move to pre-allocated space";
+            assembly << "\n";
+        }
+
+        if (closed_form) {
+            assembly << this->generate_closed_form_sum(polynomial);
+
+            assembly << "\tadd rsp, " << reg_size * rank;
+            if (this->debug) assembly << " ; Free all loop bounds";
+            assembly << "\n";
+            for (long index = 0; index < rank; ++index) { this->stack.pop(); }
+
+            if (this->debug) assembly << "\t;  END generate_expr_sum_loop\n";
+
+            return assembly.str();
+        }
+
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
+            assembly << "\tmov rax, 0";
+            if (this->debug) assembly << " ; Initialize " << name << " to 0";
+            assembly << "\n"
+                     << "\tpush rax\n";
+            this->stack.push();
+            this->variables.set_variable_address(name, (long)this->stack.size());
+        }
+
+        //  Generates one copy of the loop body, which adds its value to the given accumulator.
+        //  The final accumulator (the one left on the stack) is at the highest address.
+        const std::function<std::string(long)> generate_iteration = [&](long copy) {
+            std::stringstream iteration;
+
+            iteration << this->generate_expr(expression->sum_expr);
+
+            const long offset = 2 * reg_size * rank + reg_size * ((accumulators > 1) ? copy : 0);
+            if (is_int) {
+                iteration << "\tpop rax\n";
+                this->stack.pop();
+
+                iteration << "\tadd [rsp + " << offset << "], rax";
+                if (this->debug) iteration << " ; Add loop body to sum";
+                iteration << "\n";
+            } else {
+                iteration << "\tmovsd xmm0, [rsp]\n"
+                          << "\tadd rsp, 8\n";
+                this->stack.pop();
+
+                iteration << "\taddsd xmm0, [rsp + " << offset << "]";
+                if (this->debug) iteration << " ; Load sum";
+                iteration << "\n";
+
+                iteration << "\tmovsd [rsp + " << offset << "], xmm0";
+                if (this->debug) iteration << " ; Store sum";
+                iteration << "\n";
+            }
+
+            return iteration.str();
+        };
+
+        const std::string body_start = this->constants->next_jump();
+
+        assembly << body_start << ":";
+        if (this->debug) assembly << " ; Begin loop body";
+        assembly << "\n";
+
+        if (unroll_factor > 1) {
+            assembly << this->generate_partial_unroll(generate_iteration, body_start, unroll_factor,
+                                                      reg_size * (rank - 1), reg_size * (2 * rank - 1), rank > 1);
+        } else {
+            assembly << generate_iteration(0);
+        }
+
+        for (long index = (unroll_factor > 1) ? rank - 2 : rank - 1; index >= 0; --index) {
+            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
+
+            if (this->debug) assembly << "\t;  Increment " << name << "\n";
+            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
+
+            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
+            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
+                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
+                     << "\tjl " << body_start;
+            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
+            assembly << "\n";
+
+            if (index > 0) {
+                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
+                if (this->debug) assembly << " ; Set " << name << " = 0";
+                assembly << "\n";
+            }
+        }
+
+        assembly << "\tadd rsp, " << reg_size * rank;
+        if (this->debug) assembly << " ; Free all loop variables";
+        assembly << "\n";
+        for (long index = 0; index < rank; ++index) { this->stack.pop(); }
+        assembly << "\tadd rsp, " << reg_size * rank;
+        if (this->debug) assembly << " ; Free all loop bounds";
+        assembly << "\n";
+        for (long index = 0; index < rank; ++index) { this->stack.pop(); }
+
+        if (accumulators > 1) {
+            const long final_offset = reg_size * (accumulators - 1);
+            if (this->debug) assembly << "\t;  Combine " << accumulators << " independent accumulators\n";
+            if (is_int) {
+                for (long accumulator = 0; accumulator < accumulators - 1; ++accumulator) {
+                    assembly << "\tmov rax, [rsp + " << reg_size * accumulator << "]\n"
+                             << "\tadd [rsp + " << final_offset << "], rax\n";
+                }
+            } else {
+                assembly << "\tmovsd xmm0, [rsp + " << final_offset << "]\n";
+                for (long accumulator = 0; accumulator < accumulators - 1; ++accumulator) {
+                    assembly << "\taddsd xmm0, [rsp + " << reg_size * accumulator << "]\n";
+                }
+                assembly << "\tmovsd [rsp + " << final_offset << "], xmm0\n";
+            }
+
+            assembly << "\tadd rsp, " << final_offset;
+            if (this->debug) assembly << " ; Free extra accumulators";
+            assembly << "\n";
+            this->stack.pop();
+            this->stack.push();
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_sum_loop\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_true(const std::shared_ptr<ast_node::true_expr_node>&) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_true\n";
+
+        if (this->opt_level >= 1) {
+            assembly << "\tpush qword 1";
+            if (this->debug) assembly << " ; True";
+            assembly << "\n";
+            this->stack.push();
+        } else {
+            assembly << "\tmov rax, [rel " << (*this->constants)[(long)1] << "]";
+            if (this->debug) assembly << " ; True";
+            assembly << "\n"
+                     << "\tpush rax\n";
+            this->stack.push();
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_true\n";
+
+        return assembly.str();
+    }
+
+    std::string
+    generator::generate_expr_tuple_index(const std::shared_ptr<ast_node::tuple_index_expr_node>& expression) {
+        std::stringstream assembly;
+
+        constexpr unsigned int reg_size = 8;
+
+        if (this->debug) assembly << "\t;  START generate_expr_tuple_index\n";
+
+        const unsigned int element_index = expression->index->value;
+
+        //  Only the field that is read is computed of a fused pipeline stage with a tuple literal body.
+        const std::shared_ptr<ast_node::array_loop_expr_node> stage = this->read_stage(expression->expr);
+        if (stage != nullptr && stage->item_expr->type == ast_node::TUPLE_LITERAL_EXPR) {
+            assembly << this->generate_stage_element(
+                    std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression->expr), stage,
+                    std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(stage->item_expr)
+                            ->exprs[element_index]);
+
+            if (this->debug) assembly << "\t;  END generate_expr_tuple_index\n";
+
+            return assembly.str();
+        }
+        const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
+                = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(expression->expr->r_type);
+        const unsigned int element_size = tuple_type->element_types[element_index]->size();
+        const long element_offset = (long)tuple_type->offset(element_index);
+
+        //  Copy only the selected element when the tuple is in memory already or is an array element.
+        std::string tuple_reg;
+        long tuple_offset = 0;
+        const bool is_in_place = this->opt_level >= 1
+                              && this->memory_operand(expression->expr, tuple_reg, tuple_offset);
+        const bool is_element = this->opt_level >= 1 && !is_in_place && this->is_element_in_memory(expression->expr);
+        if (is_in_place || is_element) {
+            //  A field of a planar element is in the field's plane.
+            long field_offset = element_offset;
+            if (is_element) {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression->expr);
+                assembly << this->generate_element_address(array_index);
+                if (this->is_planar(array_index->array->r_type) && element_index > 0) {
+                    assembly << "\timul rcx, " << element_index << "\n"
+                             << "\tadd rax, rcx\n";
+                    field_offset = 0;
+                }
+            }
+
+            if (this->debug) assembly << "\t;  O1: Moving the " << element_size << "-byte element in place\n";
+
+            assembly << "\tsub rsp, " << element_size << "\n";
+            this->stack.push(element_size);
+
+            for (long mov_offset = (long)element_size - reg_size; mov_offset >= 0; mov_offset -= reg_size) {
+                if (this->debug) assembly << "\t";
+                if (is_in_place) {
+                    assembly << "\tmov r10, [" << tuple_reg << " - " << tuple_offset - element_offset - mov_offset
+                             << "]\n";
+                } else {
+                    assembly << "\tmov r10, [rax + " << field_offset + mov_offset << "]\n";
+                }
+
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov [rsp + " << mov_offset << "], r10\n";
+            }
+
+            if (this->debug) assembly << "\t;  END generate_expr_tuple_index\n";
+
+            return assembly.str();
+        }
+
+        assembly << this->generate_expr(expression->expr);
+        const long destination = (long)tuple_type->size() - element_size;  //  NOLINT(*-narrowing-conversions)
+
+        if (this->debug)
+            assembly << "\t;  Moving " << element_size << " bytes from rsp + " << element_offset << " to rsp + "
+                     << destination << "\n";
+
+        if (element_size > 0) {
+            for (long mov_offset = (long)(element_size - reg_size); mov_offset >= 0; mov_offset -= reg_size) {
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov r10, [rsp + " << element_offset << " + " << mov_offset << "]\n";
+
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov [rsp + " << destination << " + " << mov_offset << "], r10\n";
+            }
+
+            this->stack.pop();
+            this->stack.push(element_size);
+        }
+
+        assembly << "\tadd rsp, " << tuple_type->size() - element_size << "\n";
+
+        if (this->debug) assembly << "\t;  END generate_expr_tuple_index\n";
+
+        return assembly.str();
+    }
+
+    std::string
+    generator::generate_expr_tuple_literal(const std::shared_ptr<ast_node::tuple_literal_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_tuple_literal\n";
+
+        //  Generate assembly from right to left.
+        for (long index = (long)(expression->exprs.size() - 1); index >= 0; index--) {
+            assembly << this->generate_expr(expression->exprs[index]);
+        }
+
+        //  We don't pop from the stack as we go, because sub-expressions need to know the status of the stack.
+        //  We need to pop it all now, though, and replace it with one number.
+        for (long index = 0; index < (long)(expression->exprs.size()); index++) { this->stack.pop(); }
+        this->stack.push(expression->r_type->size());
+
+        if (this->debug) assembly << "\t;  END generate_expr_tuple_literal\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_unop(const std::shared_ptr<ast_node::unop_expr_node>& expression) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  START generate_expr_unop\n";
+
+        assembly << this->generate_expr(expression->operand);
+
+        if (expression->operator_type == ast_node::UNOP_INV) {
+            assembly << "\tpop rax\n";
+            this->stack.pop();
+            assembly << "\txor rax, 1\n"
+                     << "\tpush rax\n";
+            this->stack.push();
+        } else {
+            if (expression->r_type->type == resolved_type::resolved_type_type::INT_TYPE) {
+                assembly << "\tpop rax\n";
+                this->stack.pop();
+                assembly << "\tneg rax\n"
+                         << "\tpush rax\n";
+                this->stack.push();
+            } else {
+                assembly << "\tmovsd xmm1, [rsp]\n"
+                         << "\tadd rsp, 8\n";
+                this->stack.pop();
+                assembly << "\tpxor xmm0, xmm0\n"
+                         << "\tsubsd xmm0, xmm1\n"
+                         << "\tsub rsp, 8\n";
+                this->stack.push();
+                assembly << "\tmovsd [rsp], xmm0\n";
+            }
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_unop\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_expr_variable(const std::shared_ptr<ast_node::variable_expr_node>& expression) {
+        std::stringstream assembly;
+        constexpr unsigned int reg_size = 8;
+
+        if (this->debug) assembly << "\t;  START generate_expr_variable\n";
+
+        const ast_node::cp_value& cp_val = expression->cp_val;
+        long constant_value;
+        if (this->variables.get_variable_constant(expression->name, constant_value)) {
+            if (this->debug) assembly << "\t;  O2: pushing unrolled loop variable\n";
+
+            if (generator::fits_into_32(constant_value)) {
+                assembly << "\tpush qword " << constant_value << "\n";
+            } else {
+                assembly << "\tmov rax, " << constant_value << "\n"
+                         << "\tpush rax\n";
+            }
+            this->stack.push();
+        } else if (cp_val.type == ast_node::INT_VALUE && generator::fits_into_32(cp_val.int_value)) {
+            if (this->debug) assembly << "\t;  O2: pushing integer constant\n";
+
+            this->stack.push();
+
+            assembly << "\tpush qword " << cp_val.int_value << "\n";
+        } else {
+            const unsigned int size = expression->r_type->size();
+            assembly << "\tsub rsp, " << size << "\n";
+            this->stack.push(size);
+
+            const std::tuple<std::string, long> variable_address = this->variables.get_variable_address(
+                    expression->name);
+            const std::string reg = std::get<0>(variable_address);
+            const long reg_offset = std::get<1>(variable_address);
+
+            if (debug)
+                assembly << "\t;  Moving " << size << " bytes from [" << reg << " - " << reg_offset << "] to [rsp]\n";
+
+            for (long offset = reg_size; offset <= (long)size; offset += reg_size) {
+                //  Extra indentation for debug mode.
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov r10, [" << reg << " - " << reg_offset - size + offset << "]\n";
+
+                if (this->debug) assembly << "\t";
+                assembly << "\tmov [rsp + " << size - offset << "], r10\n";
+            }
+        }
+
+        if (this->debug) assembly << "\t;  END generate_expr_variable\n";
+
+        return assembly.str();
+    }
+
+    void generator::bind_argument(const std::shared_ptr<ast_node::argument_node>& argument,
+                                  const std::shared_ptr<resolved_type::resolved_type>& r_type) {
+        this->stack.push(r_type->size());
+        if (argument->type == ast_node::ARRAY_ARGUMENT) {
+            const std::shared_ptr<ast_node::array_argument_node> array_argument
+                    = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
+
+            this->variables.set_variable_address(array_argument->name, (long)this->stack.size());
+
+            long offset = 0;
+            constexpr int reg_size = 8;
+            for (const token::token& size_argument : array_argument->dimension_vars) {
+                this->variables.set_variable_address(size_argument.text, (long)this->stack.size() - offset);
+                offset += reg_size;
+            }
+        } else {
+            const std::shared_ptr<ast_node::variable_argument_node> variable_argument
+                    = std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument);
+
+            this->variables.set_variable_address(variable_argument->name, (long)this->stack.size());
+        }
+    }
+
+    void generator::bind_lvalue(const std::shared_ptr<ast_node::lvalue_node>& lvalue,
+                                const std::shared_ptr<resolved_type::resolved_type>& r_type) {
+        if (lvalue->type == ast_node::ARGUMENT_LVALUE) {
+            this->bind_argument(std::reinterpret_pointer_cast<ast_node::argument_lvalue_node>(lvalue)->argument,
+                                r_type);
+        } else {
+            const std::shared_ptr<ast_node::tuple_lvalue_node> tuple_lvalue
+                    = std::reinterpret_pointer_cast<ast_node::tuple_lvalue_node>(lvalue);
+            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_r_type
+                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(r_type);
+
+            for (long index = (long)tuple_lvalue->lvalues.size() - 1; index >= 0; index--) {
+                bind_lvalue(tuple_lvalue->lvalues[index], tuple_r_type->element_types[index]);
+            }
+        }
+    }
+
+    std::string generator::generate_closed_form_sum(const loop_polynomial& polynomial) {
+        constexpr long reg_size = 8;
+        //  The inverse of 3 modulo 2^64, for exact division by 3.
+        constexpr unsigned long inverse_of_3 = 0xAAAAAAAAAAAAAAABUL;
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  O2: Closed-form sum\n";
+
+        for (const std::pair<const std::vector<long>, std::vector<invariant_term>>& monomial : polynomial) {
+            const std::vector<long>& exponents = monomial.first;
+            const long rank = (long)exponents.size();
+
+            for (const invariant_term& term : monomial.second) {
+                if (term.scale == 0) continue;
+
+                //  Coefficient.
+                for (const std::shared_ptr<ast_node::expr_node>& factor : term.factors) {
+                    assembly << this->generate_expr(factor);
+                }
+                if (term.factors.empty()) {
+                    assembly << "\tmov r11, " << term.scale << "\n";
+                } else {
+                    assembly << "\tpop r11\n";
+                    this->stack.pop();
+                    for (unsigned long index = 1; index < term.factors.size(); ++index) {
+                        assembly << "\tpop rax\n"
+                                 << "\timul r11, rax\n";
+                        this->stack.pop();
+                    }
+                    if (term.scale != 1) {
+                        if (generator::fits_into_32(term.scale)) {
+                            assembly << "\timul r11, r11, " << term.scale << "\n";
+                        } else {
+                            assembly << "\tmov rax, " << term.scale << "\n"
+                                     << "\timul r11, rax\n";
+                        }
+                    }
+                }
+
+                //  Power sums of the loop variables.
+                for (long index = 0; index < rank; ++index) {
+                    const std::string bound = "[rsp + " + std::to_string(reg_size * index) + "]";
+                    if (exponents[index] == 0) {
+                        assembly << "\timul r11, " << bound;
+                        if (this->debug) assembly << " ; Sum of 1";
+                        assembly << "\n";
+                        continue;
+                    }
+
+                    //  N(N-1) is computed in 128 bits so that halving it is exact.
+                    assembly << "\tmov rax, " << bound << "\n"
+                             << "\tlea rcx, [rax - 1]\n"
+                             << "\tmul rcx\n"
+                             << "\tshrd rax, rdx, 1";
+                    if (this->debug) assembly << " ; N(N-1)/2";
+                    assembly << "\n";
+
+                    if (exponents[index] == 2) {
+                        //  N(N-1)(2N-1)/6 = 2 * N(N-1)(N-2)/6 + N(N-1)/2.
+                        assembly << "\tmov r8, rax\n"
+                                 << "\tmov rcx, " << bound << "\n"
+                                 << "\tsub rcx, 2\n"
+                                 << "\timul rax, rcx\n"
+                                 << "\tmov rcx, " << inverse_of_3 << "\n"
+                                 << "\timul rax, rcx";
+                        if (this->debug) assembly << " ; N(N-1)(N-2)/6";
+                        assembly << "\n"
+                                 << "\tlea rax, [r8 + 2 * rax]";
+                        if (this->debug) assembly << " ; N(N-1)(2N-1)/6";
+                        assembly << "\n";
+                    }
+
+                    assembly << "\timul r11, rax\n";
+                }
+
+                assembly << "\tadd [rsp + " << reg_size * rank << "], r11";
+                if (this->debug) assembly << " ; Add term to sum";
+                assembly << "\n";
+            }
+        }
+
+        return assembly.str();
+    }
+
+    bool generator::generate_fused_sums(const std::shared_ptr<ast_node::expr_node>& expression,
+                                        std::string& assembly) {
+        constexpr long reg_size = 8;
+
+        std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>> sums;
+        this->sibling_sums(expression, sums);
+        if (sums.size() < 2) return false;
+
+        //  Group the loops by their bounds.
+        std::vector<std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>> groups;
+        for (const std::shared_ptr<ast_node::sum_loop_expr_node>& sum : sums) {
+            bool is_grouped = false;
+            for (std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& group : groups) {
+                const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& bindings
+                        = group[0]->binding_pairs;
+                if (bindings.size() != sum->binding_pairs.size()) continue;
+
+                bool is_same = true;
+                for (unsigned long index = 0; index < bindings.size() && is_same; ++index) {
+                    is_same = generator::same_expression(std::get<1>(bindings[index]),
+                                                         std::get<1>(sum->binding_pairs[index]));
+                }
+                if (!is_same) continue;
+
+                group.push_back(sum);
+                is_grouped = true;
+                break;
+            }
+            if (!is_grouped) groups.push_back({sum});
+        }
+        groups.erase(std::remove_if(groups.begin(), groups.end(),
+                                    [](const std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& group) {
+                                        return group.size() < 2;
+                                    }),
+                     groups.end());
+        if (groups.empty()) return false;
+
+        //  Fusing reorders the iterations of the loops, and evaluates them before the rest of the expression.
+        //  That is only unobservable when at most one thing can fail: a shared bound check comes first either way.
+        long num_fallible = 0;
+        std::unordered_set<const ast_node::expr_node*> fused;
+        for (const std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& group : groups) {
+            for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : group[0]->binding_pairs) {
+                long bound = 0;
+                if (groups.size() > 1 && (!this->constant_int_value(std::get<1>(pair), bound) || bound <= 0)) {
+                    ++num_fallible;
+                }
+            }
+            for (const std::shared_ptr<ast_node::sum_loop_expr_node>& sum : group) {
+                if (!this->loop_body_cannot_fail(sum->sum_expr, sum->binding_pairs)) ++num_fallible;
+                fused.insert(sum.get());
+            }
+        }
+        if (num_fallible > 1 || !this->cannot_fail_except(expression, fused)) return false;
+
+        std::stringstream code;
+
+        long fused_size = 0;
+        for (const std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& group : groups) {
+            if (this->debug) code << "\t;  O2: Fused " << group.size() << " sibling sum loops\n";
+            code << this->generate_fused_sum_loop(group);
+            fused_size += reg_size * (long)group.size();
+        }
+
+        code << this->generate_expr(expression);
+
+        //  Slide the result down over the fused sums.
+        const long result_size = expression->r_type->size();
+        for (long offset = result_size - reg_size; offset >= 0; offset -= reg_size) {
+            code << "\tmov rax, [rsp + " << offset << "]\n"
+                 << "\tmov [rsp + " << offset + fused_size << "], rax\n";
+        }
+        code << "\tadd rsp, " << fused_size;
+        if (this->debug) code << " ; Free fused sums";
+        code << "\n";
+
+        this->stack.pop();
+        for (long offset = 0; offset < fused_size; offset += reg_size) this->stack.pop();
+        this->stack.push(result_size);
+
+        for (const ast_node::expr_node* sum : fused) {
+            this->fused_sums.erase(static_cast<const ast_node::sum_loop_expr_node*>(sum));
+        }
+
+        assembly = code.str();
+        return true;
+    }
+
+    bool generator::generate_unswitched_loop(const std::shared_ptr<ast_node::expr_node>& loop, std::string& assembly) {
+        if (this->opt_level < 2) return false;
+
+        const std::shared_ptr<ast_node::array_loop_expr_node> array_loop
+                = std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(loop);
+        const std::shared_ptr<ast_node::sum_loop_expr_node> sum_loop
+                = std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(loop);
+        const bool is_array_loop = loop->type == ast_node::ARRAY_LOOP_EXPR;
+        const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& binding_pairs
+                = is_array_loop ? array_loop->binding_pairs : sum_loop->binding_pairs;
+        const std::shared_ptr<ast_node::expr_node>& body = is_array_loop ? array_loop->item_expr : sum_loop->sum_expr;
+
+        if (!this->constant_trip_counts(binding_pairs).empty()) return false;
+        if (generator::expression_size(body) > generator::max_unswitch_size / (this->unswitch_copies * 2)) return false;
+
+        std::vector<std::string> loop_vars;
+        for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : binding_pairs) {
+            loop_vars.push_back(std::get<0>(pair).text);
+        }
+        const std::shared_ptr<ast_node::if_expr_node> if_expr = this->invariant_condition(body, loop_vars);
+        if (if_expr == nullptr) return false;
+
+        std::stringstream code;
+
+        if (this->debug) code << "\t;  O2: Unswitched loop on an invariant condition\n";
+
+        const std::string else_label = this->constants->next_jump();
+        const std::string end_label = this->constants->next_jump();
+
+        code << this->generate_cond_jump(if_expr->conditional_expr, false, else_label);
+
+        //  Each copy of the loop starts from the same stack.
+        const stack_info::stack_info saved_stack = this->stack;
+        this->unswitch_copies *= 2;
+
+        this->unswitched_ifs[if_expr.get()] = true;
+        code << this->generate_expr(loop);
+        code << "\tjmp " << end_label << "\n";
+
+        this->stack = saved_stack;
+        this->unswitched_ifs[if_expr.get()] = false;
+        code << else_label << ":\n";
+        code << this->generate_expr(loop);
+        code << end_label << ":\n";
+
+        this->unswitched_ifs.erase(if_expr.get());
+        this->unswitch_copies /= 2;
+
+        assembly = code.str();
+        return true;
+    }
+
+    std::string generator::generate_window_update(const std::vector<stencil_window>& windows, long inner_offset) {
+        constexpr long reg_size = 8;
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  O2: Slide stencil windows\n";
+
+        const std::string next_element = this->constants->next_jump();
+        const std::string update_done = this->constants->next_jump();
+
+        //  Returns the operand for the header field of the window's array at the given offset.
+        const auto header = [&](const stencil_window& window, long field) {
+            std::string reg;
+            long offset = 0;
+            this->memory_operand(window.array, reg, offset);
+            return "[" + reg + " - " + std::to_string(offset - field) + "]";
+        };
+
+        //  Loads the element at the given position of the window, or flags it as out of bounds.
+        const auto load = [&](const stencil_window& window, long position) {
+            std::stringstream code;
+            const long row_size = (long)window.row.size();
+            const long value_offset
+                    = (long)this->stack.size() - window.values_position + position * window.element_size;
+            const long flag_offset = (long)this->stack.size() - window.flags_position + reg_size * position;
+            const std::string out_of_bounds = this->constants->next_jump();
+            const std::string load_done = this->constants->next_jump();
+
+            code << "\tmov rcx, [rsp + " << (long)this->stack.size() - window.row_position << "]\n"
+                 << "\ttest rcx, rcx\n"
+                 << "\tjz " << out_of_bounds << "\n"
+                 << "\tmov rax, [rsp + " << inner_offset << "]\n";
+            if (window.offset + position != 0) code << "\tadd rax, " << window.offset + position << "\n";
+            code << "\tcmp rax, " << header(window, reg_size * row_size) << "\n"
+                 << "\tjae " << out_of_bounds << "\n"
+                 << this->generate_assem_mul("rax", window.element_size) << "\tadd rax, rcx\n";
+            for (long offset = 0; offset < window.element_size; offset += reg_size) {
+                code << "\tmov r10, [rax + " << offset << "]\n"
+                     << "\tmov [rsp + " << value_offset + offset << "], r10\n";
+            }
+            code << "\tmov qword [rsp + " << flag_offset << "], 1\n"
+                 << "\tjmp " << load_done << "\n"
+                 << out_of_bounds << ":\n"
+                 << "\tmov qword [rsp + " << flag_offset << "], 0\n"
+                 << load_done << ":\n";
+
+            return code.str();
+        };
+
+        assembly << "\tcmp qword [rsp + " << inner_offset << "], 0\n"
+                 << "\tjne " << next_element;
+        if (this->debug) assembly << " ; Load whole windows at the start of a row";
+        assembly << "\n";
+
+        for (const stencil_window& window : windows) {
+            const long row_size = (long)window.row.size();
+            const std::string row_out_of_bounds = this->constants->next_jump();
+            const std::string row_done = this->constants->next_jump();
+
+            //  The address of the start of the row, or 0 when the row is out of bounds.
+            for (const std::shared_ptr<ast_node::expr_node>& index : window.row) assembly << this->generate_expr(index);
+            assembly << "\tmov r9, 0\n";
+            for (long index = 0; index < row_size; ++index) {
+                assembly << "\tmov rax, [rsp + " << reg_size * (row_size - 1 - index) << "]\n"
+                         << "\tcmp rax, " << header(window, reg_size * index) << "\n"
+                         << "\tjae " << row_out_of_bounds << "\n"
+                         << "\timul r9, " << header(window, reg_size * index) << "\n"
+                         << "\tadd r9, rax\n";
+            }
+            assembly << "\timul r9, " << header(window, reg_size * row_size) << "\n"
+                     << this->generate_assem_mul("r9", window.element_size) << "\tadd r9, "
+                     << header(window, reg_size * (row_size + 1)) << "\n"
+                     << "\tjmp " << row_done << "\n"
+                     << row_out_of_bounds << ":\n"
+                     << "\tmov r9, 0\n"
+                     << row_done << ":\n";
+            if (row_size > 0) assembly << "\tadd rsp, " << reg_size * row_size << "\n";
+            for (long index = 0; index < row_size; ++index) this->stack.pop();
+            assembly << "\tmov [rsp + " << (long)this->stack.size() - window.row_position << "], r9";
+            if (this->debug) assembly << " ; Row address";
+            assembly << "\n";
+
+            for (long position = 0; position < window.width; ++position) assembly << load(window, position);
+        }
+        assembly << "\tjmp " << update_done << "\n" << next_element << ":\n";
+
+        for (const stencil_window& window : windows) {
+            const long values_offset = (long)this->stack.size() - window.values_position;
+            const long flags_offset = (long)this->stack.size() - window.flags_position;
+            for (long position = 0; position + 1 < window.width; ++position) {
+                for (long offset = 0; offset < window.element_size; offset += reg_size) {
+                    const long destination = values_offset + position * window.element_size + offset;
+                    assembly << "\tmov r10, [rsp + " << destination + window.element_size << "]\n"
+                             << "\tmov [rsp + " << destination << "], r10\n";
+                }
+                assembly << "\tmov r10, [rsp + " << flags_offset + reg_size * (position + 1) << "]\n"
+                         << "\tmov [rsp + " << flags_offset + reg_size * position << "], r10\n";
+            }
+            assembly << load(window, window.width - 1);
+        }
+        assembly << update_done << ":\n";
+
+        return assembly.str();
+    }
+
+    std::string generator::generate_stage_element(const std::shared_ptr<ast_node::array_index_expr_node>& expression,
+                                                  const std::shared_ptr<ast_node::array_loop_expr_node>& stage,
+                                                  const std::shared_ptr<ast_node::expr_node>& body) {
+        std::stringstream assembly;
+
+        if (this->debug) assembly << "\t;  O2: Computing an element of a fused pipeline stage\n";
+
+        //  The array is never built, so only the bounds checks of its address matter.
+        if (this->unchecked_stage_reads.count(expression.get()) == 0) {
+            assembly << this->generate_element_address(expression);
+        }
+
+        //  Look up every index before rebinding, in case the stage's loop variables share names with the reader's.
+        std::vector<std::pair<bool, long>> indices;
+        std::vector<bool> loop_constants;
+        for (const std::shared_ptr<ast_node::expr_node>& param : expression->params) {
+            const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(param)->name;
+            long value = 0;
+            if (this->variables.get_variable_constant(name, value)) {
+                indices.emplace_back(true, value);
+            } else {
+                indices.emplace_back(false, std::get<1>(this->variables.get_variable_address(name)));
+            }
+            loop_constants.push_back(this->variables.is_loop_constant(name));
+        }
+
+        const variable_table saved_variables = this->variables;
+        this->bind_stage_arguments(std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression->array)->name);
+        for (unsigned long index = 0; index < indices.size(); ++index) {
+            const std::string& name = std::get<0>(stage->binding_pairs[index]).text;
+            if (indices[index].first) {
+                this->variables.set_variable_constant(name, indices[index].second, loop_constants[index]);
+            } else {
+                this->variables.set_variable_address(name, indices[index].second);
+            }
+        }
+
+        assembly << this->generate_expr(body);
+
+        this->variables.restore(saved_variables);
+
+        return assembly.str();
+    }
+
+    void generator::bind_stage_arguments(const std::string& name) {
+        constexpr long reg_size = 8;
+
+        const auto stage_call = this->stage_calls.find(name);
+        if (stage_call == this->stage_calls.end()) return;
+        const std::shared_ptr<ast_node::call_expr_node>& call = stage_call->second.first;
+        const std::shared_ptr<ast_node::fn_cmd_node>& function = stage_call->second.second;
+
+        //  Each parameter, with whether it is a constant, and its constant or its address.
+        std::vector<std::tuple<std::string, bool, std::string, long>> bindings;
+        for (unsigned long index = 0; index < call->call_args.size(); ++index) {
+            const std::shared_ptr<ast_node::expr_node>& arg = call->call_args[index];
+            const std::shared_ptr<ast_node::argument_node> argument
+                    = std::reinterpret_pointer_cast<ast_node::var_binding_node>(function->bindings[index])
+                              ->binding_arg;
+
+            long value = 0;
+            if (this->constant_int_value(arg, value)) {
+                bindings.emplace_back(std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name,
+                                      true, "", value);
+                continue;
+            }
+
+            const std::tuple<std::string, long> address = this->variables.get_variable_address(
+                    std::reinterpret_pointer_cast<ast_node::variable_expr_node>(arg)->name);
+            if (argument->type != ast_node::ARRAY_ARGUMENT) {
+                bindings.emplace_back(std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name,
+                                      false, std::get<0>(address), std::get<1>(address));
+                continue;
+            }
+
+            //  The dimensions are the first fields of the array's header.
+            const std::shared_ptr<ast_node::array_argument_node> array_argument
+                    = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
+            bindings.emplace_back(array_argument->name, false, std::get<0>(address), std::get<1>(address));
+            for (unsigned long dim = 0; dim < array_argument->dimension_vars.size(); ++dim) {
+                bindings.emplace_back(array_argument->dimension_vars[dim].text, false, std::get<0>(address),
+                                      std::get<1>(address) - reg_size * (long)dim);
+            }
+        }
+
+        for (const std::tuple<std::string, bool, std::string, long>& binding : bindings) {
+            if (std::get<1>(binding)) {
+                this->variables.set_variable_constant(std::get<0>(binding), std::get<3>(binding));
+            } else if (std::get<2>(binding) == "rbp") {
+                this->variables.set_variable_address(std::get<0>(binding), std::get<3>(binding));
+            } else {
+                this->variables.set_global_address(std::get<0>(binding), std::get<3>(binding));
+            }
+        }
+    }
+
+    std::string generator::generate_fused_sum_loop(
+            const std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& loops) {
+        constexpr long reg_size = 8;
+        std::stringstream assembly;
+
+        const long num_loops = (long)loops.size();
+        const long rank = (long)loops[0]->binding_pairs.size();
+
+        assembly << "\tsub rsp, " << reg_size * num_loops;
+        if (this->debug) assembly << " ; Allocate the fused sums";
+        assembly << "\n";
+        for (long index = 0; index < num_loops; ++index) this->stack.push();
+
+        //  The first sum is at the highest address.
+        for (long index = 0; index < num_loops; ++index) {
+            this->fused_sums[loops[index].get()] = (long)this->stack.size() - reg_size * (num_loops - 1 - index);
+            assembly << "\tmov qword [rsp + " << reg_size * (num_loops - 1 - index) << "], 0\n";
+        }
+
+        //  Adds the value of the body on the stack to the given sum.
+        const std::function<std::string(long)> accumulate = [&](long loop) {
+            std::stringstream addition;
+            const long offset = (long)this->stack.size() - this->fused_sums[loops[loop].get()] - reg_size;
+
+            if (loops[loop]->r_type->type == resolved_type::INT_TYPE) {
+                addition << "\tpop rax\n"
+                         << "\tadd [rsp + " << offset << "], rax";
+            } else {
+                addition << "\tmovsd xmm0, [rsp]\n"
+                         << "\tadd rsp, 8\n"
+                         << "\taddsd xmm0, [rsp + " << offset << "]\n"
+                         << "\tmovsd [rsp + " << offset << "], xmm0";
             }
-        }
+            if (this->debug) addition << " ; Add loop body to sum " << loop;
+            addition << "\n";
+            this->stack.pop();
 
-        if (this->debug) assembly << "\t;  END generate_expr_binop\n";
+            return addition.str();
+        };
 
-        return assembly.str();
-    }
+        const std::vector<long> bounds = this->constant_trip_counts(loops[0]->binding_pairs);
+        if (!bounds.empty()) {
+            if (this->debug) assembly << "\t;  O2: Fully unrolled sum loop\n";
 
-    std::string generator::generate_expr_call(const std::shared_ptr<ast_node::call_expr_node>& expression) {
-        constexpr unsigned int reg_size = 8;
-        std::stringstream assembly;
+            long trip_count = 1;
+            for (const long bound : bounds) trip_count *= bound;
 
-        if (this->debug) assembly << "\t;  START generate_expr_call\n";
+            std::vector<long> indices(rank, 0);
+            for (long iteration = 0; iteration < trip_count; ++iteration) {
+                for (long loop = 0; loop < num_loops; ++loop) {
+                    for (long index = 0; index < rank; ++index) {
+                        this->variables.set_variable_constant(std::get<0>(loops[loop]->binding_pairs[index]).text,
+                                                              indices[index], true);
+                    }
 
-        const call_signature::call_signature& function = (*this->function_signatures)[expression->name];
+                    assembly << this->generate_expr(loops[loop]->sum_expr);
+                    assembly << accumulate(loop);
+                }
 
-        //  1.  If there's a struct return value, allocate space for it on the stack.
-        const bool has_struct_return = function.ret_type->type == resolved_type::ARRAY_TYPE
-                                    || (function.ret_type->type == resolved_type::TUPLE_TYPE
-                                        && !std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(
-                                                    function.ret_type)
-                                                    ->element_types.empty());
-        if (has_struct_return) {
-            assembly << "\tsub rsp, " << function.ret_type->size();
-            if (this->debug) assembly << " ; Return struct";
-            assembly << "\n";
-            this->stack.push(function.ret_type->size());
-        }
+                for (long index = rank - 1; index >= 0; --index) {
+                    if (++indices[index] < bounds[index]) break;
+                    indices[index] = 0;
+                }
+            }
 
-        //  2.  Add padding so the final stack size, before the call, is a multiple of 16 bytes.
-        this->stack.push(function.bytes_on_stack);
-        const bool needs_alignment = this->stack.needs_alignment();
-        this->stack.pop();
-        if (needs_alignment) {
-            assembly << "\tsub rsp, 8";
-            if (this->debug) assembly << " ; Align stack";
-            assembly << "\n";
-            this->stack.push();
-        }
+            for (const std::shared_ptr<ast_node::sum_loop_expr_node>& loop : loops) {
+                for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : loop->binding_pairs) {
+                    this->variables.clear_variable_constant(std::get<0>(pair).text);
+                }
+            }
 
-        //  3.  Compute every stack argument in reverse order (so that they end up on the stack in the normal
-        //  order).
-        //  4.  Compute every register argument in reverse order.
-        for (const unsigned int& index : function.push_order) {
-            assembly << generate_expr(expression->call_args[index]);
+            return assembly.str();
         }
 
-        //  5.  Pop all register arguments into their correct registers.
-        for (const std::string& assem : function.pop_assem) {
-            assembly << assem;
-            this->stack.pop();
-        }
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair = loops[0]->binding_pairs[index];
+            if (this->debug) assembly << "\t;  Computing bound for " << std::get<0>(pair).text << "\n";
 
-        //  6.  If there's a struct return value, load its address into RDI.
-        if (has_struct_return) {
-            assembly << "\tlea rdi, [rsp + " << function.bytes_on_stack + (needs_alignment ? reg_size : 0) << "]\n";
-        }
+            assembly << this->generate_expr(std::get<1>(pair));
 
-        //  7.  Execute the `call` instruction.
-        assembly << "\tcall _" << expression->name << "\n";
+            const std::string jump = this->constants->next_jump();
 
-        //  8.  Drop every stack argument.
-        for (const long arg : function.stack_args) {
-            assembly << "\tadd rsp, " << arg << "\n";
-            this->stack.pop();
-        }
+            assembly << "\tmov rax, [rsp]\n"
+                     << "\tcmp rax, 0\n"
+                     << "\tjg " << jump << "\n";
 
-        //  9.  Drop the padding, if any.
-        if (needs_alignment) {
-            assembly << "\tadd rsp, 8";
-            if (this->debug) assembly << " ; Remove alignment";
-            assembly << "\n";
+            assembly << this->generate_fail_assertion("non-positive loop bound");
 
-            while (this->stack.pop() == 0) {}
+            assembly << jump << ":\n";
         }
 
-        //  10. If the return value is in a register, push it onto the stack.
-        switch (function.ret_type->type) {
-            case resolved_type::FLOAT_TYPE:
-                assembly << "\tsub rsp, 8\n"
-                         << "\tmovsd [rsp], xmm0\n";
-                this->stack.push();
-                break;
-            case resolved_type::BOOL_TYPE:
-            case resolved_type::INT_TYPE:
-                assembly << "\tpush rax\n";
-                this->stack.push();
-                break;
-            default:
-                if (!has_struct_return) this->stack.push(0);
-                break;
+        //  Every loop names the shared loop variables in its own way.
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::string& name = std::get<0>(loops[0]->binding_pairs[index]).text;
+            assembly << "\tpush qword 0";
+            if (this->debug) assembly << " ; Initialize " << name << " to 0";
+            assembly << "\n";
+            this->stack.push();
+            for (const std::shared_ptr<ast_node::sum_loop_expr_node>& loop : loops) {
+                this->variables.set_variable_address(std::get<0>(loop->binding_pairs[index]).text,
+                                                     (long)this->stack.size());
+            }
         }
 
-        if (this->debug) assembly << "\t;  END generate_expr_call\n";
+        const std::string body_start = this->constants->next_jump();
 
-        return assembly.str();
-    }
+        assembly << body_start << ":";
+        if (this->debug) assembly << " ; Begin loop body";
+        assembly << "\n";
 
-    std::string generator::generate_expr_false(const std::shared_ptr<ast_node::false_expr_node>&) {
-        std::stringstream assembly;
+        for (long loop = 0; loop < num_loops; ++loop) {
+            assembly << this->generate_expr(loops[loop]->sum_expr);
+            assembly << accumulate(loop);
+        }
 
-        if (this->debug) assembly << "\t;  START generate_expr_false\n";
+        for (long index = rank - 1; index >= 0; --index) {
+            const std::string& name = std::get<0>(loops[0]->binding_pairs[index]).text;
 
-        if (this->opt_level >= 1) {
-            assembly << "\tpush qword 0";
-            if (this->debug) assembly << " ; False";
+            if (this->debug) assembly << "\t;  Increment " << name << "\n";
+            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
+
+            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
+            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
+                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
+                     << "\tjl " << body_start;
+            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
             assembly << "\n";
-            this->stack.push();
-        } else {
-            assembly << "\tmov rax, [rel " << (*this->constants)[(long)0] << "]";
-            if (this->debug) assembly << " ; False";
-            assembly << "\n"
-                     << "\tpush rax\n";
-            this->stack.push();
+
+            if (index > 0) {
+                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
+                if (this->debug) assembly << " ; Set " << name << " = 0";
+                assembly << "\n";
+            }
         }
 
-        if (this->debug) assembly << "\t;  END generate_expr_false\n";
+        assembly << "\tadd rsp, " << 2 * reg_size * rank;
+        if (this->debug) assembly << " ; Free all loop variables and bounds";
+        assembly << "\n";
+        for (long index = 0; index < 2 * rank; ++index) { this->stack.pop(); }
 
         return assembly.str();
     }
 
-    std::string generator::generate_expr_float(const std::shared_ptr<ast_node::float_expr_node>& expression) {
-        std::stringstream assembly;
+    long generator::speculation_cost(const std::shared_ptr<ast_node::expr_node>& expression) {
+        switch (expression->type) {
+            case ast_node::FALSE_EXPR:
+            case ast_node::FLOAT_EXPR:
+            case ast_node::INTEGER_EXPR:
+            case ast_node::TRUE_EXPR:
+                return 1;
+            case ast_node::VARIABLE_EXPR:
+                return (expression->r_type->type == resolved_type::TUPLE_TYPE) ? -1 : 1;
+            case ast_node::UNOP_EXPR: {
+                const long operand_cost = generator::speculation_cost(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand);
+                return (operand_cost < 0) ? -1 : operand_cost + 1;
+            }
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+
+                //  Integer division and modulo can fail unless the divisor is a nonzero literal;
+                //  floating-point modulo is a call.
+                if (binop->operator_type == ast_node::BINOP_DIVIDE || binop->operator_type == ast_node::BINOP_MOD) {
+                    if (binop->left_operand->r_type->type == resolved_type::INT_TYPE) {
+                        const bool is_nonzero_literal
+                                = binop->right_operand->type == ast_node::INTEGER_EXPR
+                               && std::reinterpret_pointer_cast<ast_node::integer_expr_node>(binop->right_operand)
+                                                  ->value
+                                          != 0;
+                        if (!is_nonzero_literal) return -1;
+                    } else if (binop->operator_type == ast_node::BINOP_MOD) {
+                        return -1;
+                    }
+                }
 
-        if (this->debug) assembly << "\t;  START generate_expr_float\n";
+                const long left_cost = generator::speculation_cost(binop->left_operand);
+                const long right_cost = generator::speculation_cost(binop->right_operand);
+                if (left_cost < 0 || right_cost < 0) return -1;
+                return left_cost + right_cost + 1;
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                const long cond_cost = generator::speculation_cost(if_expr->conditional_expr);
+                const long affirmative_cost = generator::speculation_cost(if_expr->affirmative_expr);
+                const long negative_cost = generator::speculation_cost(if_expr->negative_expr);
+                if (cond_cost < 0 || affirmative_cost < 0 || negative_cost < 0) return -1;
+                return cond_cost + affirmative_cost + negative_cost + 1;
+            }
+            default:
+                return -1;
+        }
+    }
 
-        assembly << "\tmov rax, [rel " << (*this->constants)[expression->value] << "]";
-        if (this->debug) assembly << " ; " << expression->value;
-        assembly << "\n\tpush rax\n";
-        this->stack.push();
+    bool generator::constant_int_value(const std::shared_ptr<ast_node::expr_node>& expression, long& value) const {
+        const auto folded = this->folded_comparisons.find(expression.get());
+        if (folded != this->folded_comparisons.end()) {
+            value = folded->second;
+            return true;
+        }
 
-        if (this->debug) assembly << "\t;  END generate_expr_float\n";
+        switch (expression->type) {
+            case ast_node::INTEGER_EXPR:
+                value = std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression)->value;
+                return true;
+            case ast_node::TRUE_EXPR:
+                value = 1;
+                return true;
+            case ast_node::FALSE_EXPR:
+                value = 0;
+                return true;
+            case ast_node::VARIABLE_EXPR:
+                if (this->variables.get_variable_constant(
+                            std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression)->name, value))
+                    return true;
+                break;
+            case ast_node::UNOP_EXPR: {
+                const std::shared_ptr<ast_node::unop_expr_node> unop
+                        = std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression);
+                long operand;
+                if (!this->constant_int_value(unop->operand, operand)) break;
+
+                value = (unop->operator_type == ast_node::UNOP_NEG) ? (long)(0UL - (unsigned long)operand)
+                                                                    : (long)(operand == 0);
+                return true;
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                long condition;
+                if (!this->constant_int_value(if_expr->conditional_expr, condition)) break;
+
+                return this->constant_int_value(condition != 0 ? if_expr->affirmative_expr : if_expr->negative_expr,
+                                                value);
+            }
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                long left;
+                long right;
+                if (!this->constant_int_value(binop->left_operand, left)
+                    || !this->constant_int_value(binop->right_operand, right))
+                    break;
 
-        return assembly.str();
-    }
+                //  Wrap around instead of invoking undefined behavior.
+                const unsigned long u_left = (unsigned long)left;
+                const unsigned long u_right = (unsigned long)right;
+                switch (binop->operator_type) {
+                    case ast_node::BINOP_PLUS:
+                        value = (long)(u_left + u_right);
+                        return true;
+                    case ast_node::BINOP_MINUS:
+                        value = (long)(u_left - u_right);
+                        return true;
+                    case ast_node::BINOP_TIMES:
+                        value = (long)(u_left * u_right);
+                        return true;
+                    case ast_node::BINOP_DIVIDE:
+                    case ast_node::BINOP_MOD:
+                        //  Leave failing divisions to the run-time checks.
+                        if (right == 0 || (left == LONG_MIN && right == -1)) return false;
+                        value = (binop->operator_type == ast_node::BINOP_DIVIDE) ? left / right : left % right;
+                        return true;
+                    case ast_node::BINOP_LT:
+                        value = left < right;
+                        return true;
+                    case ast_node::BINOP_GT:
+                        value = left > right;
+                        return true;
+                    case ast_node::BINOP_EQ:
+                        value = left == right;
+                        return true;
+                    case ast_node::BINOP_NEQ:
+                        value = left != right;
+                        return true;
+                    case ast_node::BINOP_LEQ:
+                        value = left <= right;
+                        return true;
+                    case ast_node::BINOP_GEQ:
+                        value = left >= right;
+                        return true;
+                    case ast_node::BINOP_AND:
+                        value = left != 0 && right != 0;
+                        return true;
+                    case ast_node::BINOP_OR:
+                        value = left != 0 || right != 0;
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+            default:
+                break;
+        }
 
-    std::string generator::generate_expr_if(const std::shared_ptr<ast_node::if_expr_node>& expression) {
-        std::stringstream assembly;
+        if (this->opt_level >= 2 && expression->cp_val.type == ast_node::INT_VALUE) {
+            value = expression->cp_val.int_value;
+            return true;
+        }
 
-        if (this->debug) assembly << "\t;  START generate_expr_if\n";
+        return false;
+    }
 
-        assembly << this->generate_expr(expression->conditional_expr);
+    bool generator::polynomial_form(const std::shared_ptr<ast_node::expr_node>& expression,
+                                    const std::vector<std::string>& loop_vars, loop_polynomial& polynomial) const {
+        polynomial.clear();
+        if (expression->r_type->type != resolved_type::INT_TYPE) return false;
 
-        std::string jump_1;
-        std::string jump_2;
+        const std::vector<long> constant_monomial(loop_vars.size(), 0);
 
-        const bool is_bool_cast
-                = (this->opt_level >= 1)
-               && ((expression->affirmative_expr->cp_val.type == ast_node::INT_VALUE
-                    && expression->negative_expr->cp_val.type == ast_node::INT_VALUE
-                    && expression->affirmative_expr->cp_val.int_value == 1
-                    && expression->negative_expr->cp_val.int_value == 0)
-                   || (expression->affirmative_expr->type == ast_node::node_type::INTEGER_EXPR
-                       && expression->negative_expr->type == ast_node::node_type::INTEGER_EXPR
-                       && std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->affirmative_expr)
-                                          ->value
-                                  == 1
-                       && std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression->negative_expr)->value
-                                  == 0));
+        //  Adds a term to a coefficient, merging constant terms.
+        const auto add_term = [](std::vector<invariant_term>& coefficient, const invariant_term& term) {
+            if (term.factors.empty()) {
+                for (invariant_term& existing : coefficient) {
+                    if (!existing.factors.empty()) continue;
+                    existing.scale = (long)((unsigned long)existing.scale + (unsigned long)term.scale);
+                    return;
+                }
+            }
+            coefficient.push_back(term);
+        };
+        const auto num_terms = [](const loop_polynomial& terms) {
+            long count = 0;
+            for (const std::pair<const std::vector<long>, std::vector<invariant_term>>& monomial : terms) {
+                count += (long)monomial.second.size();
+            }
+            return count;
+        };
 
-        if (is_bool_cast) {
-            if (this->debug) assembly << "\t;  O1: Boolean cast\n";
-        } else {
-            assembly << "\tpop rax\n";
-            this->stack.pop();
-            assembly << "\tcmp rax, 0\n";
+        switch (expression->type) {
+            case ast_node::INTEGER_EXPR:
+                polynomial[constant_monomial].push_back(
+                        {std::reinterpret_pointer_cast<ast_node::integer_expr_node>(expression)->value, {}});
+                return true;
+            case ast_node::VARIABLE_EXPR: {
+                const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression)->name;
+                const auto loop_var = std::find(loop_vars.begin(), loop_vars.end(), name);
+                if (loop_var == loop_vars.end()) break;
+
+                std::vector<long> monomial = constant_monomial;
+                monomial[loop_var - loop_vars.begin()] = 1;
+                polynomial[monomial].push_back({1, {}});
+                return true;
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                const auto unswitched = this->unswitched_ifs.find(if_expr.get());
+                if (unswitched == this->unswitched_ifs.end()) break;
+
+                return this->polynomial_form(unswitched->second ? if_expr->affirmative_expr : if_expr->negative_expr,
+                                             loop_vars, polynomial);
+            }
+            case ast_node::UNOP_EXPR: {
+                if (!this->polynomial_form(
+                            std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand, loop_vars,
+                            polynomial))
+                    return false;
+
+                for (std::pair<const std::vector<long>, std::vector<invariant_term>>& monomial : polynomial) {
+                    for (invariant_term& term : monomial.second) term.scale = (long)(0UL - (unsigned long)term.scale);
+                }
+                return true;
+            }
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                const ast_node::op_type op = binop->operator_type;
+                if (op != ast_node::BINOP_PLUS && op != ast_node::BINOP_MINUS && op != ast_node::BINOP_TIMES) break;
+
+                loop_polynomial left;
+                loop_polynomial right;
+                if (!this->polynomial_form(binop->left_operand, loop_vars, left)
+                    || !this->polynomial_form(binop->right_operand, loop_vars, right))
+                    return false;
+
+                if (op == ast_node::BINOP_TIMES) {
+                    if (num_terms(left) * num_terms(right) > generator::max_closed_form_terms) return false;
+
+                    for (const std::pair<const std::vector<long>, std::vector<invariant_term>>& l_mono : left) {
+                        for (const std::pair<const std::vector<long>, std::vector<invariant_term>>& r_mono : right) {
+                            std::vector<long> monomial = l_mono.first;
+                            for (unsigned long index = 0; index < monomial.size(); ++index) {
+                                monomial[index] += r_mono.first[index];
+                                if (monomial[index] > 2) return false;
+                            }
 
-            jump_1 = this->constants->next_jump();
-            jump_2 = this->constants->next_jump();
+                            for (const invariant_term& l_term : l_mono.second) {
+                                for (const invariant_term& r_term : r_mono.second) {
+                                    invariant_term term = l_term;
+                                    term.scale = (long)((unsigned long)l_term.scale * (unsigned long)r_term.scale);
+                                    term.factors.insert(term.factors.end(), r_term.factors.begin(),
+                                                        r_term.factors.end());
+                                    add_term(polynomial[monomial], term);
+                                }
+                            }
+                        }
+                    }
+                } else {
+                    polynomial = left;
+                    for (const std::pair<const std::vector<long>, std::vector<invariant_term>>& r_mono : right) {
+                        for (invariant_term term : r_mono.second) {
+                            if (op == ast_node::BINOP_MINUS) term.scale = (long)(0UL - (unsigned long)term.scale);
+                            add_term(polynomial[r_mono.first], term);
+                        }
+                    }
+                    if (num_terms(polynomial) > generator::max_closed_form_terms) return false;
+                }
+                return true;
+            }
+            default:
+                break;
+        }
 
-            assembly << "\tje " << jump_1 << "\n";
+        //  Anything else must be loop-invariant, and safe to evaluate once instead of on every iteration.
+        if (generator::speculation_cost(expression) < 0 || generator::mentions_variable(expression, loop_vars))
+            return false;
 
-            assembly << this->generate_expr(expression->affirmative_expr);
-            this->stack.pop();
+        polynomial[constant_monomial].push_back({1, {expression}});
+        return true;
+    }
 
-            assembly << "\tjmp " << jump_2 << "\n";
+    bool generator::mentions_variable(const std::shared_ptr<ast_node::expr_node>& expression,
+                                      const std::vector<std::string>& names) {
+        switch (expression->type) {
+            case ast_node::FALSE_EXPR:
+            case ast_node::FLOAT_EXPR:
+            case ast_node::INTEGER_EXPR:
+            case ast_node::TRUE_EXPR:
+                return false;
+            case ast_node::VARIABLE_EXPR: {
+                const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression)->name;
+                return std::find(names.begin(), names.end(), name) != names.end();
+            }
+            case ast_node::UNOP_EXPR:
+                return generator::mentions_variable(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand, names);
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                return generator::mentions_variable(binop->left_operand, names)
+                    || generator::mentions_variable(binop->right_operand, names);
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                return generator::mentions_variable(if_expr->conditional_expr, names)
+                    || generator::mentions_variable(if_expr->affirmative_expr, names)
+                    || generator::mentions_variable(if_expr->negative_expr, names);
+            }
+            default:
+                return true;
+        }
+    }
 
-            assembly << jump_1 << ":\n";
-            assembly << this->generate_expr(expression->negative_expr);
+    void generator::sibling_sums(const std::shared_ptr<ast_node::expr_node>& expression,
+                                 std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& sums) const {
+        switch (expression->type) {
+            case ast_node::ARRAY_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& element :
+                     std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(expression)->expressions) {
+                    this->sibling_sums(element, sums);
+                }
+                break;
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                //  The right operand of `&&` and `||` is conditional.
+                this->sibling_sums(binop->left_operand, sums);
+                if (binop->operator_type != ast_node::BINOP_AND && binop->operator_type != ast_node::BINOP_OR) {
+                    this->sibling_sums(binop->right_operand, sums);
+                }
+                break;
+            }
+            case ast_node::SUM_LOOP_EXPR: {
+                const std::shared_ptr<ast_node::sum_loop_expr_node> sum
+                        = std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(expression);
+                if (this->fused_sums.count(sum.get()) > 0) break;
+
+                std::vector<std::string> loop_vars;
+                for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : sum->binding_pairs) {
+                    loop_vars.push_back(std::get<0>(pair).text);
+                }
+                loop_polynomial polynomial;
+                if (sum->r_type->type == resolved_type::INT_TYPE
+                    && this->polynomial_form(sum->sum_expr, loop_vars, polynomial))
+                    break;
 
-            assembly << jump_2 << ":\n";
+                sums.push_back(sum);
+                break;
+            }
+            case ast_node::TUPLE_INDEX_EXPR:
+                this->sibling_sums(std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression)->expr,
+                                   sums);
+                break;
+            case ast_node::TUPLE_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& element :
+                     std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression)->exprs) {
+                    this->sibling_sums(element, sums);
+                }
+                break;
+            case ast_node::UNOP_EXPR:
+                this->sibling_sums(std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand, sums);
+                break;
+            default:
+                break;
         }
+    }
 
-        if (this->debug) assembly << "\t;  END generate_expr_if\n";
+    std::vector<long>
+    generator::contiguous_reads(const std::shared_ptr<ast_node::array_loop_expr_node>& expression) const {
+        const long rank = (long)expression->binding_pairs.size();
+        std::vector<long> reads(rank, 0);
+        std::vector<std::shared_ptr<ast_node::expr_node>> pending = {expression->item_expr};
+        while (!pending.empty()) {
+            const std::shared_ptr<ast_node::expr_node> node = pending.back();
+            pending.pop_back();
+            if (node->type == ast_node::ARRAY_LOOP_EXPR || node->type == ast_node::SUM_LOOP_EXPR) continue;
+            const std::vector<std::shared_ptr<ast_node::expr_node>> children = generator::subexpressions(node);
+            pending.insert(pending.end(), children.begin(), children.end());
+
+            if (node->type != ast_node::ARRAY_INDEX_EXPR || this->read_stage(node) != nullptr) continue;
+            const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                    = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(node);
+            const std::shared_ptr<ast_node::expr_node>& last = array_index->params.back();
+            if (last->type != ast_node::VARIABLE_EXPR) continue;
+
+            const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(last)->name;
+            for (long index = 0; index < rank; ++index) {
+                if (std::get<0>(expression->binding_pairs[index]).text == name) {
+                    reads[index] += (long)array_index->r_type->size();
+                }
+            }
+        }
 
-        return assembly.str();
+        return reads;
     }
 
-    std::string generator::generate_expr_integer(const std::shared_ptr<ast_node::integer_expr_node>& expression) {
-        std::stringstream assembly;
+    void generator::remark(const std::shared_ptr<ast_node::array_loop_expr_node>& loop, const std::string& action,
+                           const std::string& outcome) {
+        if (!this->flags.remarks || !this->shared_state->remarked[loop.get()].insert(action).second) return;
 
-        if (this->debug) assembly << "\t;  START generate_expr_integer\n";
+        std::cerr << "remark: " << action << " the array loop over [";
+        for (unsigned long index = 0; index < loop->binding_pairs.size(); ++index) {
+            std::cerr << (index > 0 ? ", " : "") << std::get<0>(loop->binding_pairs[index]).text;
+        }
+        std::cerr << "] " << outcome << "\n";
+    }
 
-        const bool push_literal = (this->opt_level >= 1) && generator::fits_into_32(expression->value);
+    long generator::interchanged_dimension(const std::shared_ptr<ast_node::array_loop_expr_node>& expression) const {
+        const long rank = (long)expression->binding_pairs.size();
+        if (this->opt_level < 2 || rank < 2 || expression->is_tc) return rank - 1;
 
-        if (push_literal) {
-            assembly << "\tpush qword " << expression->value << "\n";
-            this->stack.push();
-        } else {
-            assembly << "\tmov rax, [rel " << (*this->constants)[expression->value] << "]";
-            if (this->debug) assembly << " ; " << expression->value;
-            assembly << "\n"
-                     << "\tpush rax\n";
-            this->stack.push();
+        const std::vector<long> reads = this->contiguous_reads(expression);
+
+        //  The result is written contiguously along the last dimension.
+        const long writes = (long)std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(expression->r_type)
+                                    ->element_type->size();
+        long inner = rank - 1;
+        for (long index = 0; index < rank - 1; ++index) {
+            if (reads[index] > 0 && reads[index] >= reads[rank - 1] + writes && reads[index] > reads[inner]) {
+                inner = index;
+            }
+        }
+        if (inner == rank - 1 || !this->loop_body_cannot_fail(expression->item_expr, expression->binding_pairs)) {
+            return rank - 1;
         }
 
-        if (this->debug) assembly << "\t;  END generate_expr_integer\n";
-
-        return assembly.str();
+        return inner;
     }
 
-    std::string generator::generate_expr_sum_loop(const std::shared_ptr<ast_node::sum_loop_expr_node>& expression) {
-        constexpr long reg_size = 8;
-        std::stringstream assembly;
+    long generator::tiled_dimension(const std::shared_ptr<ast_node::array_loop_expr_node>& expression, long inner,
+                                    long& tile) const {
+        const long rank = (long)expression->binding_pairs.size();
+        if (this->opt_level < 2 || rank < 2 || expression->is_tc || this->flags.tile_budget == 0) return -1;
 
-        if (this->debug) assembly << "\t;  START generate_expr_sum_loop\n";
+        //  The bytes accessed per iteration contiguously along each dimension, counting the writes of the result.
+        std::vector<long> streams = this->contiguous_reads(expression);
+        streams[rank - 1] += (long)std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(expression->r_type)
+                                     ->element_type->size();
 
-        const bool is_int = expression->r_type->type == resolved_type::INT_TYPE;
+        long tiled = -1;
+        for (long index = 0; index < rank; ++index) {
+            if (index != inner && streams[index] > 0 && (tiled < 0 || streams[index] > streams[tiled])) tiled = index;
+        }
+        if (tiled < 0 || streams[inner] == 0) return -1;
+
+        //  One tile of each stream must fit in the budget at once.
+        const long bytes = streams[inner] + streams[tiled];
+        tile = 1;
+        while (4 * tile * tile * bytes <= (long)this->flags.tile_budget) tile *= 2;
+        if (tile < 4) return -1;
+
+        //  Dimensions that already fit in one tile gain nothing.
+        for (const long index : {inner, tiled}) {
+            const std::shared_ptr<ast_node::expr_node>& bound = std::get<1>(expression->binding_pairs[index]);
+            if (bound->cp_val.type == ast_node::INT_VALUE && bound->cp_val.int_value <= tile) return -1;
+        }
 
-        if (this->debug) assembly << "\t;  Allocating 8 bytes for the sum\n";
+        if (!this->loop_body_cannot_fail(expression->item_expr, expression->binding_pairs)) return -1;
 
-        assembly << "\tsub rsp, 8\n";
-        this->stack.push();
+        return tiled;
+    }
 
+    bool generator::collapsible_loop(const std::shared_ptr<ast_node::array_loop_expr_node>& expression,
+                                     std::vector<std::shared_ptr<ast_node::array_index_expr_node>>& reads) const {
         const long rank = (long)expression->binding_pairs.size();
+        if (this->opt_level < 2 || rank < 2 || expression->is_tc) return false;
 
-        for (long index = rank - 1; index >= 0; --index) {
-            const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair
-                    = expression->binding_pairs[index];
-            if (this->debug) assembly << "\t;  Computing bound for " << std::get<0>(pair).text << "\n";
+        std::unordered_set<std::string> loop_vars;
+        for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : expression->binding_pairs) {
+            loop_vars.insert(std::get<0>(pair).text);
+        }
 
-            assembly << this->generate_expr(std::get<1>(pair));
+        std::vector<std::shared_ptr<ast_node::expr_node>> pending = {expression->item_expr};
+        while (!pending.empty()) {
+            const std::shared_ptr<ast_node::expr_node> node = pending.back();
+            pending.pop_back();
 
-            const std::string jump = this->constants->next_jump();
+            if (node->type == ast_node::VARIABLE_EXPR
+                && loop_vars.count(std::reinterpret_pointer_cast<ast_node::variable_expr_node>(node)->name) > 0) {
+                return false;
+            }
+            if (node->type == ast_node::ARRAY_INDEX_EXPR && this->read_stage(node) == nullptr) {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(node);
+                if (this->is_whole_array_read(array_index, expression->binding_pairs)) {
+                    reads.push_back(array_index);
+                    continue;
+                }
+            }
 
-            assembly << "\tmov rax, [rsp]\n"
-                     << "\tcmp rax, 0\n"
-                     << "\tjg " << jump << "\n";
+            const std::vector<std::shared_ptr<ast_node::expr_node>> children = generator::subexpressions(node);
+            pending.insert(pending.end(), children.begin(), children.end());
+        }
 
-            const bool needs_alignment = this->stack.needs_alignment();
-            if (needs_alignment) {
-                assembly << "\tsub rsp, 8";
-                if (this->debug) assembly << " ; Align stack";
-                assembly << "\n";
-                this->stack.push();
-            }
+        return true;
+    }
 
-            assembly << "\tlea rdi, [rel " << (*this->constants)[{"non-positive loop bound"}] << "]";
-            if (this->debug) assembly << " ; non-positive loop bound";
-            assembly << "\n"
-                     << "\tcall _fail_assertion\n";
+    bool generator::is_whole_array_read(
+            const std::shared_ptr<ast_node::array_index_expr_node>& array_index,
+            const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& bindings) const {
+        constexpr long reg_size = 8;
 
-            if (needs_alignment) {
-                assembly << "\tadd rsp, 8";
-                if (this->debug) assembly << " ; Remove alignment";
-                assembly << "\n";
-                this->stack.pop();
+        std::string header_reg;
+        long header_offset = 0;
+        if (array_index->params.size() != bindings.size() || array_index->array->type != ast_node::VARIABLE_EXPR
+            || !this->memory_operand(array_index->array, header_reg, header_offset)) {
+            return false;
+        }
+
+        const std::vector<ast_node::cp_value>& dims = array_index->array->cp_val.array_value;
+        for (unsigned long dim = 0; dim < bindings.size(); ++dim) {
+            const std::shared_ptr<ast_node::expr_node>& param = array_index->params[dim];
+            if (param->type != ast_node::VARIABLE_EXPR
+                || std::reinterpret_pointer_cast<ast_node::variable_expr_node>(param)->name
+                           != std::get<0>(bindings[dim]).text) {
+                return false;
             }
 
-            assembly << jump << ":\n";
+            const std::shared_ptr<ast_node::expr_node>& bound = std::get<1>(bindings[dim]);
+            long value = 0;
+            if (dims.size() > dim && dims[dim].type == ast_node::INT_VALUE && this->constant_int_value(bound, value)
+                && value == dims[dim].int_value) {
+                continue;
+            }
+
+            //  Otherwise, the bound must be the variable holding this dimension.
+            if (bound->type != ast_node::VARIABLE_EXPR) return false;
+            const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(bound)->name;
+            if (this->variables.get_variable_constant(name, value)
+                || this->variables.get_variable_address(name)
+                           != std::make_tuple(header_reg, header_offset - reg_size * (long)dim)) {
+                return false;
+            }
         }
 
-        if (this->debug) assembly << "\t;  Initializing sum to 0\n";
+        return true;
+    }
 
-        assembly << "\tmov rax, 0\n"
-                 << "\tmov [rsp + " << reg_size * rank << "], rax";
-        if (this->debug) assembly << " ; Move to pre-allocated space";
-        assembly << "\n";
+    std::vector<generator::stencil_window>
+    generator::stencil_windows(const std::shared_ptr<ast_node::array_loop_expr_node>& expression, long inner) const {
+        std::vector<stencil_window> windows;
+        if (this->opt_level < 2) return windows;
+
+        const std::vector<std::string> inner_name = {std::get<0>(expression->binding_pairs[inner]).text};
+
+        //  Returns whether the given index is the innermost loop variable plus a constant, and which.
+        const auto offset_from_inner = [&](const std::shared_ptr<ast_node::expr_node>& index, long& offset) {
+            const auto is_inner = [&](const std::shared_ptr<ast_node::expr_node>& operand) {
+                return operand->type == ast_node::VARIABLE_EXPR
+                    && std::reinterpret_pointer_cast<ast_node::variable_expr_node>(operand)->name == inner_name[0];
+            };
+            offset = 0;
+            if (is_inner(index)) return true;
+            if (index->type != ast_node::BINOP_EXPR) return false;
+
+            const std::shared_ptr<ast_node::binop_expr_node> binop
+                    = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(index);
+            if (binop->operator_type == ast_node::BINOP_PLUS) {
+                return (is_inner(binop->left_operand) && this->constant_int_value(binop->right_operand, offset))
+                    || (is_inner(binop->right_operand) && this->constant_int_value(binop->left_operand, offset));
+            }
+            if (binop->operator_type == ast_node::BINOP_MINUS && is_inner(binop->left_operand)
+                && this->constant_int_value(binop->right_operand, offset)) {
+                offset = -offset;
+                return true;
+            }
+            return false;
+        };
+
+        std::vector<std::shared_ptr<ast_node::expr_node>> pending = {expression->item_expr};
+        while (!pending.empty()) {
+            const std::shared_ptr<ast_node::expr_node> node = pending.back();
+            pending.pop_back();
+            if (node->type == ast_node::ARRAY_LOOP_EXPR || node->type == ast_node::SUM_LOOP_EXPR) continue;
+            const std::vector<std::shared_ptr<ast_node::expr_node>> children = generator::subexpressions(node);
+            pending.insert(pending.end(), children.begin(), children.end());
+
+            if (node->type != ast_node::ARRAY_INDEX_EXPR) continue;
+            const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                    = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(node);
+
+            std::string reg;
+            long header_offset = 0;
+            long offset = 0;
+            if (array_index->array->type != ast_node::VARIABLE_EXPR || this->read_stage(array_index) != nullptr
+                || this->is_planar(array_index->array->r_type)
+                || !this->memory_operand(array_index->array, reg, header_offset)
+                || !offset_from_inner(array_index->params.back(), offset))
+                continue;
+
+            const std::vector<std::shared_ptr<ast_node::expr_node>> row(array_index->params.begin(),
+                                                                        array_index->params.end() - 1);
+            bool is_invariant = true;
+            for (const std::shared_ptr<ast_node::expr_node>& index : row) {
+                is_invariant &= generator::speculation_cost(index) >= 0
+                             && !generator::mentions_variable(index, inner_name);
+            }
+            if (!is_invariant) continue;
 
-        for (long index = rank - 1; index >= 0; --index) {
-            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
-            assembly << "\tmov rax, 0";
-            if (this->debug) assembly << " ; Initialize " << name << " to 0";
-            assembly << "\n"
-                     << "\tpush rax\n";
-            this->stack.push();
-            this->variables.set_variable_address(name, (long)this->stack.size());
+            stencil_window* match = nullptr;
+            for (stencil_window& window : windows) {
+                if (!generator::same_expression(window.array, array_index->array)) continue;
+
+                bool is_same_row = true;
+                for (unsigned long index = 0; index < row.size(); ++index) {
+                    is_same_row &= generator::same_expression(window.row[index], row[index]);
+                }
+                if (is_same_row) match = &window;
+            }
+            if (match == nullptr) {
+                windows.push_back({array_index->array, row, offset, 1, (long)array_index->r_type->size(), {}, 0, 0, 0});
+                match = &windows.back();
+            }
+            match->uses.emplace_back(array_index, offset);
         }
 
-        const std::string body_start = this->constants->next_jump();
+        //  Keep the windows read at several offsets.
+        std::vector<stencil_window> stencils;
+        for (stencil_window& window : windows) {
+            long lowest = window.uses[0].second;
+            long highest = lowest;
+            for (const std::pair<std::shared_ptr<ast_node::array_index_expr_node>, long>& use : window.uses) {
+                lowest = std::min(lowest, use.second);
+                highest = std::max(highest, use.second);
+            }
+            window.offset = lowest;
+            window.width = highest - lowest + 1;
+            if (window.width < 2 || window.width > generator::max_window_width) continue;
 
-        assembly << body_start << ":";
-        if (this->debug) assembly << " ; Begin loop body";
-        assembly << "\n";
+            stencils.push_back(window);
+            if ((long)stencils.size() == generator::max_stencil_windows) break;
+        }
 
-        assembly << this->generate_expr(expression->sum_expr);
+        return stencils;
+    }
 
-        if (is_int) {
-            assembly << "\tpop rax\n";
-            this->stack.pop();
+    bool generator::index_set_split(const std::shared_ptr<ast_node::array_loop_expr_node>& expression,
+                                    std::vector<std::pair<long, long>>& peels,
+                                    std::vector<std::unordered_map<const ast_node::expr_node*, long>>& decided) const {
+        if (this->opt_level < 2) return false;
 
-            assembly << "\tadd [rsp + " << 2 * reg_size * rank << "], rax";
-            if (this->debug) assembly << " ; Add loop body to sum";
-            assembly << "\n";
-        } else {
-            assembly << "\tmovsd xmm0, [rsp]\n"
-                     << "\tadd rsp, 8\n";
-            this->stack.pop();
+        const long rank = (long)expression->binding_pairs.size();
+        peels.assign(rank, {0, 0});
+        decided.assign(rank, {});
+
+        //  Returns the dimension of the given loop variable, or -1.
+        const auto loop_dimension = [&](const std::shared_ptr<ast_node::expr_node>& operand) {
+            if (operand->type != ast_node::VARIABLE_EXPR) return -1L;
+            const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(operand)->name;
+            for (long dim = 0; dim < rank; ++dim) {
+                if (std::get<0>(expression->binding_pairs[dim]).text == name) return dim;
+            }
+            return -1L;
+        };
+
+        bool is_decided = false;
+        std::vector<std::shared_ptr<ast_node::expr_node>> pending = {expression->item_expr};
+        while (!pending.empty()) {
+            const std::shared_ptr<ast_node::expr_node> node = pending.back();
+            pending.pop_back();
+            const std::vector<std::shared_ptr<ast_node::expr_node>> children = generator::subexpressions(node);
+            pending.insert(pending.end(), children.begin(), children.end());
+
+            if (node->type != ast_node::BINOP_EXPR) continue;
+            const std::shared_ptr<ast_node::binop_expr_node> binop
+                    = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(node);
+            ast_node::op_type op = binop->operator_type;
+            const bool is_comparison = op == ast_node::BINOP_LT || op == ast_node::BINOP_GT || op == ast_node::BINOP_EQ
+                                    || op == ast_node::BINOP_NEQ || op == ast_node::BINOP_LEQ
+                                    || op == ast_node::BINOP_GEQ;
+            if (!is_comparison || binop->left_operand->r_type->type != resolved_type::INT_TYPE) continue;
+
+            //  Put the loop variable on the left.
+            long dim = loop_dimension(binop->left_operand);
+            std::shared_ptr<ast_node::expr_node> other = binop->right_operand;
+            if (dim < 0) {
+                dim = loop_dimension(binop->right_operand);
+                other = binop->left_operand;
+                if (op == ast_node::BINOP_LT) op = ast_node::BINOP_GT;
+                else if (op == ast_node::BINOP_GT) op = ast_node::BINOP_LT;
+                else if (op == ast_node::BINOP_LEQ) op = ast_node::BINOP_GEQ;
+                else if (op == ast_node::BINOP_GEQ) op = ast_node::BINOP_LEQ;
+            }
+            if (dim < 0) continue;
 
-            const long offset = 2 * reg_size * rank;
-            assembly << "\taddsd xmm0, [rsp + " << offset << "]";
-            if (this->debug) assembly << " ; Load sum";
-            assembly << "\n";
+            //  The other side is `offset`, or `N + offset` for the bound N of the dimension.
+            const std::shared_ptr<ast_node::expr_node>& bound = std::get<1>(expression->binding_pairs[dim]);
+            bool is_relative = false;
+            long offset = 0;
+            long constant_bound = 0;
+            if (this->constant_int_value(other, offset)) {
+                if (offset > generator::max_peel && this->constant_int_value(bound, constant_bound)) {
+                    is_relative = true;
+                    offset -= constant_bound;
+                }
+            } else if (generator::same_expression(other, bound)) {
+                is_relative = true;
+            } else if (other->type == ast_node::BINOP_EXPR) {
+                const std::shared_ptr<ast_node::binop_expr_node> sum
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(other);
+                if ((sum->operator_type != ast_node::BINOP_PLUS && sum->operator_type != ast_node::BINOP_MINUS)
+                    || !generator::same_expression(sum->left_operand, bound)
+                    || !this->constant_int_value(sum->right_operand, offset))
+                    continue;
+                is_relative = true;
+                if (sum->operator_type == ast_node::BINOP_MINUS) offset = -offset;
+            } else {
+                continue;
+            }
 
-            assembly << "\tmovsd [rsp + " << offset << "], xmm0";
-            if (this->debug) assembly << " ; Store sum";
-            assembly << "\n";
+            //  The comparison has one value below `cut` and another from `cut` on. Equality is only true at `offset`.
+            long lower = 0;
+            long upper = 0;
+            long value = 0;
+            if (op == ast_node::BINOP_EQ || op == ast_node::BINOP_NEQ) {
+                value = op == ast_node::BINOP_NEQ;
+                if (!is_relative && offset >= 0) lower = offset + 1;
+                if (is_relative && offset < 0) upper = -offset;
+            } else {
+                const long cut = offset + ((op == ast_node::BINOP_LEQ || op == ast_node::BINOP_GT) ? 1 : 0);
+                const bool is_true_below = op == ast_node::BINOP_LT || op == ast_node::BINOP_LEQ;
+                //  The interior lies above a cut near the start, and below a cut near the end.
+                value = is_relative ? is_true_below : !is_true_below;
+                if (!is_relative && cut > 0) lower = cut;
+                if (is_relative && cut < 0) upper = -cut;
+            }
+            if (lower > generator::max_peel || upper > generator::max_peel) continue;
+
+            peels[dim].first = std::max(peels[dim].first, lower);
+            peels[dim].second = std::max(peels[dim].second, upper);
+            decided[dim][node.get()] = value;
+            is_decided = true;
+        }
+        if (!is_decided) return false;
+
+        //  Count the copies of the body: one per border, the inner copies per interior, and the general loop.
+        long copies = 1;
+        bool is_peeled = false;
+        for (long dim = rank - 1; dim >= 0; --dim) {
+            copies += (peels[dim].first > 0) + (peels[dim].second > 0);
+            is_peeled |= peels[dim].first + peels[dim].second > 0;
         }
+        return is_peeled
+            && generator::expression_size(expression->item_expr) <= generator::max_index_split_size / (copies + 1);
+    }
 
-        for (long index = rank - 1; index >= 0; --index) {
-            const std::string& name = std::get<0>(expression->binding_pairs[index]).text;
+    std::vector<std::shared_ptr<ast_node::expr_node>>
+    generator::subexpressions(const std::shared_ptr<ast_node::expr_node>& expression) {
+        std::vector<std::shared_ptr<ast_node::expr_node>> children;
+        switch (expression->type) {
+            case ast_node::ARRAY_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression);
+                children.push_back(array_index->array);
+                children.insert(children.end(), array_index->params.begin(), array_index->params.end());
+                break;
+            }
+            case ast_node::ARRAY_LITERAL_EXPR:
+                children = std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(expression)->expressions;
+                break;
+            case ast_node::ARRAY_LOOP_EXPR: {
+                const std::shared_ptr<ast_node::array_loop_expr_node> array_loop
+                        = std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(expression);
+                for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair :
+                     array_loop->binding_pairs) {
+                    children.push_back(std::get<1>(pair));
+                }
+                children.push_back(array_loop->item_expr);
+                break;
+            }
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                children = {binop->left_operand, binop->right_operand};
+                break;
+            }
+            case ast_node::CALL_EXPR:
+                children = std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression)->call_args;
+                break;
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                children = {if_expr->conditional_expr, if_expr->affirmative_expr, if_expr->negative_expr};
+                break;
+            }
+            case ast_node::SUM_LOOP_EXPR: {
+                const std::shared_ptr<ast_node::sum_loop_expr_node> sum_loop
+                        = std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(expression);
+                for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair :
+                     sum_loop->binding_pairs) {
+                    children.push_back(std::get<1>(pair));
+                }
+                children.push_back(sum_loop->sum_expr);
+                break;
+            }
+            case ast_node::TUPLE_INDEX_EXPR:
+                children.push_back(std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression)->expr);
+                break;
+            case ast_node::TUPLE_LITERAL_EXPR:
+                children = std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression)->exprs;
+                break;
+            case ast_node::UNOP_EXPR:
+                children.push_back(std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand);
+                break;
+            default:
+                break;
+        }
+        return children;
+    }
 
-            if (this->debug) assembly << "\t;  Increment " << name << "\n";
-            assembly << "\tadd qword [rsp + " << reg_size * index << "], 1\n";
+    std::shared_ptr<ast_node::if_expr_node>
+    generator::invariant_condition(const std::shared_ptr<ast_node::expr_node>& body,
+                                   const std::vector<std::string>& loop_vars) const {
+        std::vector<std::shared_ptr<ast_node::expr_node>> children;
+        switch (body->type) {
+            case ast_node::ARRAY_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(body);
+                children.push_back(array_index->array);
+                children.insert(children.end(), array_index->params.begin(), array_index->params.end());
+                break;
+            }
+            case ast_node::ARRAY_LITERAL_EXPR:
+                children = std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(body)->expressions;
+                break;
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(body);
+                children = {binop->left_operand, binop->right_operand};
+                break;
+            }
+            case ast_node::CALL_EXPR:
+                children = std::reinterpret_pointer_cast<ast_node::call_expr_node>(body)->call_args;
+                break;
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(body);
+
+                const auto unswitched = this->unswitched_ifs.find(if_expr.get());
+                if (unswitched != this->unswitched_ifs.end()) {
+                    return this->invariant_condition(
+                            unswitched->second ? if_expr->affirmative_expr : if_expr->negative_expr, loop_vars);
+                }
 
-            if (this->debug) assembly << "\t;  Compare " << name << " to its bound\n";
-            assembly << "\tmov rax, [rsp + " << reg_size * index << "]\n"
-                     << "\tcmp rax, [rsp + " << reg_size * (index + rank) << "]\n"
-                     << "\tjl " << body_start;
-            if (this->debug) assembly << " ; If " << name << " < bound, run next iteration";
-            assembly << "\n";
+                long condition = 0;
+                if (generator::speculation_cost(if_expr->conditional_expr) >= 0
+                    && !generator::mentions_variable(if_expr->conditional_expr, loop_vars)
+                    && !this->constant_int_value(if_expr->conditional_expr, condition))
+                    return if_expr;
 
-            if (index > 0) {
-                assembly << "\tmov qword [rsp + " << index * reg_size << "], 0";
-                if (this->debug) assembly << " ; Set " << name << " = 0";
-                assembly << "\n";
+                children = {if_expr->conditional_expr, if_expr->affirmative_expr, if_expr->negative_expr};
+                break;
             }
+            case ast_node::TUPLE_INDEX_EXPR:
+                children.push_back(std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(body)->expr);
+                break;
+            case ast_node::TUPLE_LITERAL_EXPR:
+                children = std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(body)->exprs;
+                break;
+            case ast_node::UNOP_EXPR:
+                children.push_back(std::reinterpret_pointer_cast<ast_node::unop_expr_node>(body)->operand);
+                break;
+            default:
+                break;
         }
 
-        assembly << "\tadd rsp, " << reg_size * rank;
-        if (this->debug) assembly << " ; Free all loop variables";
-        assembly << "\n";
-        for (long index = 0; index < rank; ++index) { this->stack.pop(); }
-        assembly << "\tadd rsp, " << reg_size * rank;
-        if (this->debug) assembly << " ; Free all loop bounds";
-        assembly << "\n";
-        for (long index = 0; index < rank; ++index) { this->stack.pop(); }
+        for (const std::shared_ptr<ast_node::expr_node>& child : children) {
+            const std::shared_ptr<ast_node::if_expr_node> if_expr = this->invariant_condition(child, loop_vars);
+            if (if_expr != nullptr) return if_expr;
+        }
+        return nullptr;
+    }
 
-        if (this->debug) assembly << "\t;  END generate_expr_sum_loop\n";
+    bool generator::cannot_fail_except(const std::shared_ptr<ast_node::expr_node>& expression,
+                                       const std::unordered_set<const ast_node::expr_node*>& excluded) const {
+        if (excluded.count(expression.get()) > 0) return true;
 
-        return assembly.str();
+        switch (expression->type) {
+            case ast_node::ARRAY_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& element :
+                     std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(expression)->expressions) {
+                    if (!this->cannot_fail_except(element, excluded)) return false;
+                }
+                return true;
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                const bool is_division = binop->operator_type == ast_node::BINOP_DIVIDE
+                                      || binop->operator_type == ast_node::BINOP_MOD;
+                const bool is_int_division
+                        = is_division && binop->left_operand->r_type->type == resolved_type::INT_TYPE;
+                long divisor = 0;
+                if (is_int_division && (!this->constant_int_value(binop->right_operand, divisor) || divisor == 0))
+                    return false;
+
+                return this->cannot_fail_except(binop->left_operand, excluded)
+                    && this->cannot_fail_except(binop->right_operand, excluded);
+            }
+            case ast_node::TUPLE_INDEX_EXPR:
+                return this->cannot_fail_except(
+                        std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression)->expr, excluded);
+            case ast_node::TUPLE_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& element :
+                     std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression)->exprs) {
+                    if (!this->cannot_fail_except(element, excluded)) return false;
+                }
+                return true;
+            case ast_node::UNOP_EXPR:
+                return this->cannot_fail_except(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand, excluded);
+            case ast_node::VARIABLE_EXPR:
+                return true;
+            default:
+                return generator::speculation_cost(expression) >= 0;
+        }
     }
 
-    std::string generator::generate_expr_true(const std::shared_ptr<ast_node::true_expr_node>&) {
-        std::stringstream assembly;
+    bool generator::loop_body_cannot_fail(
+            const std::shared_ptr<ast_node::expr_node>& body,
+            const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& bindings) const {
+        constexpr long reg_size = 8;
 
-        if (this->debug) assembly << "\t;  START generate_expr_true\n";
+        switch (body->type) {
+            case ast_node::ARRAY_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(body);
+                if (this->opt_level < 2 || array_index->array->type != ast_node::VARIABLE_EXPR) return false;
+
+                const std::vector<ast_node::cp_value>& dims = array_index->array->cp_val.array_value;
+                std::string header_reg;
+                long header_offset = 0;
+                const bool has_header = this->memory_operand(array_index->array, header_reg, header_offset);
+
+                //  Returns whether the given bound is the variable holding the given dimension of the array.
+                const auto is_dimension = [&](const std::shared_ptr<ast_node::expr_node>& bound, long dim) {
+                    if (!has_header || bound->type != ast_node::VARIABLE_EXPR) return false;
+
+                    const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(bound)->name;
+                    long value = 0;
+                    return !this->variables.get_variable_constant(name, value)
+                        && this->variables.get_variable_address(name)
+                                   == std::make_tuple(header_reg, header_offset - reg_size * dim);
+                };
 
-        if (this->opt_level >= 1) {
-            assembly << "\tpush qword 1";
-            if (this->debug) assembly << " ; True";
-            assembly << "\n";
-            this->stack.push();
-        } else {
-            assembly << "\tmov rax, [rel " << (*this->constants)[(long)1] << "]";
-            if (this->debug) assembly << " ; True";
-            assembly << "\n"
-                     << "\tpush rax\n";
-            this->stack.push();
-        }
+                for (unsigned long dim = 0; dim < array_index->params.size(); ++dim) {
+                    const bool is_known_dim = dims.size() > dim && dims[dim].type == ast_node::INT_VALUE;
 
-        if (this->debug) assembly << "\t;  END generate_expr_true\n";
+                    const std::shared_ptr<ast_node::expr_node>& param = array_index->params[dim];
+                    long value = 0;
+                    if (this->constant_int_value(param, value)) {
+                        if (!is_known_dim || value < 0 || value >= dims[dim].int_value) return false;
+                        continue;
+                    }
 
-        return assembly.str();
+                    //  A loop variable is within its bound.
+                    if (param->type != ast_node::VARIABLE_EXPR) return false;
+                    const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(param)->name;
+                    bool is_in_bounds = false;
+                    for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : bindings) {
+                        if (std::get<0>(pair).text != name) continue;
+                        long bound = 0;
+                        is_in_bounds = (is_known_dim && this->constant_int_value(std::get<1>(pair), bound)
+                                        && bound <= dims[dim].int_value)
+                                    || is_dimension(std::get<1>(pair), (long)dim);
+                    }
+                    if (!is_in_bounds) return false;
+                }
+                return true;
+            }
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(body);
+                if (binop->operator_type == ast_node::BINOP_DIVIDE || binop->operator_type == ast_node::BINOP_MOD) {
+                    return generator::speculation_cost(body) >= 0;
+                }
+                return this->loop_body_cannot_fail(binop->left_operand, bindings)
+                    && this->loop_body_cannot_fail(binop->right_operand, bindings);
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(body);
+                return this->loop_body_cannot_fail(if_expr->conditional_expr, bindings)
+                    && this->loop_body_cannot_fail(if_expr->affirmative_expr, bindings)
+                    && this->loop_body_cannot_fail(if_expr->negative_expr, bindings);
+            }
+            case ast_node::TUPLE_INDEX_EXPR:
+                return this->loop_body_cannot_fail(
+                        std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(body)->expr, bindings);
+            case ast_node::TUPLE_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& element :
+                     std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(body)->exprs) {
+                    if (!this->loop_body_cannot_fail(element, bindings)) return false;
+                }
+                return true;
+            case ast_node::UNOP_EXPR:
+                return this->loop_body_cannot_fail(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(body)->operand, bindings);
+            case ast_node::VARIABLE_EXPR:
+                return true;
+            default:
+                return generator::speculation_cost(body) >= 0;
+        }
     }
 
-    std::string
-    generator::generate_expr_tuple_index(const std::shared_ptr<ast_node::tuple_index_expr_node>& expression) {
-        std::stringstream assembly;
+    bool generator::same_expression(const std::shared_ptr<ast_node::expr_node>& first,
+                                    const std::shared_ptr<ast_node::expr_node>& second) {
+        if (first->type != second->type) return false;
 
-        constexpr unsigned int reg_size = 8;
+        switch (first->type) {
+            case ast_node::FALSE_EXPR:
+            case ast_node::TRUE_EXPR:
+                return true;
+            case ast_node::INTEGER_EXPR:
+                return std::reinterpret_pointer_cast<ast_node::integer_expr_node>(first)->value
+                    == std::reinterpret_pointer_cast<ast_node::integer_expr_node>(second)->value;
+            case ast_node::VARIABLE_EXPR:
+                return std::reinterpret_pointer_cast<ast_node::variable_expr_node>(first)->name
+                    == std::reinterpret_pointer_cast<ast_node::variable_expr_node>(second)->name;
+            case ast_node::UNOP_EXPR: {
+                const std::shared_ptr<ast_node::unop_expr_node> first_unop
+                        = std::reinterpret_pointer_cast<ast_node::unop_expr_node>(first);
+                const std::shared_ptr<ast_node::unop_expr_node> second_unop
+                        = std::reinterpret_pointer_cast<ast_node::unop_expr_node>(second);
+                return first_unop->operator_type == second_unop->operator_type
+                    && generator::same_expression(first_unop->operand, second_unop->operand);
+            }
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> first_binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(first);
+                const std::shared_ptr<ast_node::binop_expr_node> second_binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(second);
+                return first_binop->operator_type == second_binop->operator_type
+                    && generator::same_expression(first_binop->left_operand, second_binop->left_operand)
+                    && generator::same_expression(first_binop->right_operand, second_binop->right_operand);
+            }
+            default:
+                return false;
+        }
+    }
 
-        if (this->debug) assembly << "\t;  START generate_expr_tuple_index\n";
+    std::vector<long> generator::constant_trip_counts(
+            const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& binding_pairs) const {
+        if (this->opt_level < 2) return {};
 
-        assembly << this->generate_expr(expression->expr);
+        std::vector<long> bounds;
+        long trip_count = 1;
+        for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair : binding_pairs) {
+            long bound;
+            //  Non-positive bounds are left to the run-time check.
+            if (!this->constant_int_value(std::get<1>(pair), bound) || bound <= 0) return {};
 
-        const unsigned int element_index = expression->index->value;
-        const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
-                = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(expression->expr->r_type);
-        const unsigned int element_size = tuple_type->element_types[element_index]->size();
-        const long element_offset = (long)tuple_type->offset(element_index);
-        const long destination = (long)tuple_type->size() - element_size;  //  NOLINT(*-narrowing-conversions)
+            trip_count *= bound;
+            if (trip_count > generator::max_unroll_trip_count) return {};
 
-        if (this->debug)
-            assembly << "\t;  Moving " << element_size << " bytes from rsp + " << element_offset << " to rsp + "
-                     << destination << "\n";
+            bounds.push_back(bound);
+        }
 
-        if (element_size > 0) {
-            for (long mov_offset = (long)(element_size - reg_size); mov_offset >= 0; mov_offset -= reg_size) {
-                if (this->debug) assembly << "\t";
-                assembly << "\tmov r10, [rsp + " << element_offset << " + " << mov_offset << "]\n";
+        return bounds;
+    }
 
-                if (this->debug) assembly << "\t";
-                assembly << "\tmov [rsp + " << destination << " + " << mov_offset << "], r10\n";
+    bool generator::is_source_constant(const std::shared_ptr<ast_node::expr_node>& expression) const {
+        switch (expression->type) {
+            case ast_node::INTEGER_EXPR:
+            case ast_node::TRUE_EXPR:
+            case ast_node::FALSE_EXPR:
+                return true;
+            case ast_node::VARIABLE_EXPR: {
+                const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression)->name;
+                long value = 0;
+                return this->variables.get_variable_constant(name, value) && !this->variables.is_loop_constant(name);
             }
-
-            this->stack.pop();
-            this->stack.push(element_size);
+            case ast_node::UNOP_EXPR:
+                return this->is_source_constant(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand);
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                return this->is_source_constant(binop->left_operand) && this->is_source_constant(binop->right_operand);
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                return this->is_source_constant(if_expr->conditional_expr)
+                    && this->is_source_constant(if_expr->affirmative_expr)
+                    && this->is_source_constant(if_expr->negative_expr);
+            }
+            default:
+                return false;
         }
-
-        assembly << "\tadd rsp, " << tuple_type->size() - element_size << "\n";
-
-        if (this->debug) assembly << "\t;  END generate_expr_tuple_index\n";
-
-        return assembly.str();
     }
 
-    std::string
-    generator::generate_expr_tuple_literal(const std::shared_ptr<ast_node::tuple_literal_expr_node>& expression) {
-        std::stringstream assembly;
+    std::string generator::callee_symbol(const std::shared_ptr<ast_node::call_expr_node>& call) {
+        const std::string symbol = "_" + call->name;
+        if (this->opt_level < 2 || this->flags.memoize.count(call->name) > 0) return symbol;
+
+        const auto function = this->specializations->functions.find(call->name);
+        if (function == this->specializations->functions.end()) return symbol;
 
-        if (this->debug) assembly << "\t;  START generate_expr_tuple_literal\n";
+        const std::shared_ptr<ast_node::fn_cmd_node>& fn_node = function->second.first;
+        std::vector<std::pair<std::string, long>> constant_params;
+        std::string key = call->name;
+        for (unsigned int index = 0; index < call->call_args.size(); ++index) {
+            const std::shared_ptr<ast_node::expr_node>& arg = call->call_args[index];
+            if (arg->r_type->type != resolved_type::INT_TYPE && arg->r_type->type != resolved_type::BOOL_TYPE) continue;
+            if (fn_node->bindings[index]->type != ast_node::VAR_BINDING) continue;
 
-        //  Generate assembly from right to left.
-        for (long index = (long)(expression->exprs.size() - 1); index >= 0; index--) {
-            assembly << this->generate_expr(expression->exprs[index]);
+            const std::shared_ptr<ast_node::argument_node> argument
+                    = std::reinterpret_pointer_cast<ast_node::var_binding_node>(fn_node->bindings[index])->binding_arg;
+            long value = 0;
+            if (argument->type != ast_node::VARIABLE_ARGUMENT || !this->is_source_constant(arg)
+                || !this->constant_int_value(arg, value))
+                continue;
+
+            constant_params.emplace_back(
+                    std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name, value);
+            key += " " + std::to_string(index) + "=" + std::to_string(value);
         }
+        if (constant_params.empty()) return symbol;
 
-        //  We don't pop from the stack as we go, because sub-expressions need to know the status of the stack.
-        //  We need to pop it all now, though, and replace it with one number.
-        for (long index = 0; index < (long)(expression->exprs.size()); index++) { this->stack.pop(); }
-        this->stack.push(expression->r_type->size());
+        const auto clone = this->specializations->clones.find(key);
+        if (clone != this->specializations->clones.end()) return clone->second;
 
-        if (this->debug) assembly << "\t;  END generate_expr_tuple_literal\n";
+        const std::vector<std::string>& in_progress = this->specializations->in_progress;
+        if (std::find(in_progress.begin(), in_progress.end(), call->name) != in_progress.end()) return symbol;
 
-        return assembly.str();
+        long& num_clones = this->specializations->num_clones[call->name];
+        if (num_clones >= max_specializations) return symbol;
+
+        //  Register the clone before generating it, so recursive calls with the same constants reuse it.
+        const std::string clone_symbol = symbol + ".spec" + std::to_string(++num_clones);
+        this->specializations->clones[key] = clone_symbol;
+
+        const fn_generator clone_generator(this->global_symbol_table, fn_node, this->constants,
+                                           this->function_signatures, this->specializations, this->shared_state,
+                                           function->second.second, this->debug, this->opt_level, this->flags,
+                                           constant_params, clone_symbol);
+        this->specializations->assemblies.emplace_back(clone_generator.assem());
+
+        return clone_symbol;
     }
 
-    std::string generator::generate_expr_unop(const std::shared_ptr<ast_node::unop_expr_node>& expression) {
-        std::stringstream assembly;
+    bool generator::returns_in_memory(const std::shared_ptr<ast_node::expr_node>& expression) const {
+        if (this->opt_level < 1 || expression->type != ast_node::CALL_EXPR) return false;
 
-        if (this->debug) assembly << "\t;  START generate_expr_unop\n";
+        const std::string& name = std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression)->name;
+        const auto signature = this->function_signatures->find(name);
+        return signature != this->function_signatures->end() && signature->second.struct_return;
+    }
 
-        assembly << this->generate_expr(expression->operand);
+    bool generator::is_planar(const std::shared_ptr<resolved_type::resolved_type>& type) const {
+        if (!this->flags.planar_tuples || type->type != resolved_type::ARRAY_TYPE) return false;
 
-        if (expression->operator_type == ast_node::UNOP_INV) {
-            assembly << "\tpop rax\n";
-            this->stack.pop();
-            assembly << "\txor rax, 1\n"
-                     << "\tpush rax\n";
-            this->stack.push();
-        } else {
-            if (expression->r_type->type == resolved_type::resolved_type_type::INT_TYPE) {
-                assembly << "\tpop rax\n";
-                this->stack.pop();
-                assembly << "\tneg rax\n"
-                         << "\tpush rax\n";
-                this->stack.push();
-            } else {
-                assembly << "\tmovsd xmm1, [rsp]\n"
-                         << "\tadd rsp, 8\n";
-                this->stack.pop();
-                assembly << "\tpxor xmm0, xmm0\n"
-                         << "\tsubsd xmm0, xmm1\n"
-                         << "\tsub rsp, 8\n";
-                this->stack.push();
-                assembly << "\tmovsd [rsp], xmm0\n";
-            }
-        }
+        const std::shared_ptr<resolved_type::resolved_type>& element
+                = std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(type)->element_type;
+        if (element->type != resolved_type::TUPLE_TYPE) return false;
 
-        if (this->debug) assembly << "\t;  END generate_expr_unop\n";
+        const std::vector<std::shared_ptr<resolved_type::resolved_type>>& fields
+                = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(element)->element_types;
+        if (fields.size() < 2) return false;
+        for (const std::shared_ptr<resolved_type::resolved_type>& field : fields) {
+            if (field->type != resolved_type::FLOAT_TYPE) return false;
+        }
 
-        return assembly.str();
+        return this->shared_state->interleaved_arrays.count(type->s_expression()) == 0;
     }
 
-    std::string generator::generate_expr_variable(const std::shared_ptr<ast_node::variable_expr_node>& expression) {
-        std::stringstream assembly;
-        constexpr unsigned int reg_size = 8;
-
-        if (this->debug) assembly << "\t;  START generate_expr_variable\n";
+    bool generator::is_element_in_memory(const std::shared_ptr<ast_node::expr_node>& expression) const {
+        if (expression->type != ast_node::ARRAY_INDEX_EXPR) return false;
 
-        const ast_node::cp_value& cp_val = expression->cp_val;
-        if (cp_val.type == ast_node::INT_VALUE && generator::fits_into_32(cp_val.int_value)) {
-            if (this->debug) assembly << "\t;  O2: pushing integer constant\n";
+        const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression);
+        return this->window_uses.count(array_index.get()) == 0 && this->read_stage(expression) == nullptr;
+    }
 
-            this->stack.push();
+    std::shared_ptr<ast_node::array_loop_expr_node>
+    generator::read_stage(const std::shared_ptr<ast_node::expr_node>& expression) const {
+        if (expression->type != ast_node::ARRAY_INDEX_EXPR) return nullptr;
 
-            assembly << "\tpush qword " << cp_val.int_value << "\n";
-        } else {
-            const unsigned int size = expression->r_type->size();
-            assembly << "\tsub rsp, " << size << "\n";
-            this->stack.push(size);
+        const std::shared_ptr<ast_node::expr_node>& array
+                = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression)->array;
+        if (array->type != ast_node::VARIABLE_EXPR) return nullptr;
 
-            const std::tuple<std::string, long> variable_address = this->variables.get_variable_address(
-                    expression->name);
-            const std::string reg = std::get<0>(variable_address);
-            const long reg_offset = std::get<1>(variable_address);
+        const auto stage
+                = this->pipeline_stages.find(std::reinterpret_pointer_cast<ast_node::variable_expr_node>(array)->name);
+        return (stage != this->pipeline_stages.end()) ? stage->second : nullptr;
+    }
 
-            if (debug)
-                assembly << "\t;  Moving " << size << " bytes from [" << reg << " - " << reg_offset << "] to [rsp]\n";
+    bool generator::memory_operand(const std::shared_ptr<ast_node::expr_node>& expression, std::string& reg,
+                                   long& offset) const {
+        switch (expression->type) {
+            case ast_node::VARIABLE_EXPR: {
+                const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression)->name;
 
-            for (long offset = reg_size; offset <= (long)size; offset += reg_size) {
-                //  Extra indentation for debug mode.
-                if (this->debug) assembly << "\t";
-                assembly << "\tmov r10, [" << reg << " - " << reg_offset - size + offset << "]\n";
+                //  Unrolled loop variables only exist as constants.
+                long constant_value;
+                if (this->variables.get_variable_constant(name, constant_value)) return false;
 
-                if (this->debug) assembly << "\t";
-                assembly << "\tmov [rsp + " << size - offset << "], r10\n";
+                const std::tuple<std::string, long> variable_address = this->variables.get_variable_address(name);
+                reg = std::get<0>(variable_address);
+                offset = std::get<1>(variable_address);
+                return true;
+            }
+            case ast_node::TUPLE_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::tuple_index_expr_node> tuple_index
+                        = std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression);
+                if (!this->memory_operand(tuple_index->expr, reg, offset)) return false;
+
+                offset -= (long)std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(
+                                  tuple_index->expr->r_type)
+                                  ->offset(tuple_index->index->value);
+                return true;
             }
+            default:
+                return false;
         }
-
-        if (this->debug) assembly << "\t;  END generate_expr_variable\n";
-
-        return assembly.str();
     }
 
-    void generator::bind_argument(const std::shared_ptr<ast_node::argument_node>& argument,
-                                  const std::shared_ptr<resolved_type::resolved_type>& r_type) {
-        this->stack.push(r_type->size());
-        if (argument->type == ast_node::ARRAY_ARGUMENT) {
-            const std::shared_ptr<ast_node::array_argument_node> array_argument
-                    = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
-
-            this->variables.set_variable_address(array_argument->name, (long)this->stack.size());
+    long generator::partial_unroll_factor(const std::shared_ptr<ast_node::expr_node>& body) const {
+        if (this->flags.unroll_factor > 0) return this->flags.unroll_factor;
+        if (this->opt_level < 2) return 1;
 
-            long offset = 0;
-            constexpr int reg_size = 8;
-            for (const token::token& size_argument : array_argument->dimension_vars) {
-                this->variables.set_variable_address(size_argument.text, (long)this->stack.size() - offset);
-                offset += reg_size;
-            }
-        } else {
-            const std::shared_ptr<ast_node::variable_argument_node> variable_argument
-                    = std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument);
+        return (generator::expression_size(body) <= generator::max_unroll_body_size) ? generator::default_unroll_factor
+                                                                                       : 1;
+    }
 
-            this->variables.set_variable_address(variable_argument->name, (long)this->stack.size());
+    long generator::expression_size(const std::shared_ptr<ast_node::expr_node>& expression) {
+        long size = 1;
+        switch (expression->type) {
+            case ast_node::ARRAY_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression);
+                size += generator::expression_size(array_index->array);
+                for (const std::shared_ptr<ast_node::expr_node>& param : array_index->params) {
+                    size += generator::expression_size(param);
+                }
+            } break;
+            case ast_node::ARRAY_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& item :
+                     std::reinterpret_pointer_cast<ast_node::array_literal_expr_node>(expression)->expressions) {
+                    size += generator::expression_size(item);
+                }
+                break;
+            case ast_node::ARRAY_LOOP_EXPR:
+            case ast_node::SUM_LOOP_EXPR:
+                //  The loop is not innermost; don't unroll it.
+                return generator::nested_loop_size;
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                size += generator::expression_size(binop->left_operand)
+                      + generator::expression_size(binop->right_operand);
+            } break;
+            case ast_node::CALL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& arg :
+                     std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression)->call_args) {
+                    size += generator::expression_size(arg);
+                }
+                break;
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                size += generator::expression_size(if_expr->conditional_expr)
+                      + generator::expression_size(if_expr->affirmative_expr)
+                      + generator::expression_size(if_expr->negative_expr);
+            } break;
+            case ast_node::TUPLE_INDEX_EXPR:
+                size += generator::expression_size(
+                        std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression)->expr);
+                break;
+            case ast_node::TUPLE_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& item :
+                     std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression)->exprs) {
+                    size += generator::expression_size(item);
+                }
+                break;
+            case ast_node::UNOP_EXPR:
+                size += generator::expression_size(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand);
+                break;
+            default:
+                break;
         }
-    }
 
-    void generator::bind_lvalue(const std::shared_ptr<ast_node::lvalue_node>& lvalue,
-                                const std::shared_ptr<resolved_type::resolved_type>& r_type) {
-        if (lvalue->type == ast_node::ARGUMENT_LVALUE) {
-            this->bind_argument(std::reinterpret_pointer_cast<ast_node::argument_lvalue_node>(lvalue)->argument,
-                                r_type);
-        } else {
-            const std::shared_ptr<ast_node::tuple_lvalue_node> tuple_lvalue
-                    = std::reinterpret_pointer_cast<ast_node::tuple_lvalue_node>(lvalue);
-            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_r_type
-                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(r_type);
+        return std::min(size, generator::nested_loop_size);
+    }
 
-            for (long index = (long)tuple_lvalue->lvalues.size() - 1; index >= 0; index--) {
-                bind_lvalue(tuple_lvalue->lvalues[index], tuple_r_type->element_types[index]);
+    void generator::division_magic(long divisor, long& multiplier, long& shift) {
+        constexpr unsigned long two_63 = 1UL << 63;
+
+        const unsigned long magnitude = (divisor < 0) ? 0UL - (unsigned long)divisor : (unsigned long)divisor;
+        const unsigned long t = two_63 + ((unsigned long)divisor >> 63);
+        const unsigned long abs_nc = t - 1 - t % magnitude;
+
+        long p = 63;
+        unsigned long q_1 = two_63 / abs_nc;
+        unsigned long r_1 = two_63 - q_1 * abs_nc;
+        unsigned long q_2 = two_63 / magnitude;
+        unsigned long r_2 = two_63 - q_2 * magnitude;
+        unsigned long delta;
+        do {
+            ++p;
+            q_1 *= 2;
+            r_1 *= 2;
+            if (r_1 >= abs_nc) {
+                ++q_1;
+                r_1 -= abs_nc;
             }
-        }
+            q_2 *= 2;
+            r_2 *= 2;
+            if (r_2 >= magnitude) {
+                ++q_2;
+                r_2 -= magnitude;
+            }
+            delta = magnitude - r_2;
+        } while (q_1 < delta || (q_1 == delta && r_1 == 0));
+
+        multiplier = (long)(q_2 + 1);
+        if (divisor < 0) multiplier = (long)(0UL - (unsigned long)multiplier);
+        shift = p - 64;
     }
 
     bool generator::fits_into_32(long value) { return (value & INT32_MAX) == value; }
@@ -1749,9 +4863,13 @@ namespace generator {
             const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
             const std::shared_ptr<const_table>& constants,
             const std::shared_ptr<std::unordered_map<std::string, call_signature::call_signature>>& function_signatures,
-            const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level)
+            const std::shared_ptr<specialization_table>& specializations,
+            const std::shared_ptr<shared_generator_state>& shared_state,
+            const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level,
+            const generator_flags& flags)
         : constants(constants), debug(debug), function_signatures(function_signatures),
-          global_symbol_table(global_symbol_table), opt_level(opt_level), variables(parent_variable_table) {}
+          specializations(specializations), shared_state(shared_state), global_symbol_table(global_symbol_table),
+          opt_level(opt_level), flags(flags), variables(parent_variable_table) {}
 
     //  ===========================
     //  ||  Function generator:  ||
@@ -1780,33 +4898,11 @@ namespace generator {
     void fn_generator::generate_stmt_assert(const std::shared_ptr<ast_node::assert_stmt_node>& statement) {
         if (this->debug) this->main_assembly << "\t;  START generate_stmt_assert\n";
 
-        this->main_assembly << generate_expr(statement->expr) << "\tpop rax\n";
-        this->stack.pop();
-
         const std::string next_jump = (*this->constants).next_jump();
 
-        this->main_assembly << "\tcmp rax, 0\n"
-                            << "\tjne " << next_jump << "\n";
-
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-
-        this->main_assembly << "\tlea rdi, [rel " << (*this->constants)[statement->text] << "]";
-        if (this->debug) this->main_assembly << " ; " << statement->text;
-        this->main_assembly << "\n"
-                            << "\tcall _fail_assertion\n";
+        this->main_assembly << this->generate_cond_jump(statement->expr, true, next_jump);
 
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        this->main_assembly << this->generate_fail_assertion(statement->text);
 
         this->main_assembly << next_jump << ":\n";
 
@@ -1827,9 +4923,92 @@ namespace generator {
     void fn_generator::generate_stmt_return(const std::shared_ptr<ast_node::return_stmt_node>& statement) {
         if (this->debug) this->main_assembly << "\t;  START generate_stmt_return\n";
 
-        this->main_assembly << generate_expr(statement->return_val);
+        this->generate_return(statement->return_val);
+
+        if (this->debug) this->main_assembly << "\t;  END generate_stmt_return\n";
+    }
+
+    void fn_generator::generate_return(const std::shared_ptr<ast_node::expr_node>& return_val) {
+        if (this->opt_level >= 1 && return_val->type == ast_node::IF_EXPR && this->has_tail_call(return_val)) {
+            const std::shared_ptr<ast_node::if_expr_node> if_expr
+                    = std::reinterpret_pointer_cast<ast_node::if_expr_node>(return_val);
+            const std::string else_label = this->constants->next_jump();
+
+            if (this->debug) this->main_assembly << "\t;  O1: Splitting the return at a tail call\n";
+
+            //  Each arm returns, so each starts from the same stack.
+            const stack_info::stack_info saved_stack = this->stack;
+            this->main_assembly << this->generate_cond_jump(if_expr->conditional_expr, false, else_label);
+            this->generate_return(if_expr->affirmative_expr);
+            this->stack = saved_stack;
+
+            this->main_assembly << else_label << ":\n";
+            this->generate_return(if_expr->negative_expr);
+            this->stack = saved_stack;
+            return;
+        }
+
+        if (this->opt_level >= 1 && this->is_tail_call(return_val)) {
+            this->generate_tail_call(std::reinterpret_pointer_cast<ast_node::call_expr_node>(return_val));
+            return;
+        }
+
+        //  A call returning through memory can write straight into this function's own return slot.
+        if (this->returns_in_memory(return_val) && this->ret_registers.empty()) {
+            this->main_assembly << this->generate_expr_call(
+                                           std::reinterpret_pointer_cast<ast_node::call_expr_node>(return_val),
+                                           [](long) { return std::string("\tmov rax, [rbp - 8]\n"); })
+                                << "\tadd rsp, " << this->stack.size() << "\n"
+                                << "\tpop rbp\n"
+                                << "\tret\n";
+            return;
+        }
+
+        //  A tuple literal returned through memory is built field by field in the return slot, right to left as
+        //  usual, instead of on the stack and then copied.
+        if (this->opt_level >= 1 && return_val->type == ast_node::TUPLE_LITERAL_EXPR && this->ret_registers.empty()
+            && return_val->r_type->size() > 0) {
+            constexpr long reg_size = 8;
+            const std::shared_ptr<ast_node::tuple_literal_expr_node> tuple_literal
+                    = std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(return_val);
+            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
+                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(return_val->r_type);
+
+            if (this->debug) this->main_assembly << "\t;  O1: Building the returned tuple in the return slot\n";
+
+            for (long index = (long)tuple_literal->exprs.size() - 1; index >= 0; --index) {
+                const std::shared_ptr<ast_node::expr_node>& field = tuple_literal->exprs[index];
+                const long field_offset = (long)tuple_type->offset(index);
+
+                if (this->returns_in_memory(field)) {
+                    this->main_assembly << this->generate_expr_call(
+                            std::reinterpret_pointer_cast<ast_node::call_expr_node>(field), [field_offset](long) {
+                                return "\tmov rax, [rbp - 8]\n\tadd rax, " + std::to_string(field_offset) + "\n";
+                            });
+                    continue;
+                }
+
+                const long size = (long)field->r_type->size();
+                this->main_assembly << generate_expr(field) << "\tmov rax, [rbp - 8]";
+                if (this->debug) this->main_assembly << " ; Address for the return value.";
+                this->main_assembly << "\n";
+                for (long offset = size - reg_size; offset >= 0; offset -= reg_size) {
+                    this->main_assembly << "\tmov r10, [rsp + " << offset << "]\n"
+                                        << "\tmov [rax + " << field_offset + offset << "], r10\n";
+                }
+                if (size > 0) this->main_assembly << "\tadd rsp, " << size << "\n";
+                this->stack.pop();
+            }
+
+            this->main_assembly << "\tadd rsp, " << this->stack.size() << "\n"
+                                << "\tpop rbp\n"
+                                << "\tret\n";
+            return;
+        }
+
+        this->main_assembly << generate_expr(return_val);
 
-        switch (statement->return_val->r_type->type) {
+        switch (return_val->r_type->type) {
             case resolved_type::BOOL_TYPE:
             case resolved_type::INT_TYPE:
                 this->main_assembly << "\tpop rax\n";
@@ -1843,14 +5022,21 @@ namespace generator {
             case resolved_type::ARRAY_TYPE:
             case resolved_type::TUPLE_TYPE:
                 bool has_return_val = true;
-                if (statement->return_val->r_type->type == resolved_type::TUPLE_TYPE) {
-                    if (std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(statement->return_val->r_type)
+                if (return_val->r_type->type == resolved_type::TUPLE_TYPE) {
+                    if (std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(return_val->r_type)
                                 ->element_types.empty()) {
                         has_return_val = false;
                     }
                 }
-                if (has_return_val) {
-                    const long size = (long)statement->return_val->r_type->size();
+                if (has_return_val && !this->ret_registers.empty()) {
+                    if (this->debug) this->main_assembly << "\t;  O1: Returning in registers\n";
+
+                    for (const std::pair<long, std::string>& reg : this->ret_registers) {
+                        this->main_assembly << "\t" << (reg.second.rfind("xmm", 0) == 0 ? "movsd " : "mov ")
+                                            << reg.second << ", [rsp + " << reg.first << "]\n";
+                    }
+                } else if (has_return_val) {
+                    const long size = (long)return_val->r_type->size();
                     this->main_assembly << "\tmov rax, [rbp - 8]";
                     if (this->debug) this->main_assembly << " ; Address for the return value.";
                     this->main_assembly << "\n";
@@ -1873,16 +5059,236 @@ namespace generator {
         this->main_assembly << "\tadd rsp, " << this->stack.size() << "\n"
                             << "\tpop rbp\n"
                             << "\tret\n";
+    }
 
-        if (this->debug) this->main_assembly << "\t;  END generate_stmt_return\n";
+    void fn_generator::generate_memo_wrapper(const std::string& name, const call_signature::call_signature& call_sig,
+                                             const std::string& body_name) {
+        constexpr long reg_size = 8;
+
+        const auto is_scalar = [](const std::shared_ptr<resolved_type::resolved_type>& r_type) {
+            return r_type->type == resolved_type::INT_TYPE || r_type->type == resolved_type::BOOL_TYPE
+                || r_type->type == resolved_type::FLOAT_TYPE;
+        };
+        if (!is_scalar(call_sig.ret_type)) {
+            throw std::runtime_error("`generate_memo_wrapper`: cannot memoize \"" + name
+                                     + "\": the result must be an int, bool, or float");
+        }
+
+        //  Every argument is 8 bytes. Register arguments are spilled below RBP; stack arguments lie above it.
+        const long num_args = (long)call_sig.all_args.size();
+        std::vector<std::string> homes;
+        long num_reg_args = 0;
+        long stack_offset = 2 * reg_size;
+        for (const std::tuple<std::shared_ptr<resolved_type::resolved_type>, bool,
+                              call_signature::call_signature::register_list>& arg : call_sig.all_args) {
+            if (!is_scalar(std::get<0>(arg))) {
+                throw std::runtime_error("`generate_memo_wrapper`: cannot memoize \"" + name
+                                         + "\": every argument must be an int, bool, or float");
+            }
+            if (std::get<1>(arg)) {
+                homes.emplace_back("[rbp - " + std::to_string(reg_size * ++num_reg_args) + "]");
+            } else {
+                homes.emplace_back("[rbp + " + std::to_string(stack_offset) + "]");
+                stack_offset += reg_size;
+            }
+        }
+
+        const std::string cache = "jpl_memo_" + name;
+        const std::string hits = cache + "_hits";
+        const std::string misses = cache + "_misses";
+        const long entry_size = reg_size * (num_args + 2);
+        const long result_offset = reg_size * (num_args + 1);
+        const long entry_slot = reg_size * (num_reg_args + 1);
+        const bool float_result = call_sig.ret_type->type == resolved_type::FLOAT_TYPE;
+
+        this->bss_assembly << "align 16\n" << cache << ": resb " << memo_cache_entries * entry_size << "\n";
+        if (this->flags.memo_stats) {
+            this->bss_assembly << "global " << hits << "\n"
+                               << "global " << misses << "\n"
+                               << hits << ": resq 1\n"
+                               << misses << ": resq 1\n";
+        }
+
+        this->main_assembly << name << ":\n_" << name << ":\n";
+        if (this->debug) this->main_assembly << "\t;  Memoized: look the arguments up in " << cache << "\n";
+
+        this->main_assembly << "\tpush rbp\n"
+                            << "\tmov rbp, rsp\n";
+        for (const std::tuple<std::shared_ptr<resolved_type::resolved_type>, bool,
+                              call_signature::call_signature::register_list>& arg : call_sig.all_args) {
+            if (!std::get<1>(arg)) continue;
+
+            const std::string& reg = std::get<2>(arg)[0].second;
+            if (reg.rfind("xmm", 0) == 0) {
+                this->main_assembly << "\tsub rsp, 8\n"
+                                    << "\tmovsd [rsp], " << reg << "\n";
+            } else {
+                this->main_assembly << "\tpush " << reg << "\n";
+            }
+        }
+
+        //  Hash the argument bits, and keep the address of the entry at [rbp - entry_slot].
+        this->main_assembly << "\tmov rax, 0\n"
+                            << "\tmov r11, 0x9E3779B97F4A7C15\n";
+        for (const std::string& home : homes) {
+            this->main_assembly << "\txor rax, " << home << "\n"
+                                << "\timul rax, r11\n";
+        }
+        this->main_assembly << "\tshr rax, " << 64 - generator::log_2(memo_cache_entries) << "\n"
+                            << "\timul rax, " << entry_size << "\n"
+                            << "\tlea r11, [rel " << cache << "]\n"
+                            << "\tadd rax, r11\n"
+                            << "\tpush rax\n";
+
+        const std::string miss = this->constants->next_jump();
+        this->main_assembly << "\tcmp qword [rax], 0\n"
+                            << "\tje " << miss << "\n";
+        for (long index = 0; index < num_args; ++index) {
+            this->main_assembly << "\tmov r10, " << homes[index] << "\n"
+                                << "\tcmp r10, [rax + " << reg_size * (index + 1) << "]\n"
+                                << "\tjne " << miss << "\n";
+        }
+        if (this->flags.memo_stats) this->main_assembly << "\tadd qword [rel " << hits << "], 1\n";
+        this->main_assembly << "\t" << (float_result ? "movsd xmm0" : "mov rax") << ", [rax + " << result_offset
+                            << "]\n"
+                            << "\tmov rsp, rbp\n"
+                            << "\tpop rbp\n"
+                            << "\tret\n";
+
+        //  On a miss, call the body with the same arguments, then fill the entry.
+        this->main_assembly << miss << ":\n";
+        if (this->flags.memo_stats) this->main_assembly << "\tadd qword [rel " << misses << "], 1\n";
+        stack_info::stack_info frame;
+        frame.push(entry_slot);
+        const unsigned int padding = frame.alignment_padding(call_sig.bytes_on_stack);
+        if (padding > 0) {
+            this->main_assembly << "\tsub rsp, " << padding;
+            if (this->debug) this->main_assembly << " ; Align stack";
+            this->main_assembly << "\n";
+        }
+        for (long offset = (long)call_sig.bytes_on_stack - reg_size; offset >= 0; offset -= reg_size) {
+            this->main_assembly << "\tpush qword [rbp + " << 2 * reg_size + offset << "]\n";
+        }
+        for (long index = 0; index < num_args; ++index) {
+            if (!std::get<1>(call_sig.all_args[index])) continue;
+
+            const std::string& reg = std::get<2>(call_sig.all_args[index])[0].second;
+            this->main_assembly << "\t" << (reg.rfind("xmm", 0) == 0 ? "movsd " : "mov ") << reg << ", "
+                                << homes[index] << "\n";
+        }
+        this->main_assembly << "\tcall " << body_name << "\n"
+                            << "\tmov r10, [rbp - " << entry_slot << "]\n";
+        for (long index = 0; index < num_args; ++index) {
+            this->main_assembly << "\tmov r11, " << homes[index] << "\n"
+                                << "\tmov [r10 + " << reg_size * (index + 1) << "], r11\n";
+        }
+        this->main_assembly << "\t" << (float_result ? "movsd" : "mov") << " [r10 + " << result_offset << "], "
+                            << (float_result ? "xmm0" : "rax") << "\n"
+                            << "\tmov qword [r10], 1\n"
+                            << "\tmov rsp, rbp\n"
+                            << "\tpop rbp\n"
+                            << "\tret\n";
+    }
+
+    bool fn_generator::is_tail_call(const std::shared_ptr<ast_node::expr_node>& expression) const {
+        if (expression->type != ast_node::CALL_EXPR) return false;
+
+        const std::string& name = std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression)->name;
+        if (name == "sqrt" || name == "to_float" || name == "to_int") return false;
+        if (name == this->function_name) return true;
+
+        const auto signature = this->function_signatures->find(name);
+        return signature != this->function_signatures->end()
+            && signature->second.bytes_on_stack <= this->stack_arg_bytes;
+    }
+
+    bool fn_generator::has_tail_call(const std::shared_ptr<ast_node::expr_node>& expression) const {
+        if (expression->type != ast_node::IF_EXPR) return this->is_tail_call(expression);
+
+        const std::shared_ptr<ast_node::if_expr_node> if_expr
+                = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+        return this->has_tail_call(if_expr->affirmative_expr) || this->has_tail_call(if_expr->negative_expr);
+    }
+
+    void fn_generator::generate_tail_call(const std::shared_ptr<ast_node::call_expr_node>& call) {
+        constexpr long reg_size = 8;
+
+        const call_signature::call_signature& function = (*this->function_signatures)[call->name];
+        const std::string callee = this->callee_symbol(call);
+
+        //  Arguments are computed in the same order as for a normal call.
+        std::vector<long> arg_offsets(call->call_args.size());
+        for (const unsigned int& index : function.push_order) {
+            this->main_assembly << this->generate_expr(call->call_args[index]);
+            for (long& offset : arg_offsets) offset += (long)call->call_args[index]->r_type->size();
+            arg_offsets[index] = 0;
+        }
+
+        if (callee == this->symbol) {
+            if (this->debug) this->main_assembly << "\t;  O1: Self tail call becomes a loop\n";
+
+            //  The new arguments lie below every argument home, so they can be stored in any order.
+            for (unsigned int index = 0; index < call->call_args.size(); ++index) {
+                const long size = (long)call->call_args[index]->r_type->size();
+                for (long offset = 0; offset < size; offset += reg_size) {
+                    const long displacement = offset - this->arg_homes[index];
+                    this->main_assembly << "\tmov r10, [rsp + " << arg_offsets[index] + offset << "]\n"
+                                        << "\tmov [rbp " << (displacement < 0 ? "- " : "+ ")
+                                        << std::labs(displacement) << "], r10\n";
+                }
+            }
+            for (unsigned int index = 0; index < call->call_args.size(); ++index) this->stack.pop();
+
+            this->main_assembly << "\tlea rsp, [rbp - " << this->body_stack_size << "]\n"
+                                << "\tjmp " << this->body_label << "\n";
+            return;
+        }
+
+        if (this->debug) this->main_assembly << "\t;  O1: Tail call to " << call->name << " reuses the frame\n";
+
+        for (const std::string& assem : function.pop_assem) {
+            this->main_assembly << assem;
+            this->stack.pop();
+        }
+
+        //  The callee's stack arguments replace this function's own, just above the return address.
+        for (long offset = 0; offset < (long)function.bytes_on_stack; offset += reg_size) {
+            this->main_assembly << "\tmov r10, [rsp + " << offset << "]\n"
+                                << "\tmov [rbp + " << 2 * reg_size + offset << "], r10\n";
+        }
+        for (unsigned int index = 0; index < function.stack_args.size(); ++index) this->stack.pop();
+
+        if (function.struct_return) this->main_assembly << "\tmov rdi, [rbp - 8]\n";
+
+        this->main_assembly << "\tmov rsp, rbp\n"
+                            << "\tpop rbp\n"
+                            << "\tjmp " << callee << "\n";
     }
 
     void fn_generator::handle_reg_binding(const std::shared_ptr<ast_node::binding_node>& binding,
                                           const std::shared_ptr<resolved_type::resolved_type>& r_type,
-                                          const std::string& reg) {
+                                          const call_signature::call_signature::register_list& registers) {
         if (binding->type == ast_node::TUPLE_BINDING) {
-            throw std::runtime_error("`handle_reg_binding`: not a register binding: \"" + binding->s_expression()
-                                     + "\"");
+            const std::shared_ptr<ast_node::tuple_binding_node> tuple_binding
+                    = std::reinterpret_pointer_cast<ast_node::tuple_binding_node>(binding);
+            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_type
+                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(r_type);
+
+            //  Bind from right to left, like a tuple on the stack, handing each element its own registers.
+            for (long index = (long)tuple_binding->bindings.size() - 1; index >= 0; --index) {
+                const long element_offset = (long)tuple_type->offset(index);
+                const long element_size = (long)tuple_type->element_types[index]->size();
+
+                call_signature::call_signature::register_list element_registers;
+                for (const std::pair<long, std::string>& reg : registers) {
+                    if (reg.first >= element_offset && reg.first < element_offset + element_size) {
+                        element_registers.emplace_back(reg.first - element_offset, reg.second);
+                    }
+                }
+                this->handle_reg_binding(tuple_binding->bindings[index], tuple_type->element_types[index],
+                                         element_registers);
+            }
+            return;
         }
 
         const std::shared_ptr<ast_node::argument_node> argument
@@ -1890,12 +5296,19 @@ namespace generator {
 
         if (r_type->type == resolved_type::FLOAT_TYPE) {
             this->main_assembly << "\tsub rsp, 8\n"
-                                << "\tmovsd [rsp], " << reg << "\n";
-            this->bind_argument(argument, r_type);
+                                << "\tmovsd [rsp], " << registers[0].second << "\n";
+        } else if (r_type->type == resolved_type::INT_TYPE || r_type->type == resolved_type::BOOL_TYPE) {
+            this->main_assembly << "\tpush " << registers[0].second << "\n";
         } else {
-            this->main_assembly << "\tpush " << reg << "\n";
-            this->bind_argument(argument, r_type);
+            if (this->debug) this->main_assembly << "\t;  O1: Spilling a " << r_type->size() << "-byte argument\n";
+
+            if (r_type->size() > 0) this->main_assembly << "\tsub rsp, " << r_type->size() << "\n";
+            for (const std::pair<long, std::string>& reg : registers) {
+                this->main_assembly << "\t" << (reg.second.rfind("xmm", 0) == 0 ? "movsd" : "mov") << " [rsp + "
+                                    << reg.first << "], " << reg.second << "\n";
+            }
         }
+        this->bind_argument(argument, r_type);
     }
 
     void fn_generator::handle_stack_binding(const std::shared_ptr<ast_node::binding_node>& binding,
@@ -1939,42 +5352,77 @@ namespace generator {
             const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
             const std::shared_ptr<ast_node::fn_cmd_node>& function, const std::shared_ptr<const_table>& constants,
             const std::shared_ptr<std::unordered_map<std::string, call_signature::call_signature>>& function_signatures,
-            const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level)
-        : generator(global_symbol_table, constants, function_signatures, parent_variable_table, debug, opt_level),
-          rbp_offset(initial_rbp_offset) {
-        this->main_assembly << function->name << ":\n_" << function->name << ":\n";
-
+            const std::shared_ptr<specialization_table>& specializations,
+            const std::shared_ptr<shared_generator_state>& shared_state,
+            const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level,
+            const generator_flags& flags, const std::vector<std::pair<std::string, long>>& constant_params,
+            const std::string& symbol)
+        : generator(global_symbol_table, constants, function_signatures, specializations, shared_state,
+                    parent_variable_table, debug, opt_level, flags),
+          rbp_offset(initial_rbp_offset),
+          stack_arg_bytes(0),
+          body_stack_size(0) {
         const std::shared_ptr<name_info::function_info> func_info
                 = std::reinterpret_pointer_cast<name_info::function_info>((*this->global_symbol_table)[function->name]);
 
-        const call_signature::call_signature call_sig(func_info->call_args, func_info->r_type);
+        //  JPL functions are only ever called from generated code, so they can use the private convention.
+        const call_signature::call_signature call_sig(func_info->call_args, func_info->r_type, this->opt_level >= 1);
         (*this->function_signatures)[function->name] = call_sig;
+        this->ret_registers = call_sig.ret_registers;
+        this->function_name = function->name;
+        this->symbol = symbol.empty() ? "_" + function->name : symbol;
+        this->specializations->in_progress.emplace_back(function->name);
+        this->stack_arg_bytes = call_sig.bytes_on_stack;
+
+        if (!symbol.empty()) {
+            this->main_assembly << symbol << ":";
+            if (this->debug) this->main_assembly << " ; Specialized clone of " << function->name;
+            this->main_assembly << "\n";
+        } else if (this->flags.memoize.count(function->name) > 0) {
+            const std::string body_name = "_" + function->name + ".uncached";
+            this->generate_memo_wrapper(function->name, call_sig, body_name);
+            this->main_assembly << body_name << ":\n";
+        } else {
+            this->main_assembly << function->name << ":\n_" << function->name << ":\n";
+        }
 
         //  1. Start with the preamble:
         this->main_assembly << "\tpush rbp\n"
                             << "\tmov rbp, rsp\n";
 
         //  2. If the function returns a struct, push the address for the return value onto the stack.
-        if ((call_sig.ret_type->type == resolved_type::ARRAY_TYPE
-             || call_sig.ret_type->type == resolved_type::TUPLE_TYPE)
-            && (call_sig.ret_type->size() > 0
-                || !std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(call_sig.ret_type)
-                            ->element_types.empty())) {
+        if (call_sig.struct_return) {
             this->main_assembly << "\tpush rdi\n";
             this->stack.push();
         }
 
         //  3. Process each argument.
         for (unsigned int arg_index = 0; arg_index < function->bindings.size(); ++arg_index) {
-            const std::tuple<std::shared_ptr<resolved_type::resolved_type>, bool, std::string>& arg_info
+            const std::tuple<std::shared_ptr<resolved_type::resolved_type>, bool,
+                             call_signature::call_signature::register_list>& arg_info
                     = call_sig.all_args[arg_index];
             if (std::get<1>(arg_info)) {
                 this->handle_reg_binding(function->bindings[arg_index], std::get<0>(arg_info), std::get<2>(arg_info));
+                this->arg_homes.emplace_back((long)this->stack.size());
             } else {
+                this->arg_homes.emplace_back(this->rbp_offset);
                 this->handle_stack_binding(function->bindings[arg_index], std::get<0>(arg_info));
             }
         }
 
+        for (const std::pair<std::string, long>& param : constant_params) {
+            if (this->debug) this->main_assembly << "\t;  O2: " << param.first << " = " << param.second << "\n";
+            this->variables.set_variable_constant(param.first, param.second);
+        }
+
+        if (this->opt_level >= 1) {
+            this->body_label = this->constants->next_jump();
+            this->body_stack_size = this->stack.size();
+            this->main_assembly << this->body_label << ":";
+            if (this->debug) this->main_assembly << " ; Self tail calls jump here";
+            this->main_assembly << "\n";
+        }
+
         //  4. Generate each statement.
         bool has_return = false;
         for (const std::shared_ptr<ast_node::stmt_node>& statement : function->statements) {
@@ -1988,10 +5436,14 @@ namespace generator {
             this->main_assembly << "\tpop rbp\n"
                                 << "\tret\n";
         }
+
+        this->specializations->in_progress.pop_back();
     }
 
     std::string fn_generator::assem() const { return this->main_assembly.str(); }
 
+    std::string fn_generator::bss_assem() const { return this->bss_assembly.str(); }
+
     //  =======================
     //  ||  Main generator:  ||
     //  =======================
@@ -2027,33 +5479,11 @@ namespace generator {
     void main_generator::generate_cmd_assert(const std::shared_ptr<ast_node::assert_cmd_node>& command) {
         if (this->debug) this->main_assembly << "\t;  START generate_cmd_assert\n";
 
-        this->main_assembly << generate_expr(command->condition) << "\tpop rax\n";
-        this->stack.pop();
-
         const std::string next_jump = (*this->constants).next_jump();
 
-        this->main_assembly << "\tcmp rax, 0\n"
-                            << "\tjne " << next_jump << "\n";
-
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-
-        this->main_assembly << "\tlea rdi, [rel " << (*this->constants)[command->text] << "]";
-        if (this->debug) this->main_assembly << " ; " << command->text;
-        this->main_assembly << "\n"
-                            << "\tcall _fail_assertion\n";
+        this->main_assembly << this->generate_cond_jump(command->condition, true, next_jump);
 
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        this->main_assembly << this->generate_fail_assertion(command->text);
 
         this->main_assembly << next_jump << ":\n";
 
@@ -2061,58 +5491,65 @@ namespace generator {
     }
 
     void main_generator::generate_cmd_fn(const std::shared_ptr<ast_node::fn_cmd_node>& command) {
+        const std::shared_ptr<variable_table> function_variables = std::make_shared<variable_table>(this->variables);
+        this->specializations->functions[command->name] = {command, function_variables};
+
         const fn_generator function(this->global_symbol_table, command, this->constants, this->function_signatures,
-                                    std::make_shared<variable_table>(this->variables), this->debug, this->opt_level);
+                                    this->specializations, this->shared_state, function_variables, this->debug,
+                                    this->opt_level, this->flags);
         this->function_assemblies.emplace_back(function.assem());
+        this->function_bss_assembly << function.bss_assem();
     }
 
     void main_generator::generate_cmd_let(const std::shared_ptr<ast_node::let_cmd_node>& command) {
+        constexpr long reg_size = 8;
+
         if (this->debug) this->main_assembly << "\t;  START generate_cmd_let\n";
 
-        this->main_assembly << generate_expr(command->expr);
-        this->stack.pop();
+        const long size = (long)command->expr->r_type->size();
+        this->globals_size += size;
+        const long offset = this->globals_size;
+
+        //  A fused call stage is not called: the header of its function's loop is built with the function's
+        //  parameters bound to the arguments.
+        const variable_table saved_variables = this->variables;
+        std::shared_ptr<ast_node::expr_node> expression = command->expr;
+        for (const auto& stage_call : this->stage_calls) {
+            if (stage_call.second.first != command->expr || this->pipeline_stages.count(stage_call.first) == 0)
+                continue;
+            this->bind_stage_arguments(stage_call.first);
+            expression = this->pipeline_stages.at(stage_call.first);
+        }
 
-        const std::function<void(const std::shared_ptr<ast_node::lvalue_node>&,
-                                 const std::shared_ptr<resolved_type::resolved_type>&)>
-                bind_lvalue = [this, &bind_lvalue](const std::shared_ptr<ast_node::lvalue_node>& lvalue,
-                                                   const std::shared_ptr<resolved_type::resolved_type>& r_type) {
-                    if (lvalue->type == ast_node::ARGUMENT_LVALUE) {
-                        const std::shared_ptr<ast_node::argument_node> argument
-                                = std::reinterpret_pointer_cast<ast_node::argument_lvalue_node>(lvalue)->argument;
-
-                        this->stack.push(r_type->size());
-                        if (argument->type == ast_node::ARRAY_ARGUMENT) {
-                            const std::shared_ptr<ast_node::array_argument_node> array_argument
-                                    = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
-
-                            this->variables.set_variable_address(array_argument->name, (long)this->stack.size());
-
-                            long offset = 0;
-                            constexpr int reg_size = 8;
-                            for (const token::token& size_argument : array_argument->dimension_vars) {
-                                this->variables.set_variable_address(size_argument.text,
-                                                                     (long)this->stack.size() - offset);
-                                offset += reg_size;
-                            }
-                        } else {
-                            const std::shared_ptr<ast_node::variable_argument_node> variable_argument
-                                    = std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument);
+        //  A call returning through memory builds its result in the globals block itself.
+        if (this->returns_in_memory(expression)) {
+            this->main_assembly << this->generate_expr_call(
+                    std::reinterpret_pointer_cast<ast_node::call_expr_node>(command->expr), [offset](long) {
+                        return "\tlea rax, [rel " + std::string(generator::globals_end_label) + " - "
+                             + std::to_string(offset) + "]\n";
+                    });
+            this->bind_global_lvalue(command->lvalue, command->expr->r_type, offset);
+
+            if (this->debug) this->main_assembly << "\t;  END generate_cmd_let\n";
+            return;
+        }
 
-                            this->variables.set_variable_address(variable_argument->name, (long)this->stack.size());
-                        }
-                    } else {
-                        const std::shared_ptr<ast_node::tuple_lvalue_node> tuple_lvalue
-                                = std::reinterpret_pointer_cast<ast_node::tuple_lvalue_node>(lvalue);
-                        const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_r_type
-                                = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(r_type);
+        this->main_assembly << generate_expr(expression);
+        this->stack.pop();
+        this->variables.restore(saved_variables);
 
-                        for (long index = (long)tuple_lvalue->lvalues.size() - 1; index >= 0; index--) {
-                            bind_lvalue(tuple_lvalue->lvalues[index], tuple_r_type->element_types[index]);
-                        }
-                    }
-                };
+        if (this->debug) this->main_assembly << "\t;  Moving " << size << " bytes from [rsp] to the globals block\n";
+        for (long mov_offset = 0; mov_offset < size; mov_offset += reg_size) {
+            if (this->debug) this->main_assembly << "\t";
+            this->main_assembly << "\tmov r10, [rsp + " << mov_offset << "]\n";
+
+            if (this->debug) this->main_assembly << "\t";
+            this->main_assembly << "\tmov [rel " << generator::globals_end_label << " - " << offset - mov_offset
+                                << "], r10\n";
+        }
+        if (size > 0) this->main_assembly << "\tadd rsp, " << size << "\n";
 
-        bind_lvalue(command->lvalue, command->expr->r_type);
+        this->bind_global_lvalue(command->lvalue, command->expr->r_type, offset);
 
         if (this->debug) this->main_assembly << "\t;  END generate_cmd_let\n";
     }
@@ -2124,22 +5561,7 @@ namespace generator {
         if (this->debug) this->main_assembly << " ; " << command->text;
         this->main_assembly << "\n";
 
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-
-        this->main_assembly << "\tcall _print\n";
-
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        this->main_assembly << this->generate_aligned_call("_print");
 
         if (this->debug) this->main_assembly << "\t;  END generate_cmd_print\n";
     }
@@ -2149,42 +5571,40 @@ namespace generator {
 
         if (this->debug) this->main_assembly << "\t;  START generate_cmd_read\n";
 
-        this->main_assembly << "\tsub rsp, " << image_size << "\n";
-        this->stack.push(image_size);
+        //  Read the image header straight into the globals block.
+        this->globals_size += image_size;
+        const long offset = this->globals_size;
 
-        this->main_assembly << "\tlea rdi, [rsp]\n";
-
-        const bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
+        this->main_assembly << "\tlea rdi, [rel " << generator::globals_end_label << " - " << offset << "]\n";
 
         this->main_assembly << "\tlea rsi, [rel " << (*this->constants)[command->file_name] << "]";
         if (this->debug) this->main_assembly << " ; " << command->file_name;
-        this->main_assembly << "\n"
-                            << "\tcall _read_image\n";
+        this->main_assembly << "\n" << this->generate_aligned_call("_read_image");
+
+        //  Images are read interleaved; convert a copy of the header's array, and keep its new data pointer.
+        const std::shared_ptr<resolved_type::resolved_type> float_type
+                = std::make_shared<resolved_type::resolved_type>(resolved_type::FLOAT_TYPE);
+        const std::shared_ptr<resolved_type::resolved_type> image_type
+                = std::make_shared<resolved_type::array_resolved_type>(
+                        std::make_shared<resolved_type::tuple_resolved_type>(
+                                std::vector<std::shared_ptr<resolved_type::resolved_type>>(4, float_type)),
+                        2);
+        if (this->is_planar(image_type)) {
+            this->main_assembly << "\tsub rsp, " << image_size << "\n";
+            this->stack.push(image_size);
+            for (long field = 0; field < (long)image_size; field += 8) {
+                this->main_assembly << "\tmov rax, [rel " << generator::globals_end_label << " - " << offset - field
+                                    << "]\n"
+                                    << "\tmov [rsp + " << field << "], rax\n";
+            }
 
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
+            this->main_assembly << this->generate_layout_conversion(image_type, 0, true) << "\tmov rax, [rsp + 16]\n"
+                                << "\tmov [rel " << generator::globals_end_label << " - " << offset - 16 << "], rax\n"
+                                << "\tadd rsp, " << image_size << "\n";
             this->stack.pop();
         }
 
-        const std::shared_ptr<resolved_type::resolved_type> float_type = std::make_shared<resolved_type::resolved_type>(
-                resolved_type::FLOAT_TYPE);
-        const std::shared_ptr<resolved_type::tuple_resolved_type> pixel_type
-                = std::make_shared<resolved_type::tuple_resolved_type>(
-                        std::vector<std::shared_ptr<resolved_type::resolved_type>> {float_type, float_type, float_type,
-                                                                                    float_type});
-        const std::shared_ptr<resolved_type::array_resolved_type> array_r_type
-                = std::make_shared<resolved_type::array_resolved_type>(pixel_type, 2);
-
-        this->stack.pop();
-        this->bind_argument(command->read_dest, array_r_type);
+        this->bind_global_argument(command->read_dest, offset);
 
         if (this->debug) this->main_assembly << "\t;  END generate_cmd_read\n";
     }
@@ -2192,19 +5612,8 @@ namespace generator {
     void main_generator::generate_cmd_show(const std::shared_ptr<ast_node::show_cmd_node>& command) {
         if (this->debug) this->main_assembly << "\t;  START generate_cmd_show\n";
 
-        //  We need to know the size of the expression on the stack in order to align the stack,
-        //  so we push it onto the stack and then pop it again before generating the expression.
-        this->stack.push(command->expr->r_type->size());
-        const bool needs_alignment = this->stack.needs_alignment();
-        this->stack.pop();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-
-        this->main_assembly << this->generate_expr(command->expr) << "\tlea rdi, [rel "
+        this->main_assembly << this->generate_expr(command->expr)
+                            << this->generate_layout_conversion(command->expr->r_type, 0, false) << "\tlea rdi, [rel "
                             << (*this->constants)[command->expr->r_type->s_expression()] << "]";
         if (this->debug) {
             this->main_assembly << " ; ";
@@ -2213,38 +5622,16 @@ namespace generator {
         this->main_assembly << "\n";
 
         this->main_assembly << "\tlea rsi, [rsp]\n"
-                            << "\tcall _show\n"
+                            << this->generate_aligned_call("_show")
                             << "\tadd rsp, " << this->stack.pop() << "\n";
 
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
-
         if (this->debug) this->main_assembly << "\t;  END generate_cmd_show\n";
     }
 
     void main_generator::generate_cmd_time(const std::shared_ptr<ast_node::time_cmd_node>& command) {
         if (this->debug) this->main_assembly << "\t;  START generate_cmd_time\n";
 
-        bool needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-
-        this->main_assembly << "\tcall _get_time\n";
-
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        this->main_assembly << this->generate_aligned_call("_get_time");
 
         this->main_assembly << "\tsub rsp, 8\n"
                             << "\tmovsd [rsp], xmm0\n";
@@ -2253,22 +5640,7 @@ namespace generator {
 
         this->generate_cmd(command->command);
 
-        needs_alignment = this->stack.needs_alignment();
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-
-        this->main_assembly << "\tcall _get_time\n";
-
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        this->main_assembly << this->generate_aligned_call("_get_time");
 
         this->main_assembly << "\tsub rsp, 8\n"
                             << "\tmovsd [rsp], xmm0\n";
@@ -2281,20 +5653,7 @@ namespace generator {
         this->main_assembly << "\tmovsd xmm1, [rsp + " << this->stack.size() - time_offset_start << "]\n"
                             << "\tsubsd xmm0, xmm1\n";
 
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
-            if (this->debug) this->main_assembly << " ; Align stack";
-            this->main_assembly << "\n";
-            this->stack.push();
-        }
-        this->main_assembly << "\tcall _print_time\n";
-
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        this->main_assembly << this->generate_aligned_call("_print_time");
 
         if (this->debug) this->main_assembly << "\t;  END generate_cmd_time\n";
     }
@@ -2308,32 +5667,609 @@ namespace generator {
     void main_generator::generate_cmd_write(const std::shared_ptr<ast_node::write_cmd_node>& command) {
         if (this->debug) this->main_assembly << "\t;  START generate_cmd_write\n";
 
-        this->stack.push(command->expr->r_type->size());
-        const bool needs_alignment = this->stack.needs_alignment();
-        this->stack.pop();
-
-        if (needs_alignment) {
-            this->main_assembly << "\tsub rsp, 8";
+        //  The image is passed on the stack, so the padding goes below it.
+        const unsigned int padding = this->stack.alignment_padding(command->expr->r_type->size());
+        if (padding > 0) {
+            this->main_assembly << "\tsub rsp, " << padding;
             if (this->debug) this->main_assembly << " ; Align stack";
             this->main_assembly << "\n";
-            this->stack.push();
+            this->stack.push(padding);
         }
 
-        this->main_assembly << this->generate_expr(command->expr) << "\tlea rdi, [rel "
+        this->main_assembly << this->generate_expr(command->expr)
+                            << this->generate_layout_conversion(command->expr->r_type, 0, false) << "\tlea rdi, [rel "
                             << (*this->constants)[command->file_name] << "]\n"
-                            << "\tcall _write_image\n"
-                            << "\tadd rsp, " << this->stack.pop() << "\n";
+                            << "\tcall _write_image\n";
 
-        if (needs_alignment) {
-            this->main_assembly << "\tadd rsp, 8";
-            if (this->debug) this->main_assembly << " ; Remove alignment";
-            this->main_assembly << "\n";
-            this->stack.pop();
-        }
+        long dropped_bytes = this->stack.pop();
+        if (padding > 0) dropped_bytes += this->stack.pop();
+        this->main_assembly << "\tadd rsp, " << dropped_bytes;
+        if (this->debug && padding > 0) this->main_assembly << " ; Drop the image and alignment";
+        this->main_assembly << "\n";
 
         if (this->debug) this->main_assembly << "\t;  END generate_cmd_write\n";
     }
 
+    void main_generator::bind_global_lvalue(const std::shared_ptr<ast_node::lvalue_node>& lvalue,
+                                            const std::shared_ptr<resolved_type::resolved_type>& r_type,
+                                            long offset) {
+        if (lvalue->type == ast_node::ARGUMENT_LVALUE) {
+            this->bind_global_argument(std::reinterpret_pointer_cast<ast_node::argument_lvalue_node>(lvalue)->argument,
+                                       offset);
+        } else {
+            const std::shared_ptr<ast_node::tuple_lvalue_node> tuple_lvalue
+                    = std::reinterpret_pointer_cast<ast_node::tuple_lvalue_node>(lvalue);
+            const std::shared_ptr<resolved_type::tuple_resolved_type> tuple_r_type
+                    = std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(r_type);
+
+            for (unsigned int index = 0; index < tuple_lvalue->lvalues.size(); ++index) {
+                this->bind_global_lvalue(tuple_lvalue->lvalues[index], tuple_r_type->element_types[index],
+                                         offset - (long)tuple_r_type->offset(index));
+            }
+        }
+    }
+
+    void main_generator::bind_global_argument(const std::shared_ptr<ast_node::argument_node>& argument, long offset) {
+        if (argument->type == ast_node::ARRAY_ARGUMENT) {
+            const std::shared_ptr<ast_node::array_argument_node> array_argument
+                    = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
+
+            this->variables.set_global_address(array_argument->name, offset);
+
+            long dimension_offset = offset;
+            constexpr int reg_size = 8;
+            for (const token::token& size_argument : array_argument->dimension_vars) {
+                this->variables.set_global_address(size_argument.text, dimension_offset);
+                dimension_offset -= reg_size;
+            }
+        } else {
+            this->variables.set_global_address(
+                    std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name, offset);
+        }
+    }
+
+    void main_generator::find_pipeline_stages() {
+        if (this->opt_level < 2) return;
+
+        //  The functions whose body only returns an array loop, by name.
+        std::unordered_map<std::string, std::shared_ptr<ast_node::fn_cmd_node>> loop_functions;
+
+        //  The top-level arrays bound to array loops, by name, with the index of their command.
+        std::vector<std::pair<std::string, unsigned long>> candidates;
+        for (unsigned long index = 0; index < this->nodes.size(); ++index) {
+            const std::shared_ptr<ast_node::ast_node>& node = this->nodes[index];
+            std::shared_ptr<ast_node::argument_node> argument;
+            if (node->type == ast_node::FN_CMD) {
+                const std::shared_ptr<ast_node::fn_cmd_node> function
+                        = std::reinterpret_pointer_cast<ast_node::fn_cmd_node>(node);
+                bool is_loop_function = function->statements.size() == 1
+                                     && function->statements[0]->type == ast_node::RETURN_STMT
+                                     && std::reinterpret_pointer_cast<ast_node::return_stmt_node>(
+                                                function->statements[0])
+                                                        ->return_val->type
+                                                == ast_node::ARRAY_LOOP_EXPR;
+                for (const std::shared_ptr<ast_node::binding_node>& binding : function->bindings) {
+                    is_loop_function &= binding->type == ast_node::VAR_BINDING;
+                }
+                if (is_loop_function) loop_functions[function->name] = function;
+            } else if (node->type == ast_node::READ_CMD) {
+                argument = std::reinterpret_pointer_cast<ast_node::read_cmd_node>(node)->read_dest;
+            } else if (node->type == ast_node::LET_CMD) {
+                const std::shared_ptr<ast_node::let_cmd_node> let_cmd
+                        = std::reinterpret_pointer_cast<ast_node::let_cmd_node>(node);
+                if (let_cmd->lvalue->type != ast_node::ARGUMENT_LVALUE) continue;
+                argument = std::reinterpret_pointer_cast<ast_node::argument_lvalue_node>(let_cmd->lvalue)->argument;
+
+                if (let_cmd->expr->type == ast_node::ARRAY_LOOP_EXPR) {
+                    const std::string name
+                            = (argument->type == ast_node::ARRAY_ARGUMENT)
+                                    ? std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument)->name
+                                    : std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name;
+                    this->array_loops[name] = std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(
+                            let_cmd->expr);
+                    candidates.emplace_back(name, index);
+                } else if (let_cmd->expr->type == ast_node::CALL_EXPR) {
+                    //  A call is a candidate when its function only returns a loop, and each argument is a variable
+                    //  or a constant that can be bound in its place.
+                    const std::shared_ptr<ast_node::call_expr_node> call
+                            = std::reinterpret_pointer_cast<ast_node::call_expr_node>(let_cmd->expr);
+                    const auto function = loop_functions.find(call->name);
+                    bool is_candidate = function != loop_functions.end();
+                    for (const std::shared_ptr<ast_node::expr_node>& arg : call->call_args) {
+                        long value = 0;
+                        is_candidate &= arg->type == ast_node::VARIABLE_EXPR || this->constant_int_value(arg, value);
+                    }
+                    if (is_candidate) {
+                        const std::string name
+                                = (argument->type == ast_node::ARRAY_ARGUMENT)
+                                        ? std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument)->name
+                                        : std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)
+                                                  ->name;
+                        this->array_loops[name] = std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(
+                                std::reinterpret_pointer_cast<ast_node::return_stmt_node>(
+                                        function->second->statements[0])
+                                        ->return_val);
+                        this->stage_calls[name] = {call, function->second};
+                        if (argument->type != ast_node::ARRAY_ARGUMENT) {
+                            this->array_dimensions[name] = this->call_stage_dimensions(name);
+                        }
+                        candidates.emplace_back(name, index);
+                    }
+                }
+            }
+
+            if (argument == nullptr || argument->type != ast_node::ARRAY_ARGUMENT) continue;
+            const std::shared_ptr<ast_node::array_argument_node> array_argument
+                    = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
+            for (const token::token& dimension : array_argument->dimension_vars) {
+                this->array_dimensions[array_argument->name].push_back(dimension.text);
+            }
+        }
+
+        for (const std::pair<std::string, unsigned long>& candidate : candidates) {
+            const std::string& name = candidate.first;
+            const std::shared_ptr<ast_node::array_loop_expr_node> loop = this->array_loops.at(name);
+            if (loop->is_tc) continue;
+
+            //  The body of a call stage is checked in its function's scope, where the parameters hide any top-level
+            //  names they share.
+            const auto stage_call = this->stage_calls.find(name);
+            const std::unordered_map<std::string, std::vector<std::string>> saved_dimensions = this->array_dimensions;
+            const std::unordered_map<std::string, std::shared_ptr<ast_node::array_loop_expr_node>> saved_loops
+                    = this->array_loops;
+            if (stage_call != this->stage_calls.end()) {
+                for (const std::shared_ptr<ast_node::binding_node>& binding : stage_call->second.second->bindings) {
+                    const std::shared_ptr<ast_node::argument_node> parameter
+                            = std::reinterpret_pointer_cast<ast_node::var_binding_node>(binding)->binding_arg;
+                    if (parameter->type != ast_node::ARRAY_ARGUMENT) {
+                        const std::string& parameter_name
+                                = std::reinterpret_pointer_cast<ast_node::variable_argument_node>(parameter)->name;
+                        this->array_dimensions.erase(parameter_name);
+                        this->array_loops.erase(parameter_name);
+                        continue;
+                    }
+
+                    const std::shared_ptr<ast_node::array_argument_node> array_parameter
+                            = std::reinterpret_pointer_cast<ast_node::array_argument_node>(parameter);
+                    this->array_dimensions[array_parameter->name].clear();
+                    for (const token::token& dimension : array_parameter->dimension_vars) {
+                        this->array_dimensions[array_parameter->name].push_back(dimension.text);
+                    }
+                    this->array_loops.erase(array_parameter->name);
+                }
+            }
+            const bool cannot_fail = this->stage_cannot_fail(loop->item_expr, loop);
+            this->array_dimensions = saved_dimensions;
+            this->array_loops = saved_loops;
+            if (!cannot_fail) continue;
+
+            std::vector<stage_use> uses;
+            bool is_fusable = true;
+            for (unsigned long index = candidate.second + 1; index < this->nodes.size() && is_fusable; ++index) {
+                is_fusable = this->stage_uses(std::reinterpret_pointer_cast<ast_node::cmd_node>(this->nodes[index]),
+                                              name, uses);
+            }
+
+            //  Each element is computed at most once: read whole once, or one distinct field per read.
+            std::unordered_set<long> fields;
+            for (const stage_use& use : uses) {
+                is_fusable &= (use.field >= 0 || uses.size() == 1) && fields.insert(use.field).second;
+            }
+            if (!is_fusable) continue;
+
+            this->pipeline_stages[name] = loop;
+            for (const stage_use& use : uses) {
+                if (this->stage_index_in_bounds(use.array_index, use.loop)) {
+                    this->unchecked_stage_reads.insert(use.array_index.get());
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> main_generator::call_stage_dimensions(const std::string& name) const {
+        const std::shared_ptr<ast_node::call_expr_node>& call = this->stage_calls.at(name).first;
+        const std::shared_ptr<ast_node::fn_cmd_node>& function = this->stage_calls.at(name).second;
+
+        std::vector<std::string> dimensions;
+        for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair :
+             this->array_loops.at(name)->binding_pairs) {
+            const std::shared_ptr<ast_node::expr_node>& bound = std::get<1>(pair);
+
+            //  An unknown dimension is left empty, which names no variable.
+            std::string dimension;
+            for (unsigned long index = 0; index < call->call_args.size() && bound->type == ast_node::VARIABLE_EXPR;
+                 ++index) {
+                const std::shared_ptr<ast_node::expr_node>& arg = call->call_args[index];
+                if (arg->type != ast_node::VARIABLE_EXPR) continue;
+
+                const std::string& bound_name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(bound)->name;
+                const std::string& arg_name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(arg)->name;
+                const std::shared_ptr<ast_node::argument_node> parameter
+                        = std::reinterpret_pointer_cast<ast_node::var_binding_node>(function->bindings[index])
+                                  ->binding_arg;
+                if (parameter->type != ast_node::ARRAY_ARGUMENT) {
+                    if (std::reinterpret_pointer_cast<ast_node::variable_argument_node>(parameter)->name == bound_name)
+                        dimension = arg_name;
+                    continue;
+                }
+
+                //  A dimension variable of an array parameter is the matching dimension variable of the argument.
+                const std::vector<token::token>& dimension_vars
+                        = std::reinterpret_pointer_cast<ast_node::array_argument_node>(parameter)->dimension_vars;
+                const auto arg_dimensions = this->array_dimensions.find(arg_name);
+                for (unsigned long dim = 0; dim < dimension_vars.size(); ++dim) {
+                    if (dimension_vars[dim].text == bound_name && arg_dimensions != this->array_dimensions.end()
+                        && dim < arg_dimensions->second.size())
+                        dimension = arg_dimensions->second[dim];
+                }
+            }
+            dimensions.push_back(dimension);
+        }
+        return dimensions;
+    }
+
+    bool main_generator::stage_cannot_fail(const std::shared_ptr<ast_node::expr_node>& expression,
+                                           const std::shared_ptr<ast_node::array_loop_expr_node>& loop) const {
+        switch (expression->type) {
+            case ast_node::ARRAY_INDEX_EXPR:
+                return this->stage_index_in_bounds(
+                        std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression), loop);
+            case ast_node::BINOP_EXPR: {
+                const std::shared_ptr<ast_node::binop_expr_node> binop
+                        = std::reinterpret_pointer_cast<ast_node::binop_expr_node>(expression);
+                const bool is_division = binop->operator_type == ast_node::BINOP_DIVIDE
+                                      || binop->operator_type == ast_node::BINOP_MOD;
+                long divisor = 0;
+                if (is_division && binop->left_operand->r_type->type == resolved_type::INT_TYPE
+                    && (!this->constant_int_value(binop->right_operand, divisor) || divisor == 0))
+                    return false;
+
+                return this->stage_cannot_fail(binop->left_operand, loop)
+                    && this->stage_cannot_fail(binop->right_operand, loop);
+            }
+            case ast_node::CALL_EXPR: {
+                //  Only the built-in functions are known not to fail.
+                const std::shared_ptr<ast_node::call_expr_node> call
+                        = std::reinterpret_pointer_cast<ast_node::call_expr_node>(expression);
+                const std::unordered_set<std::string> builtins
+                        = {"sqrt", "exp", "sin", "cos", "tan", "asin", "acos", "atan", "log", "pow", "atan2",
+                           "to_float", "to_int"};
+                if (builtins.count(call->name) == 0) return false;
+
+                for (const std::shared_ptr<ast_node::expr_node>& argument : call->call_args) {
+                    if (!this->stage_cannot_fail(argument, loop)) return false;
+                }
+                return true;
+            }
+            case ast_node::IF_EXPR: {
+                const std::shared_ptr<ast_node::if_expr_node> if_expr
+                        = std::reinterpret_pointer_cast<ast_node::if_expr_node>(expression);
+                return this->stage_cannot_fail(if_expr->conditional_expr, loop)
+                    && this->stage_cannot_fail(if_expr->affirmative_expr, loop)
+                    && this->stage_cannot_fail(if_expr->negative_expr, loop);
+            }
+            case ast_node::TUPLE_INDEX_EXPR:
+                return this->stage_cannot_fail(
+                        std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression)->expr, loop);
+            case ast_node::TUPLE_LITERAL_EXPR:
+                for (const std::shared_ptr<ast_node::expr_node>& element :
+                     std::reinterpret_pointer_cast<ast_node::tuple_literal_expr_node>(expression)->exprs) {
+                    if (!this->stage_cannot_fail(element, loop)) return false;
+                }
+                return true;
+            case ast_node::UNOP_EXPR:
+                return this->stage_cannot_fail(
+                        std::reinterpret_pointer_cast<ast_node::unop_expr_node>(expression)->operand, loop);
+            case ast_node::VARIABLE_EXPR:
+                return true;
+            default:
+                return generator::speculation_cost(expression) >= 0;
+        }
+    }
+
+    bool main_generator::stage_index_in_bounds(const std::shared_ptr<ast_node::array_index_expr_node>& array_index,
+                                               const std::shared_ptr<ast_node::array_loop_expr_node>& loop) const {
+        if (array_index->array->type != ast_node::VARIABLE_EXPR
+            || array_index->params.size() != loop->binding_pairs.size())
+            return false;
+
+        const std::string& name = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(array_index->array)->name;
+        const std::vector<ast_node::cp_value>& dims = array_index->array->cp_val.array_value;
+        const auto dimensions = this->array_dimensions.find(name);
+        const auto array_loop = this->array_loops.find(name);
+
+        for (unsigned long dim = 0; dim < array_index->params.size(); ++dim) {
+            const std::shared_ptr<ast_node::expr_node>& param = array_index->params[dim];
+            if (param->type != ast_node::VARIABLE_EXPR
+                || std::reinterpret_pointer_cast<ast_node::variable_expr_node>(param)->name
+                           != std::get<0>(loop->binding_pairs[dim]).text)
+                return false;
+
+            const std::shared_ptr<ast_node::expr_node>& bound = std::get<1>(loop->binding_pairs[dim]);
+            long bound_value = 0;
+            const bool is_known = dims.size() > dim && dims[dim].type == ast_node::INT_VALUE
+                               && this->constant_int_value(bound, bound_value) && bound_value <= dims[dim].int_value;
+            const bool is_dimension
+                    = bound->type == ast_node::VARIABLE_EXPR && dimensions != this->array_dimensions.end()
+                   && std::reinterpret_pointer_cast<ast_node::variable_expr_node>(bound)->name
+                              == dimensions->second[dim];
+            const bool is_same_bound
+                    = array_loop != this->array_loops.end() && this->stage_calls.count(name) == 0
+                   && generator::same_expression(bound, std::get<1>(array_loop->second->binding_pairs[dim]));
+            if (!is_known && !is_dimension && !is_same_bound) return false;
+        }
+        return true;
+    }
+
+    void main_generator::find_interleaved_arrays(const std::shared_ptr<ast_node::cmd_node>& command) {
+        switch (command->type) {
+            case ast_node::ASSERT_CMD:
+                this->find_interleaved_arrays(
+                        std::reinterpret_pointer_cast<ast_node::assert_cmd_node>(command)->condition);
+                break;
+            case ast_node::LET_CMD:
+                this->find_interleaved_arrays(std::reinterpret_pointer_cast<ast_node::let_cmd_node>(command)->expr);
+                break;
+            case ast_node::SHOW_CMD:
+                this->find_interleaved_arrays(std::reinterpret_pointer_cast<ast_node::show_cmd_node>(command)->expr);
+                break;
+            case ast_node::WRITE_CMD:
+                this->find_interleaved_arrays(std::reinterpret_pointer_cast<ast_node::write_cmd_node>(command)->expr);
+                break;
+            case ast_node::TIME_CMD:
+                this->find_interleaved_arrays(
+                        std::reinterpret_pointer_cast<ast_node::time_cmd_node>(command)->command);
+                break;
+            case ast_node::FN_CMD:
+                for (const std::shared_ptr<ast_node::stmt_node>& statement :
+                     std::reinterpret_pointer_cast<ast_node::fn_cmd_node>(command)->statements) {
+                    switch (statement->type) {
+                        case ast_node::ASSERT_STMT:
+                            this->find_interleaved_arrays(
+                                    std::reinterpret_pointer_cast<ast_node::assert_stmt_node>(statement)->expr);
+                            break;
+                        case ast_node::LET_STMT:
+                            this->find_interleaved_arrays(
+                                    std::reinterpret_pointer_cast<ast_node::let_stmt_node>(statement)->expr);
+                            break;
+                        default:
+                            this->find_interleaved_arrays(
+                                    std::reinterpret_pointer_cast<ast_node::return_stmt_node>(statement)
+                                            ->return_val);
+                            break;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void main_generator::find_interleaved_arrays(const std::shared_ptr<ast_node::expr_node>& expression) {
+        //  Every array type reachable from the element type, through tuples and arrays, is nested in an array.
+        const std::function<void(const std::shared_ptr<resolved_type::resolved_type>&)> mark_nested
+                = [&](const std::shared_ptr<resolved_type::resolved_type>& type) {
+                      if (type->type == resolved_type::ARRAY_TYPE) {
+                          this->shared_state->interleaved_arrays.insert(type->s_expression());
+                          mark_nested(std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(type)
+                                              ->element_type);
+                      } else if (type->type == resolved_type::TUPLE_TYPE) {
+                          for (const std::shared_ptr<resolved_type::resolved_type>& field :
+                               std::reinterpret_pointer_cast<resolved_type::tuple_resolved_type>(type)
+                                       ->element_types) {
+                              mark_nested(field);
+                          }
+                      }
+                  };
+        if (expression->r_type != nullptr && expression->r_type->type == resolved_type::ARRAY_TYPE) {
+            mark_nested(std::reinterpret_pointer_cast<resolved_type::array_resolved_type>(expression->r_type)
+                                ->element_type);
+        }
+
+        for (const std::shared_ptr<ast_node::expr_node>& child : generator::subexpressions(expression)) {
+            this->find_interleaved_arrays(child);
+        }
+    }
+
+    bool main_generator::stage_uses(const std::shared_ptr<ast_node::cmd_node>& command, const std::string& name,
+                                    std::vector<stage_use>& uses) const {
+        switch (command->type) {
+            case ast_node::ASSERT_CMD:
+                return this->stage_uses(std::reinterpret_pointer_cast<ast_node::assert_cmd_node>(command)->condition,
+                                        name, nullptr, 0, -1, uses);
+            case ast_node::LET_CMD:
+                return this->stage_uses(std::reinterpret_pointer_cast<ast_node::let_cmd_node>(command)->expr, name,
+                                        nullptr, 0, -1, uses);
+            case ast_node::SHOW_CMD:
+                return this->stage_uses(std::reinterpret_pointer_cast<ast_node::show_cmd_node>(command)->expr, name,
+                                        nullptr, 0, -1, uses);
+            case ast_node::WRITE_CMD:
+                return this->stage_uses(std::reinterpret_pointer_cast<ast_node::write_cmd_node>(command)->expr, name,
+                                        nullptr, 0, -1, uses);
+            case ast_node::TIME_CMD:
+                return this->stage_uses(std::reinterpret_pointer_cast<ast_node::time_cmd_node>(command)->command, name,
+                                        uses);
+            case ast_node::FN_CMD:
+                for (const std::shared_ptr<ast_node::stmt_node>& statement :
+                     std::reinterpret_pointer_cast<ast_node::fn_cmd_node>(command)->statements) {
+                    std::shared_ptr<ast_node::expr_node> expression;
+                    switch (statement->type) {
+                        case ast_node::ASSERT_STMT:
+                            expression = std::reinterpret_pointer_cast<ast_node::assert_stmt_node>(statement)->expr;
+                            break;
+                        case ast_node::LET_STMT:
+                            expression = std::reinterpret_pointer_cast<ast_node::let_stmt_node>(statement)->expr;
+                            break;
+                        default:
+                            expression = std::reinterpret_pointer_cast<ast_node::return_stmt_node>(statement)
+                                                 ->return_val;
+                            break;
+                    }
+
+                    std::vector<stage_use> function_uses;
+                    if (!this->stage_uses(expression, name, nullptr, 0, -1, function_uses) || !function_uses.empty())
+                        return false;
+                }
+                return true;
+            default:
+                return true;
+        }
+    }
+
+    bool main_generator::stage_uses(const std::shared_ptr<ast_node::expr_node>& expression, const std::string& name,
+                                    const std::shared_ptr<ast_node::array_loop_expr_node>& loop, long depth,
+                                    long field, std::vector<stage_use>& uses) const {
+        switch (expression->type) {
+            case ast_node::VARIABLE_EXPR:
+                return std::reinterpret_pointer_cast<ast_node::variable_expr_node>(expression)->name != name;
+            case ast_node::ARRAY_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::array_index_expr_node> array_index
+                        = std::reinterpret_pointer_cast<ast_node::array_index_expr_node>(expression);
+                const bool is_read = array_index->array->type == ast_node::VARIABLE_EXPR
+                                  && std::reinterpret_pointer_cast<ast_node::variable_expr_node>(array_index->array)
+                                                     ->name
+                                             == name;
+                if (!is_read) break;
+
+                //  A point-wise read is indexed by the variables of its loop, in order.
+                if (depth != 1 || loop == nullptr || loop->is_tc
+                    || array_index->params.size() != loop->binding_pairs.size())
+                    return false;
+                for (unsigned long dim = 0; dim < array_index->params.size(); ++dim) {
+                    const std::shared_ptr<ast_node::expr_node>& param = array_index->params[dim];
+                    if (param->type != ast_node::VARIABLE_EXPR
+                        || std::reinterpret_pointer_cast<ast_node::variable_expr_node>(param)->name
+                                   != std::get<0>(loop->binding_pairs[dim]).text)
+                        return false;
+                }
+                uses.push_back({array_index, loop, field});
+                return true;
+            }
+            case ast_node::TUPLE_INDEX_EXPR: {
+                const std::shared_ptr<ast_node::tuple_index_expr_node> tuple_index
+                        = std::reinterpret_pointer_cast<ast_node::tuple_index_expr_node>(expression);
+                const bool is_tuple_literal = this->array_loops.count(name) > 0
+                                           && this->array_loops.at(name)->item_expr->type
+                                                      == ast_node::TUPLE_LITERAL_EXPR;
+                return this->stage_uses(tuple_index->expr, name, loop, depth,
+                                        is_tuple_literal ? (long)tuple_index->index->value : -1, uses);
+            }
+            case ast_node::ARRAY_LOOP_EXPR: {
+                const std::shared_ptr<ast_node::array_loop_expr_node> array_loop
+                        = std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(expression);
+                for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair :
+                     array_loop->binding_pairs) {
+                    if (!this->stage_uses(std::get<1>(pair), name, loop, depth, -1, uses)) return false;
+                }
+                return this->stage_uses(array_loop->item_expr, name, array_loop, depth + 1, -1, uses);
+            }
+            case ast_node::SUM_LOOP_EXPR: {
+                const std::shared_ptr<ast_node::sum_loop_expr_node> sum_loop
+                        = std::reinterpret_pointer_cast<ast_node::sum_loop_expr_node>(expression);
+                for (const std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>& pair :
+                     sum_loop->binding_pairs) {
+                    if (!this->stage_uses(std::get<1>(pair), name, loop, depth, -1, uses)) return false;
+                }
+                return this->stage_uses(sum_loop->sum_expr, name, nullptr, depth + 1, -1, uses);
+            }
+            default:
+                break;
+        }
+
+        for (const std::shared_ptr<ast_node::expr_node>& child : generator::subexpressions(expression)) {
+            if (!this->stage_uses(child, name, loop, depth, -1, uses)) return false;
+        }
+        return true;
+    }
+
+    void main_generator::generate_memo_stats() {
+        constexpr unsigned long max_digits = 20;
+
+        if (this->debug) this->main_assembly << "\t;  START generate_memo_stats\n";
+
+        std::vector<std::string> names(this->flags.memoize.begin(), this->flags.memoize.end());
+        std::sort(names.begin(), names.end());
+
+        const std::string hits_text = (*this->constants)[std::string(" hits, ")];
+        const std::string misses_text = (*this->constants)[std::string(" misses\\n")];
+        unsigned long line_size = 0;
+        for (const std::string& name : names) {
+            const std::string prefix = "memoized " + name + ": ";
+            line_size = std::max(line_size, prefix.size() + 2 * max_digits + std::string(" hits,  misses\n").size());
+
+            this->main_assembly << "\tlea rdi, [rel " << (*this->constants)[prefix] << "]";
+            if (this->debug) this->main_assembly << " ; " << prefix;
+            this->main_assembly << "\n"
+                                << "\tmov rsi, [rel jpl_memo_" << name << "_hits]\n"
+                                << "\tmov rdx, [rel jpl_memo_" << name << "_misses]\n"
+                                << this->generate_aligned_call("jpl_memo.report");
+        }
+
+        this->function_bss_assembly << "jpl_memo.line: resb " << line_size << "\n";
+
+        //  Copies the prefix and each count into `jpl_memo.line` at r8, then writes the line to standard error.
+        std::stringstream report;
+        report << "jpl_memo.report:\n"
+               << "\tmov r9, rdx\n"
+               << "\tlea r8, [rel jpl_memo.line]\n"
+               << "\tcall .copy\n"
+               << "\tmov rax, rsi\n"
+               << "\tcall .number\n"
+               << "\tlea rdi, [rel " << hits_text << "]\n"
+               << "\tcall .copy\n"
+               << "\tmov rax, r9\n"
+               << "\tcall .number\n"
+               << "\tlea rdi, [rel " << misses_text << "]\n"
+               << "\tcall .copy\n"
+               << "\tmov eax, 1";
+        if (this->debug) report << " ; write";
+        report << "\n"
+               << "\tmov edi, 2";
+        if (this->debug) report << " ; Standard error";
+        report << "\n"
+               << "\tlea rsi, [rel jpl_memo.line]\n"
+               << "\tmov rdx, r8\n"
+               << "\tsub rdx, rsi\n"
+               << "\tsyscall\n"
+               << "\tret\n";
+
+        //  Copies the string at rdi, without its terminator.
+        report << ".copy:\n"
+               << "\tmov al, [rdi]\n"
+               << "\ttest al, al\n"
+               << "\tjz .copied\n"
+               << "\tmov [r8], al\n"
+               << "\tinc rdi\n"
+               << "\tinc r8\n"
+               << "\tjmp .copy\n"
+               << ".copied:\n"
+               << "\tret\n";
+
+        //  Writes rax in decimal; the digits come out last first, so they are reversed on the stack.
+        report << ".number:\n"
+               << "\tmov rcx, rsp\n"
+               << "\tmov r10, 10\n"
+               << ".digit:\n"
+               << "\txor edx, edx\n"
+               << "\tdiv r10\n"
+               << "\tadd dl, 48\n"
+               << "\tdec rsp\n"
+               << "\tmov [rsp], dl\n"
+               << "\ttest rax, rax\n"
+               << "\tjnz .digit\n"
+               << ".reverse:\n"
+               << "\tmov dl, [rsp]\n"
+               << "\tmov [r8], dl\n"
+               << "\tinc rsp\n"
+               << "\tinc r8\n"
+               << "\tcmp rsp, rcx\n"
+               << "\tjne .reverse\n"
+               << "\tret\n";
+        this->function_assemblies.emplace_back(report.str());
+
+        if (this->debug) this->main_assembly << "\t;  END generate_memo_stats\n";
+    }
+
     void main_generator::generate_linking_preface() {
         this->linking_preface_assembly << "global jpl_main\n"
                                        << "global _jpl_main\n"
@@ -2363,39 +6299,56 @@ namespace generator {
     }
 
     void main_generator::generate_commands() {
-        constexpr unsigned int reg_size = 8;
-
         this->main_assembly << "jpl_main:\n"
                             << "_jpl_main:\n"
                             << "\tpush rbp\n"
-                            << "\tmov rbp, rsp\n"
-                            << "\tpush r12\n";
-        this->stack.push();
-        this->main_assembly << "\tmov r12, rbp\n";
+                            << "\tmov rbp, rsp\n";
+
+        //  Only functions defined in the program can be memoized.
+        std::unordered_set<std::string> defined_functions;
+        for (const std::shared_ptr<ast_node::ast_node>& node : this->nodes) {
+            if (node->type != ast_node::FN_CMD) continue;
+            defined_functions.insert(std::reinterpret_pointer_cast<ast_node::fn_cmd_node>(node)->name);
+        }
+        for (const std::string& name : this->flags.memoize) {
+            if (defined_functions.count(name) == 0) {
+                throw std::runtime_error("`generate_commands`: cannot memoize \"" + name
+                                         + "\": no function of that name is defined in the program");
+            }
+        }
+
+        if (this->flags.planar_tuples) {
+            for (const std::shared_ptr<ast_node::ast_node>& node : this->nodes) {
+                this->find_interleaved_arrays(std::reinterpret_pointer_cast<ast_node::cmd_node>(node));
+            }
+        }
+
+        this->find_pipeline_stages();
 
         for (const std::shared_ptr<ast_node::ast_node>& node : this->nodes) {
             this->generate_cmd(std::reinterpret_pointer_cast<ast_node::cmd_node>(node));
         }
 
-        if (this->stack.size() > reg_size) {
-            this->main_assembly << "\tadd rsp, " << this->stack.size() - reg_size;
+        if (this->flags.memo_stats && !this->flags.memoize.empty()) this->generate_memo_stats();
+
+        if (this->stack.size() > 0) {
+            this->main_assembly << "\tadd rsp, " << this->stack.size();
             if (this->debug) this->main_assembly << " ; Remove local variables";
             this->main_assembly << "\n";
         }
 
-        this->main_assembly << "\tpop r12\n";
-        this->stack.pop();
         this->main_assembly << "\tpop rbp\n"
                             << "\tret\n";
     }
 
     main_generator::main_generator(const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
                                    const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes, bool debug,
-                                   unsigned int opt_level)
+                                   unsigned int opt_level, const generator_flags& flags)
         : generator(global_symbol_table, std::make_shared<const_table>(),
-                    std::make_shared<std::unordered_map<std::string, call_signature::call_signature>>(), nullptr, debug,
-                    opt_level),
-          nodes(nodes) {
+                    std::make_shared<std::unordered_map<std::string, call_signature::call_signature>>(),
+                    std::make_shared<specialization_table>(), std::make_shared<shared_generator_state>(), nullptr,
+                    debug, opt_level, flags),
+          nodes(nodes), globals_size(0) {
         const std::shared_ptr<resolved_type::resolved_type> int_type = std::make_shared<resolved_type::resolved_type>(
                 resolved_type::INT_TYPE);
         const std::shared_ptr<resolved_type::resolved_type> float_type = std::make_shared<resolved_type::resolved_type>(
@@ -2425,10 +6378,21 @@ namespace generator {
         std::stringstream assembly;
 
         assembly << this->linking_preface_assembly.str() << "\n"
-                 << this->constants->assem() << "\n"
-                 << "section .text\n";
+                 << this->constants->assem() << "\n";
+
+        const std::string function_bss = this->function_bss_assembly.str();
+        if (this->globals_size > 0 || !function_bss.empty()) assembly << "section .bss\n";
+        if (this->globals_size > 0) {
+            assembly << "align 16\n"
+                     << "jpl_globals: resq " << this->globals_size / 8 << "\n"
+                     << generator::globals_end_label << ":\n";
+        }
+        if (this->globals_size > 0 || !function_bss.empty()) assembly << function_bss << "\n";
+
+        assembly << "section .text\n";
 
         for (const std::string& function_assem : this->function_assemblies) { assembly << function_assem << "\n"; }
+        for (const std::string& clone_assem : this->specializations->assemblies) { assembly << clone_assem << "\n"; }
 
         assembly << this->main_assembly.str() << "\n";
 
@@ -2441,7 +6405,7 @@ namespace generator {
 
     std::string generate(const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
                          const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes, bool debug,
-                         unsigned int opt_level) {
-        return main_generator(global_symbol_table, nodes, debug, opt_level).assem();
+                         unsigned int opt_level, const generator_flags& flags) {
+        return main_generator(global_symbol_table, nodes, debug, opt_level, flags).assem();
     }
 }  //  namespace generator
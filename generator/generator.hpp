@@ -9,10 +9,13 @@
 #ifndef GENERATOR_HPP
 #define GENERATOR_HPP
 
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -22,6 +25,66 @@
 #include "symbol_table/symbol_table.hpp"
 
 namespace generator {
+    /**
+     * @brief Fine-grained code generation options, as given on the command line.
+     *
+     */
+    struct generator_flags {
+        /**
+         * @brief The unroll factor for the innermost dimension of array and sum loops.
+         * @details 0 chooses a factor automatically at -O2 and above; 1 disables partial unrolling.
+         *
+         */
+        unsigned int unroll_factor = 0;
+
+        /**
+         * @brief Whether floating-point results may differ from strict IEEE evaluation.
+         * @details Allows reassociating sums (e.g. splitting them across several accumulators) and computing `%`
+         *     on floats inline as `x - trunc(x / y) * y`.
+         *
+         */
+        bool fast_math = false;
+
+        /**
+         * @brief The functions whose results are cached across calls, as given by `-fmemoize=<fn>`.
+         * @details Only functions defined in the program, with int, bool, and float arguments and result, may be
+         *     memoized; any other name fails the compilation.
+         *
+         */
+        std::unordered_set<std::string> memoize;
+
+        /**
+         * @brief Whether memoized functions count their cache hits and misses, as given by `-fmemo-stats`.
+         * @details The counts are kept in the global data symbols `jpl_memo_<fn>_hits` and `jpl_memo_<fn>_misses`,
+         *     and written to standard error when the program finishes.
+         *
+         */
+        bool memo_stats = false;
+
+        /**
+         * @brief Whether to report some optimizations on standard error as they fire, as given by `-fremarks`.
+         * @details Currently reported: loop interchange, tiling, and collapsing.
+         *
+         */
+        bool remarks = false;
+
+        /**
+         * @brief The cache budget in bytes for tiled array loops, as given by `-ftile-budget=<bytes>`.
+         * @details Sized for a typical 32 KiB L1 data cache; 0 disables tiling.
+         *
+         */
+        unsigned long tile_budget = 32768;
+
+        /**
+         * @brief Whether arrays of float tuples are stored as one plane per field, as given by `-fplanar-tuples`.
+         * @details Element `n` of such an array has its field `f` at `8 * (f * count + n)` bytes into the data,
+         *     where `count` is the number of elements. Images are converted to and from this layout when they are
+         *     read, written, or shown.
+         *
+         */
+        bool planar_tuples = false;
+    };
+
     /**
      * @brief The assembly generator.
      *
@@ -175,7 +238,7 @@ namespace generator {
         };
 
         /**
-         * @brief Tracks variables as an offset from register RBP.
+         * @brief Tracks variables as an offset from register RBP, or from the end of the `.bss` globals block.
          *
          */
         class variable_table {
@@ -192,6 +255,24 @@ namespace generator {
              */
             std::unordered_map<std::string, long> variables;
 
+            /**
+             * @brief A mapping from a variable name to its compile-time constant value.
+             *
+             */
+            std::unordered_map<std::string, long> constant_values;
+
+            /**
+             * @brief The variables whose constant value is an iteration of an unrolled loop.
+             *
+             */
+            std::unordered_set<std::string> loop_constants;
+
+            /**
+             * @brief A mapping from a top-level variable name to an offset from the end of the globals block.
+             *
+             */
+            std::unordered_map<std::string, long> global_variables;
+
         public:
             /**
              * @brief Class constructor.
@@ -202,14 +283,12 @@ namespace generator {
 
             /**
              * @brief Determines the address to use to access a local or global variable.
+             * @details Globals are addressed RIP-relative, as `[rel jpl_globals_end - offset]`.
              *
              * @param variable The variable to access.
-             * @param from_child True when a child instance is calling this instance,
-             *     for when determining whether to use register RBP or register R12. Defaults to false.
-             * @return The address to use to access the given variable, given in a pair of {register, offset}.
+             * @return The address to use to access the given variable, given in a pair of {base, offset}.
              */
-            [[nodiscard]] std::tuple<std::string, long> get_variable_address(const std::string& variable,
-                                                                             bool from_child = false) const;
+            [[nodiscard]] std::tuple<std::string, long> get_variable_address(const std::string& variable) const;
 
             /**
              * @brief Sets the address for the given variable.
@@ -218,6 +297,120 @@ namespace generator {
              * @param offset The offset from the base pointer where the value is.
              */
             void set_variable_address(const std::string& variable, long offset);
+
+            /**
+             * @brief Sets the address for the given top-level variable.
+             *
+             * @param variable The variable to set.
+             * @param offset The offset from the end of the globals block where the value is.
+             */
+            void set_global_address(const std::string& variable, long offset);
+
+            /**
+             * @brief Binds the given variable to a compile-time integer constant.
+             * @details Used when unrolling loops, where each copy of the body sees its loop variable as a literal.
+             *     The constant takes precedence over any address until it is cleared or the address is reset.
+             *
+             * @param variable The variable to set.
+             * @param value The constant value of the variable.
+             * @param loop_variable True when the variable is the variable of an unrolled loop, whose value changes
+             *     from one copy of the body to the next. Defaults to false.
+             */
+            void set_variable_constant(const std::string& variable, long value, bool loop_variable = false);
+
+            /**
+             * @brief Removes the compile-time constant bound to the given variable, if any.
+             *
+             * @param variable The variable to clear.
+             */
+            void clear_variable_constant(const std::string& variable);
+
+            /**
+             * @brief Looks up the compile-time constant bound to the given variable.
+             *
+             * @param variable The variable to look up.
+             * @param value Set to the constant value of the variable, if present.
+             * @return True when the variable is bound to a constant; false otherwise.
+             */
+            bool get_variable_constant(const std::string& variable, long& value) const;
+
+            /**
+             * @brief Determines whether the given variable is bound to the constant of an unrolled loop iteration.
+             *
+             * @param variable The variable to look up.
+             * @return True when the variable's constant was set as a loop variable; false otherwise.
+             */
+            [[nodiscard]] bool is_loop_constant(const std::string& variable) const;
+
+            /**
+             * @brief Restores the bindings of an earlier copy of this table.
+             * @details Used when variables are rebound temporarily, e.g. to compute a fused pipeline stage.
+             *
+             * @param saved The earlier copy.
+             */
+            void restore(const variable_table& saved);
+
+        };
+
+        /**
+         * @brief Tracks the functions of the program and their clones specialized on constant arguments.
+         * @details Each instance will point to the same main specialization table.
+         *
+         */
+        struct specialization_table {
+            /**
+             * @brief The `fn` node of each function, with the variable table visible to it.
+             *
+             */
+            std::unordered_map<std::string,
+                               std::pair<std::shared_ptr<ast_node::fn_cmd_node>, std::shared_ptr<variable_table>>>
+                    functions;
+
+            /**
+             * @brief The symbol of each clone, keyed by the function name and its constant arguments.
+             *
+             */
+            std::unordered_map<std::string, std::string> clones;
+
+            /**
+             * @brief The number of clones of each function.
+             *
+             */
+            std::unordered_map<std::string, long> num_clones;
+
+            /**
+             * @brief The functions whose bodies are being generated, innermost last.
+             * @details Recursive calls never make new clones, so that recursion cannot unfold into a chain of them.
+             *
+             */
+            std::vector<std::string> in_progress;
+
+            /**
+             * @brief The assembly for every clone.
+             *
+             */
+            std::vector<std::string> assemblies;
+        };
+
+        /**
+         * @brief State that every generator of the program shares, apart from the function clones.
+         * @details Each instance will point to the same main shared state.
+         *
+         */
+        struct shared_generator_state {
+            /**
+             * @brief The optimizations already reported by `-fremarks` for each loop.
+             * @details A loop is reported once, not once per clone or version.
+             *
+             */
+            std::unordered_map<const ast_node::expr_node*, std::unordered_set<std::string>> remarked;
+
+            /**
+             * @brief The array types kept interleaved under `-fplanar-tuples`, by s-expression.
+             * @details These appear as elements of other arrays, whose elements are not converted by `show` or `write`.
+             *
+             */
+            std::unordered_set<std::string> interleaved_arrays;
         };
 
         //  ===========================
@@ -243,6 +436,20 @@ namespace generator {
          */
         const std::shared_ptr<std::unordered_map<std::string, call_signature::call_signature>> function_signatures;
 
+        /**
+         * @brief The functions of the program and their specialized clones.
+         * @details Each instance will point to the same main specialization table.
+         *
+         */
+        const std::shared_ptr<specialization_table> specializations;
+
+        /**
+         * @brief The state shared by every generator of the program.
+         * @details Each instance will point to the same main shared state.
+         *
+         */
+        const std::shared_ptr<shared_generator_state> shared_state;
+
         /**
          * @brief The global symbol table.
          *
@@ -261,6 +468,182 @@ namespace generator {
          */
         const unsigned int opt_level;
 
+        /**
+         * @brief Fine-grained code generation options.
+         *
+         */
+        const generator_flags flags;
+
+        /**
+         * @brief The maximum speculation cost of both arms of an `if` expression for it to be lowered without a branch.
+         *
+         */
+        static constexpr long max_branchless_cost = 8;
+
+        /**
+         * @brief The label at the end of the `.bss` block that holds top-level bindings.
+         *
+         */
+        static constexpr const char* globals_end_label = "jpl_globals_end";
+
+        /**
+         * @brief The largest total trip count of an array or sum loop with constant bounds that is fully unrolled.
+         *
+         */
+        static constexpr long max_unroll_trip_count = 16;
+
+        /**
+         * @brief The unroll factor for the innermost loop dimension when it is chosen automatically.
+         *
+         */
+        static constexpr long default_unroll_factor = 4;
+
+        /**
+         * @brief The largest loop body (in AST nodes) that is partially unrolled automatically.
+         *
+         */
+        static constexpr long max_unroll_body_size = 32;
+
+        /**
+         * @brief The size given to nested loops by `expression_size`, which is larger than every size budget.
+         * @details Sizes are clamped to it, so that adding up the sizes of several nested loops cannot overflow.
+         *
+         */
+        static constexpr long nested_loop_size = 1L << 20;
+
+        /**
+         * @brief The largest number of clones of one function specialized on constant arguments.
+         *
+         */
+        static constexpr long max_specializations = 4;
+
+        /**
+         * @brief The largest total size of the copies of a loop body (in AST nodes) made by loop unswitching.
+         *
+         */
+        static constexpr long max_unswitch_size = 64;
+
+        /**
+         * @brief The largest number of iterations peeled from either end of a dimension by index-set splitting.
+         *
+         */
+        static constexpr long max_peel = 2;
+
+        /**
+         * @brief The largest total size of the copies of a loop body (in AST nodes) made by index-set splitting.
+         *
+         */
+        static constexpr long max_index_split_size = 512;
+
+        /**
+         * @brief The widest window of neighboring elements kept by stencil recognition.
+         *
+         */
+        static constexpr long max_window_width = 5;
+
+        /**
+         * @brief The largest number of windows kept for one array loop by stencil recognition.
+         *
+         */
+        static constexpr long max_stencil_windows = 4;
+
+        /**
+         * @brief A sliding window over one row of an array, read by an array loop at constant offsets from its
+         *     innermost loop variable.
+         * @details The window holds the elements at `offset` through `offset + width - 1` from the innermost loop
+         *     variable, each with a flag that is nonzero when that element is in bounds. Each iteration shifts the
+         *     window by one and loads one new element.
+         *
+         */
+        struct stencil_window {
+            /**
+             * @brief The array that the window reads.
+             *
+             */
+            std::shared_ptr<ast_node::expr_node> array;
+
+            /**
+             * @brief The indices of every dimension but the last, which are invariant in the innermost loop.
+             *
+             */
+            std::vector<std::shared_ptr<ast_node::expr_node>> row;
+
+            /**
+             * @brief The offset of the first element of the window from the innermost loop variable.
+             *
+             */
+            long offset;
+
+            /**
+             * @brief The number of elements in the window.
+             *
+             */
+            long width;
+
+            /**
+             * @brief The size of each element of the array, in bytes.
+             *
+             */
+            long element_size;
+
+            /**
+             * @brief The reads served by the window, each with its offset from the innermost loop variable.
+             *
+             */
+            std::vector<std::pair<std::shared_ptr<ast_node::array_index_expr_node>, long>> uses;
+
+            /**
+             * @brief The size of the stack just after the address of the row was allocated.
+             *
+             */
+            long row_position;
+
+            /**
+             * @brief The size of the stack just after the values of the window were allocated.
+             *
+             */
+            long values_position;
+
+            /**
+             * @brief The size of the stack just after the in-bounds flags of the window were allocated.
+             *
+             */
+            long flags_position;
+        };
+
+        /**
+         * @brief The largest number of terms in the closed form of an integer sum.
+         *
+         */
+        static constexpr long max_closed_form_terms = 16;
+
+        /**
+         * @brief One term of a coefficient in a loop polynomial: a constant times a product of loop-invariant
+         *     expressions.
+         *
+         */
+        struct invariant_term {
+            /**
+             * @brief The constant that the product of the factors is multiplied by.
+             *
+             */
+            long scale;
+
+            /**
+             * @brief The loop-invariant expressions multiplied together; empty for a constant term.
+             *
+             */
+            std::vector<std::shared_ptr<ast_node::expr_node>> factors;
+        };
+
+        /**
+         * @brief A polynomial in the variables of a sum loop.
+         * @details Maps the exponent of each loop variable in a monomial to the coefficient of that monomial, a sum
+         *     of `invariant_term`s.
+         *
+         */
+        typedef std::map<std::vector<long>, std::vector<invariant_term>> loop_polynomial;
+
         /**
          * @brief Information about the stack.
          *
@@ -273,6 +656,66 @@ namespace generator {
          */
         variable_table variables;
 
+        /**
+         * @brief The sum loops whose values were computed ahead of time by a fused loop.
+         * @details Maps each loop to the size of the stack just after its value was pushed.
+         *
+         */
+        std::unordered_map<const ast_node::sum_loop_expr_node*, long> fused_sums;
+
+        /**
+         * @brief The `if` expressions whose condition was tested once outside of a loop, and which arm to take.
+         *
+         */
+        std::unordered_map<const ast_node::if_expr_node*, bool> unswitched_ifs;
+
+        /**
+         * @brief The array indices read from a stencil window, and the stack positions of their value and flag.
+         *
+         */
+        std::unordered_map<const ast_node::array_index_expr_node*, std::pair<long, long>> window_uses;
+
+        /**
+         * @brief The top-level arrays that are never built, by name, with their loops.
+         *
+         */
+        std::unordered_map<std::string, std::shared_ptr<ast_node::array_loop_expr_node>> pipeline_stages;
+
+        /**
+         * @brief The reads of pipeline stages known to be in bounds.
+         *
+         */
+        std::unordered_set<const ast_node::array_index_expr_node*> unchecked_stage_reads;
+
+        /**
+         * @brief The top-level calls to functions whose body only returns an array loop, by the name they are bound
+         *     to, with the functions.
+         * @details When such a call is a pipeline stage, its stage is the function's loop, computed with the
+         *     function's parameters bound to the arguments of the call.
+         *
+         */
+        std::unordered_map<std::string, std::pair<std::shared_ptr<ast_node::call_expr_node>,
+                                                  std::shared_ptr<ast_node::fn_cmd_node>>>
+                stage_calls;
+
+        /**
+         * @brief The whole-array reads in collapsed array loops, and the stack positions of their linear indices.
+         *
+         */
+        std::unordered_map<const ast_node::array_index_expr_node*, long> linear_reads;
+
+        /**
+         * @brief Comparisons with a known value in the part of a loop being generated, as found by index-set splitting.
+         *
+         */
+        std::unordered_map<const ast_node::expr_node*, long> folded_comparisons;
+
+        /**
+         * @brief The number of copies of the current loop body made by loop unswitching.
+         *
+         */
+        long unswitch_copies = 1;
+
         //  ================
         //  ||  Methods:  ||
         //  ================
@@ -287,7 +730,200 @@ namespace generator {
          * @param value The value to be multiplied.
          * @return The assembly code for the multiplication.
          */
-        std::string generate_assem_mul(const std::string& reg, long value) const;
+        std::string generate_assem_mul(const std::string& reg, long value) const;
+
+        /**
+         * @brief Generates assembly for a signed integer division or modulo of RAX by a constant.
+         * @details Powers of two use shifts and masks; other divisors use a multiply-high by a magic number. -1 still
+         *     uses `idiv`, which traps on `LONG_MIN` as the unoptimized division does. The result is left in RAX.
+         *     Clobbers RDX, R10, and R11.
+         *
+         * @param divisor The divisor. Must not be 0.
+         * @param is_mod True to compute the remainder instead of the quotient.
+         * @return The assembly code for the division.
+         */
+        std::string generate_assem_div(long divisor, bool is_mod) const;
+
+        /**
+         * @brief Generates assembly that calls a runtime function, aligning the stack around the call.
+         * @details The arguments must already be in registers. The recorded stack is left unchanged. Calls that pass
+         *     arguments on the stack reserve `stack.alignment_padding` bytes below them instead.
+         *
+         * @param callee The symbol of the function to call.
+         * @return The assembly code for the call.
+         */
+        std::string generate_aligned_call(const std::string& callee) const;
+
+        /**
+         * @brief Generates assembly that calls `_fail_assertion` with the given message.
+         * @details `_fail_assertion` never returns, so the stack is aligned for the call but never restored, and the
+         *     recorded stack is left unchanged.
+         *
+         * @param message The message with which to fail.
+         * @return The assembly code for the failure.
+         */
+        std::string generate_fail_assertion(const std::string& message) const;
+
+        /**
+         * @brief Generates assembly that jumps to the given label based on the value of a boolean expression.
+         * @details At -O1 and above, comparisons, `&&`, `||`, and `!` are lowered directly into conditional jumps
+         *     instead of materializing a boolean on the stack. The stack is left unchanged.
+         *
+         * @param condition The boolean expression to test.
+         * @param jump_when The value of the condition for which to take the jump.
+         * @param label The label to which to jump.
+         * @return The assembly code for the conditional jump.
+         */
+        std::string generate_cond_jump(const std::shared_ptr<ast_node::expr_node>& condition, bool jump_when,
+                                       const std::string& label);
+
+        /**
+         * @brief Generates assembly for an array loop with constant bounds by fully unrolling it.
+         * @details Each copy of the loop body sees its loop variables as integer constants.
+         *
+         * @param expression The array loop expression AST node.
+         * @param bounds The constant bound of each loop variable.
+         * @return The string assembly for the given expression.
+         */
+        std::string generate_unrolled_array_loop(const std::shared_ptr<ast_node::array_loop_expr_node>& expression,
+                                                 const std::vector<long>& bounds);
+
+        /**
+         * @brief Generates assembly for a sum loop with constant bounds by fully unrolling it.
+         * @details Each copy of the loop body sees its loop variables as integer constants.
+         *
+         * @param expression The sum loop expression AST node.
+         * @param bounds The constant bound of each loop variable.
+         * @return The string assembly for the given expression.
+         */
+        std::string generate_unrolled_sum_loop(const std::shared_ptr<ast_node::sum_loop_expr_node>& expression,
+                                               const std::vector<long>& bounds);
+
+        /**
+         * @brief Generates assembly that adds the closed form of an integer sum to the sum on the stack.
+         * @details The loop bounds must be on top of the stack, the first bound lowest, with the sum just above them.
+         *     Each monomial `i^a * j^b` sums to `S_a(N) * S_b(M)`, where `S_0(N) = N`, `S_1(N) = N(N-1)/2`, and
+         *     `S_2(N) = N(N-1)(2N-1)/6`. The divisions are exact, so they are computed modulo 2^64 to keep the
+         *     wraparound of the loop. Leaves the stack unchanged.
+         *
+         * @param polynomial The body of the sum as a polynomial in its loop variables.
+         * @return The assembly code for the closed form.
+         */
+        std::string generate_closed_form_sum(const loop_polynomial& polynomial);
+
+        /**
+         * @brief Generates assembly for an expression whose sibling sum loops are fused, if it has any.
+         * @details At -O2 and above, sum loops in the same expression with identical bounds are computed together in
+         *     one loop before the rest of the expression, which then reads their values back. Only done when fusing
+         *     cannot change which assertion fails first.
+         *
+         * @param expression The expression AST node.
+         * @param assembly Set to the assembly for the whole expression, if any sum loops were fused.
+         * @return True when sum loops were fused; false otherwise.
+         */
+        bool generate_fused_sums(const std::shared_ptr<ast_node::expr_node>& expression, std::string& assembly);
+
+        /**
+         * @brief Generates assembly for an array or sum loop whose body tests a loop-invariant condition.
+         * @details At -O2 and above, the condition is tested once, and the loop is generated twice: once taking each
+         *     arm of the `if` expression. Loops with nested loops or constant bounds are left alone, and the total
+         *     size of the copies is limited by `max_unswitch_size`.
+         *
+         * @param loop The array or sum loop expression AST node.
+         * @param assembly Set to the assembly for the loop, if it was unswitched.
+         * @return True when the loop was unswitched; false otherwise.
+         */
+        bool generate_unswitched_loop(const std::shared_ptr<ast_node::expr_node>& loop, std::string& assembly);
+
+        /**
+         * @brief Generates assembly that slides the given stencil windows to the current loop iteration.
+         * @details At the start of a row (the innermost loop variable is 0), the row address is computed and the
+         *     whole window is loaded; otherwise the window shifts by one element and loads the newest one. Elements
+         *     out of bounds are flagged instead of loaded. Leaves the stack unchanged.
+         *
+         * @param windows The stencil windows.
+         * @param inner_offset The offset from RSP of the innermost loop variable.
+         * @return The assembly code for the update.
+         */
+        std::string generate_window_update(const std::vector<stencil_window>& windows, long inner_offset);
+
+        /**
+         * @brief Generates assembly that computes an element of a fused pipeline stage where it is read.
+         * @details The stage's loop variables are bound to the indices, which are loop variables of the reading
+         *     loop, and the stage's body (or the one field of it that is read) is generated in place. Pushes the
+         *     value.
+         *
+         * @param expression The array index into the stage.
+         * @param stage The loop of the stage.
+         * @param body The part of the stage's body to compute.
+         * @return The assembly code for the value.
+         */
+        std::string generate_stage_element(const std::shared_ptr<ast_node::array_index_expr_node>& expression,
+                                           const std::shared_ptr<ast_node::array_loop_expr_node>& stage,
+                                           const std::shared_ptr<ast_node::expr_node>& body);
+
+        /**
+         * @brief Binds the parameters of the function of a fused call stage to the arguments of its call.
+         * @details Does nothing for a stage that is not a call. Every argument is looked up before any parameter is
+         *     bound, in case the parameters share names with the arguments.
+         *
+         * @param name The name of the stage.
+         */
+        void bind_stage_arguments(const std::string& name);
+
+        /**
+         * @brief Generates assembly that computes sum loops with identical bounds in one loop.
+         * @details Pushes the value of each sum loop, and records it in `fused_sums`.
+         *
+         * @param loops The sum loops.
+         * @return The assembly code for the fused loop.
+         */
+        std::string generate_fused_sum_loop(const std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& loops);
+
+        /**
+         * @brief Generates assembly that computes the address of an array element into RAX.
+         * @details Checks every index against the array bounds. At -O1 and above, an array that is already in memory
+         *     has its header read in place instead of copied onto the stack. A whole-array read in a collapsed loop is
+         *     at the loop's linear index, and needs no checks. For a planar array, RAX holds the address of the
+         *     element's first field, and RCX the distance in bytes between planes. Leaves the stack unchanged.
+         *
+         * @param expression The array index expression AST node.
+         * @return The assembly code for the address computation.
+         */
+        std::string generate_element_address(const std::shared_ptr<ast_node::array_index_expr_node>& expression);
+
+        /**
+         * @brief Generates assembly for the innermost dimension of an array or sum loop, unrolled by the given factor.
+         * @details Runs `unroll_factor` copies of the body per bounds check, then finishes the dimension in a
+         *     remainder loop. Control falls through once the innermost loop variable reaches its bound.
+         *
+         * @param generate_iteration Generates one copy of the loop body, given the index of the copy. The remainder
+         *     loop uses the last copy index.
+         * @param body_start The label at the start of the loop body.
+         * @param unroll_factor The number of copies of the body to run per bounds check.
+         * @param inner_offset The offset from RSP of the innermost loop variable.
+         * @param inner_bound_offset The offset from RSP of the bound of the innermost loop variable.
+         * @param reset_inner Whether to reset the innermost loop variable to 0 once it reaches its bound.
+         * @return The assembly code for the unrolled dimension.
+         */
+        std::string generate_partial_unroll(const std::function<std::string(long)>& generate_iteration,
+                                            const std::string& body_start, long unroll_factor, long inner_offset,
+                                            long inner_bound_offset, bool reset_inner);
+
+        /**
+         * @brief Generates assembly that converts arrays in a value on the stack between the interleaved and planar
+         *     layouts.
+         * @details Each planar array in the value (directly, or in tuple fields) is copied into a new buffer in the
+         *     other layout, and its header is pointed at the copy. Arrays nested in other arrays are never planar, so
+         *     they are left as they are.
+         *
+         * @param type The type of the value.
+         * @param offset The offset of the value from RSP.
+         * @param to_planes Whether to convert from the interleaved layout to planes, rather than back.
+         * @return The assembly code for the conversion.
+         */
+        std::string generate_layout_conversion(const std::shared_ptr<resolved_type::resolved_type>& type, long offset,
+                                               bool to_planes);
 
         /**
          * @brief Generates assembly for a tensor contraction.
@@ -344,11 +980,16 @@ namespace generator {
 
         /**
          * @brief Generates assembly for a single call expression AST node.
+         * @details When a destination is given, the callee writes its array or tuple result straight there, and nothing
+         *     is pushed onto the stack. See `returns_in_memory`.
          *
          * @param expression The call expression AST node.
+         * @param destination If set, generates assembly that loads the destination address into RAX, given the
+         *     number of bytes pushed since the start of the call. It may only clobber RAX, R10, and R11.
          * @return The string assembly for the given expression.
          */
-        std::string generate_expr_call(const std::shared_ptr<ast_node::call_expr_node>& expression);
+        std::string generate_expr_call(const std::shared_ptr<ast_node::call_expr_node>& expression,
+                                       const std::function<std::string(long)>& destination = nullptr);
 
         /**
          * @brief Generates assembly for a single `false` expression AST node.
@@ -451,6 +1092,335 @@ namespace generator {
         void bind_lvalue(const std::shared_ptr<ast_node::lvalue_node>& lvalue,
                          const std::shared_ptr<resolved_type::resolved_type>& r_type);
 
+        /**
+         * @brief Estimates the cost of evaluating the given expression unconditionally.
+         * @details Only expressions that cannot fail (no calls, array accesses, loops, or integer division) are
+         *     eligible for speculation.
+         *
+         * @param expression The expression to check.
+         * @return The number of AST nodes in the expression, or -1 if the expression cannot be speculated.
+         */
+        static long speculation_cost(const std::shared_ptr<ast_node::expr_node>& expression);
+
+        /**
+         * @brief Folds the given integer or boolean expression into a compile-time constant, if possible.
+         * @details Integer literals, constant-propagated values, unrolled loop variables, and integer arithmetic and
+         *     comparisons over them are folded. Booleans fold to 0 or 1. Arithmetic wraps around like the generated
+         *     code would.
+         *
+         * @param expression The expression to fold.
+         * @param value Set to the constant value of the expression, if it can be folded.
+         * @return True when the expression was folded; false otherwise.
+         */
+        bool constant_int_value(const std::shared_ptr<ast_node::expr_node>& expression, long& value) const;
+
+        /**
+         * @brief Determines whether the given expression is constant regardless of the loop around it.
+         * @details Literals and constant variables qualify, as do operators and conditionals over them. Unrolled
+         *     loop variables do not, and neither do comparisons that were only folded inside a peeled or unswitched
+         *     loop.
+         *
+         * @param expression The expression to check.
+         * @return True when the expression is constant regardless of the loop around it; false otherwise.
+         */
+        bool is_source_constant(const std::shared_ptr<ast_node::expr_node>& expression) const;
+
+        /**
+         * @brief Determines the constant bound of each variable of an array or sum loop, for full unrolling.
+         *
+         * @param binding_pairs The bindings of the loop.
+         * @return The bound of each loop variable, or an empty vector if the loop should not be fully unrolled.
+         */
+        std::vector<long> constant_trip_counts(
+                const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& binding_pairs) const;
+
+        /**
+         * @brief Returns the symbol to call for the given call expression.
+         * @details At O2 and above, a call to a JPL function with constant int or bool arguments calls a clone of the
+         *     function specialized on those values, which is generated on first use. Inside the clone the parameters
+         *     are bound as constants, so they fold, unroll loops, and strength-reduce division. At most
+         *     `max_specializations` clones are made per function; later calls use the original. Only arguments
+         *     that pass `is_source_constant` are specialized on, so that a fully unrolled loop does not spend the
+         *     clones on its iterations.
+         *
+         * @param call The call expression.
+         * @return The symbol to call, e.g. `_f` or `_f.spec1`.
+         */
+        std::string callee_symbol(const std::shared_ptr<ast_node::call_expr_node>& call);
+
+        /**
+         * @brief Determines whether the given expression is a call whose result is written through a pointer.
+         * @details Such calls can construct their result directly into its final destination.
+         *
+         * @param expression The expression to check.
+         * @return True when the expression is a call returning through a caller-provided buffer.
+         */
+        bool returns_in_memory(const std::shared_ptr<ast_node::expr_node>& expression) const;
+
+        /**
+         * @brief Determines whether arrays of the given type are stored as one plane per field.
+         * @details Array types that appear as elements of other arrays keep the interleaved layout.
+         *
+         * @param type The type of the array.
+         * @return True when `-fplanar-tuples` is given and the type is an array of tuples of two or more floats.
+         */
+        bool is_planar(const std::shared_ptr<resolved_type::resolved_type>& type) const;
+
+        /**
+         * @brief Determines whether an array element is read from the array itself, rather than from a stencil window
+         *     or by computing a fused pipeline stage.
+         *
+         * @param expression The array index expression.
+         * @return True when the element is read from memory; false otherwise.
+         */
+        bool is_element_in_memory(const std::shared_ptr<ast_node::expr_node>& expression) const;
+
+        /**
+         * @brief Finds the fused pipeline stage read by the given expression.
+         *
+         * @param expression The expression to check.
+         * @return The loop of the stage when the expression indexes one; `nullptr` otherwise.
+         */
+        std::shared_ptr<ast_node::array_loop_expr_node>
+        read_stage(const std::shared_ptr<ast_node::expr_node>& expression) const;
+
+        /**
+         * @brief Determines whether the value of the given expression already lives in memory, and where.
+         * @details Variables and tuple elements of variables can be read in place, as `[reg - offset]` onward,
+         *     without copying the whole value onto the stack.
+         *
+         * @param expression The expression to locate.
+         * @param reg Set to the base of the value (RBP, or the end of the globals block).
+         * @param offset Set to the offset below the base register of the lowest address of the value.
+         * @return True when the value is in memory; false otherwise.
+         */
+        bool memory_operand(const std::shared_ptr<ast_node::expr_node>& expression, std::string& reg,
+                            long& offset) const;
+
+        /**
+         * @brief Determines the factor by which to unroll the innermost dimension of a loop with the given body.
+         *
+         * @param body The body of the array or sum loop.
+         * @return The unroll factor, or 1 if the loop should not be unrolled.
+         */
+        long partial_unroll_factor(const std::shared_ptr<ast_node::expr_node>& body) const;
+
+        /**
+         * @brief Expresses an integer expression as a polynomial of degree at most 2 in each of the given variables.
+         * @details Handles `+`, `-`, `*`, negation, the variables themselves, and unswitched `if` expressions. Any
+         *     other subexpression must not mention the variables and must be safe to evaluate once, as for speculation.
+         *
+         * @param expression The expression to analyze.
+         * @param loop_vars The loop variables.
+         * @param polynomial Set to the polynomial, if the expression has one.
+         * @return True when the expression is such a polynomial; false otherwise.
+         */
+        bool polynomial_form(const std::shared_ptr<ast_node::expr_node>& expression,
+                             const std::vector<std::string>& loop_vars, loop_polynomial& polynomial) const;
+
+        /**
+         * @brief Determines whether a speculable expression mentions any of the given variables.
+         *
+         * @param expression The expression to check.
+         * @param names The variable names.
+         * @return True when the expression may mention one of the variables; false otherwise.
+         */
+        static bool mentions_variable(const std::shared_ptr<ast_node::expr_node>& expression,
+                                      const std::vector<std::string>& names);
+
+        /**
+         * @brief Collects the sum loops that are evaluated unconditionally as part of the given expression.
+         * @details Only looks through literals and operators; loops under conditionals, calls, indices, or other
+         *     loops are left alone, as are sum loops that are already fused or have a closed form.
+         *
+         * @param expression The expression to search.
+         * @param sums Appended with the sum loops found.
+         */
+        void sibling_sums(const std::shared_ptr<ast_node::expr_node>& expression,
+                          std::vector<std::shared_ptr<ast_node::sum_loop_expr_node>>& sums) const;
+
+        /**
+         * @brief Finds the stencil windows of an array loop.
+         * @details At -O2 and above, indices of an array variable whose last index is the innermost loop variable
+         *     plus a constant, and whose other indices are the same safe expressions that do not depend on the
+         *     innermost loop variable, share a window. Only windows read at two or more offsets are kept. Nested
+         *     loops are not searched.
+         *
+         * @param expression The array loop.
+         * @param inner The index of the dimension iterated innermost.
+         * @return The stencil windows, without stack positions.
+         */
+        std::vector<stencil_window>
+        stencil_windows(const std::shared_ptr<ast_node::array_loop_expr_node>& expression, long inner) const;
+
+        /**
+         * @brief Splits the iteration space of an array loop so that comparisons on its loop variables are decided.
+         * @details Comparisons between a loop variable and a constant, or its own bound plus a constant, change value
+         *     only near the ends of the dimension. Peeling those iterations off leaves an interior in which they are
+         *     constants. Each dimension is split into at most a lower border, an interior, and an upper border, which
+         *     run in order, so elements are still computed in the same order.
+         *
+         * @param expression The array loop.
+         * @param peels Set to the number of iterations to peel from the start and the end of each dimension.
+         * @param decided Set to the value of each decided comparison in the interior of each dimension.
+         * @return True when the loop should be split; false otherwise.
+         */
+        bool index_set_split(const std::shared_ptr<ast_node::array_loop_expr_node>& expression,
+                             std::vector<std::pair<long, long>>& peels,
+                             std::vector<std::unordered_map<const ast_node::expr_node*, long>>& decided) const;
+
+        /**
+         * @brief Returns the direct subexpressions of an expression, including the bounds and bodies of loops.
+         *
+         * @param expression The expression.
+         * @return The subexpressions.
+         */
+        static std::vector<std::shared_ptr<ast_node::expr_node>>
+        subexpressions(const std::shared_ptr<ast_node::expr_node>& expression);
+
+        /**
+         * @brief Finds an `if` expression in a loop body whose condition does not depend on the loop.
+         * @details The condition must be safe to evaluate before the loop, and must not be a constant. Nested loops
+         *     are not searched.
+         *
+         * @param body The loop body.
+         * @param loop_vars The loop variables.
+         * @return The `if` expression, or `nullptr` if there is none.
+         */
+        std::shared_ptr<ast_node::if_expr_node> invariant_condition(const std::shared_ptr<ast_node::expr_node>& body,
+                                                                    const std::vector<std::string>& loop_vars) const;
+
+        /**
+         * @brief Determines whether the given expression cannot fail, apart from the given sum loops.
+         *
+         * @param expression The expression to check.
+         * @param excluded The sum loops to ignore.
+         * @return True when nothing else in the expression can fail; false otherwise.
+         */
+        bool cannot_fail_except(const std::shared_ptr<ast_node::expr_node>& expression,
+                                const std::unordered_set<const ast_node::expr_node*>& excluded) const;
+
+        /**
+         * @brief Determines whether the body of a loop cannot fail.
+         * @details Like `speculation_cost`, but also allows array indices at loop variables whose bounds are no
+         *     larger than the indexed dimension (a known size, or the array's own dimension variable), or at
+         *     constants within a known size.
+         *
+         * @param body The body of the loop.
+         * @param bindings The loop variables and their bounds.
+         * @return True when the body cannot fail; false otherwise.
+         */
+        bool loop_body_cannot_fail(
+                const std::shared_ptr<ast_node::expr_node>& body,
+                const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& bindings) const;
+
+        /**
+         * @brief Counts the bytes an array loop body reads per iteration along each of its dimensions.
+         * @details A read counts towards the dimension whose loop variable is its last index, along which
+         *     consecutive iterations read contiguously. Reads in nested loops and of fused pipeline stages are ignored.
+         *
+         * @param expression The array loop.
+         * @return The bytes read per iteration, indexed by dimension.
+         */
+        std::vector<long> contiguous_reads(const std::shared_ptr<ast_node::array_loop_expr_node>& expression) const;
+
+        /**
+         * @brief Reports an optimization of an array loop on standard error, under `-fremarks`.
+         * @details Each optimization is reported once per loop in the source, however often the loop is generated.
+         *
+         * @param loop The array loop.
+         * @param action What was done to the loop, e.g. "interchanged".
+         * @param outcome The rest of the remark, following the loop variables.
+         */
+        void remark(const std::shared_ptr<ast_node::array_loop_expr_node>& loop, const std::string& action,
+                    const std::string& outcome);
+
+        /**
+         * @brief Chooses the dimension of an array loop to iterate innermost.
+         * @details At -O2 and above, the dimension that indexes the last dimension of the arrays read in the body
+         *     (weighted by element size) is moved innermost, when those reads outweigh the writes of the result,
+         *     which are contiguous along the last dimension. Reordering the iterations is only unobservable when the
+         *     body cannot fail.
+         *
+         * @param expression The array loop.
+         * @return The index of the dimension to iterate innermost; the last one when the loop is left as is.
+         */
+        long interchanged_dimension(const std::shared_ptr<ast_node::array_loop_expr_node>& expression) const;
+
+        /**
+         * @brief Chooses a dimension of an array loop to iterate in tiles together with its innermost dimension.
+         * @details At -O2 and above, when the body reads (or the result is written) contiguously along another
+         *     dimension than the innermost one, the two dimensions run in square tiles, so that both streams stay in
+         *     cache while a tile is processed. The tile size is the largest power of two for which one tile of each
+         *     stream fits in the `-ftile-budget` cache budget. Like interchange, this requires a body that cannot
+         *     fail.
+         *
+         * @param expression The array loop.
+         * @param inner The dimension iterated innermost.
+         * @param tile Set to the number of iterations along each tiled dimension per tile.
+         * @return The dimension to tile with the innermost one, or -1 when the loop is not tiled.
+         */
+        long tiled_dimension(const std::shared_ptr<ast_node::array_loop_expr_node>& expression, long inner,
+                             long& tile) const;
+
+        /**
+         * @brief Determines whether an array loop can run as a single loop over all of its elements.
+         * @details At -O2 and above, a loop of rank 2 or more whose body only uses its loop variables to index arrays
+         *     of the loop's own shape, at exactly `[i, j, ...]`, needs no per-dimension counters: those elements are
+         *     at the same linear index as the element being written. The iteration order is unchanged.
+         *
+         * @param expression The array loop.
+         * @param reads Filled with the whole-array reads, which are read at the linear index.
+         * @return True when the loop can be collapsed; false otherwise.
+         */
+        bool collapsible_loop(const std::shared_ptr<ast_node::array_loop_expr_node>& expression,
+                              std::vector<std::shared_ptr<ast_node::array_index_expr_node>>& reads) const;
+
+        /**
+         * @brief Determines whether an array index reads an array of a loop's shape at exactly its loop variables.
+         * @details Each bound must be the variable holding the matching dimension of the array, or a constant equal
+         *     to its known dimension, and the array must be in memory.
+         *
+         * @param array_index The array index expression.
+         * @param bindings The loop variables and their bounds, outermost first.
+         * @return True when the read is of the element at the loop's linear index; false otherwise.
+         */
+        bool is_whole_array_read(
+                const std::shared_ptr<ast_node::array_index_expr_node>& array_index,
+                const std::vector<std::tuple<token::token, std::shared_ptr<ast_node::expr_node>>>& bindings) const;
+
+        /**
+         * @brief Determines whether two expressions are structurally identical, and so have the same value.
+         * @details Only literals, variables, and operators over them are compared.
+         *
+         * @param first The first expression.
+         * @param second The second expression.
+         * @return True when the expressions are identical; false otherwise.
+         */
+        static bool same_expression(const std::shared_ptr<ast_node::expr_node>& first,
+                                    const std::shared_ptr<ast_node::expr_node>& second);
+
+        /**
+         * @brief Estimates the size of the code generated for the given expression, in AST nodes.
+         * @details Nested loops count as `nested_loop_size`, and so does any expression at least that large.
+         *
+         * @param expression The expression to measure.
+         * @return The number of AST nodes in the expression, at most `nested_loop_size`.
+         */
+        static long expression_size(const std::shared_ptr<ast_node::expr_node>& expression);
+
+        /**
+         * @brief Computes the magic multiplier and shift for signed division by the given constant.
+         * @details See Hacker's Delight, section 10-4. The quotient of `x / divisor` is the high 64 bits of
+         *     `x * multiplier`, corrected by `x` when the signs of the multiplier and divisor differ, shifted right
+         *     arithmetically by `shift`, plus 1 if that result is negative.
+         *
+         * @param divisor The divisor. Its absolute value must be at least 2.
+         * @param multiplier Set to the magic multiplier.
+         * @param shift Set to the shift amount.
+         */
+        static void division_magic(long divisor, long& multiplier, long& shift);
+
         /**
          * @brief Reports whether the given integer fits into 32 bits.
          *
@@ -474,16 +1444,22 @@ namespace generator {
          * @param global_symbol_table A pointer to the global symbol table.
          * @param constants A pointer to the global constants table.
          * @param function_signatures A pointer to the set of function signatures.
+         * @param specializations A pointer to the table of functions and their specialized clones.
+         * @param shared_state A pointer to the state shared by every generator.
          * @param parent_variable_table A pointer to the parent generator's variable table.
          *     Use `nullptr` if there is no parent.
          * @param debug Whether to generate extra debugging output.
          * @param opt_level The optimization level for the generated assembly.
+         * @param flags Fine-grained code generation options.
          */
         generator(const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
                   const std::shared_ptr<const_table>& constants,
                   const std::shared_ptr<std::unordered_map<std::string, call_signature::call_signature>>&
                           function_signatures,
-                  const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level);
+                  const std::shared_ptr<specialization_table>& specializations,
+                  const std::shared_ptr<shared_generator_state>& shared_state,
+                  const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level,
+                  const generator_flags& flags);
 
         /**
          * @brief Class destructor.
@@ -517,6 +1493,60 @@ namespace generator {
          */
         long rbp_offset;
 
+        /**
+         * @brief The registers holding the return value, when an array or tuple is returned in registers.
+         *
+         */
+        call_signature::call_signature::register_list ret_registers;
+
+        /**
+         * @brief The name of the function being generated.
+         *
+         */
+        std::string function_name;
+
+        /**
+         * @brief The symbol that calls to this function (or this clone) jump to.
+         *
+         */
+        std::string symbol;
+
+        /**
+         * @brief The number of bytes of arguments the caller passed on the stack.
+         *
+         */
+        unsigned int stack_arg_bytes;
+
+        /**
+         * @brief The home of each argument, as an offset below RBP of its lowest address.
+         *
+         */
+        std::vector<long> arg_homes;
+
+        /**
+         * @brief The label just after the arguments are bound, where self tail calls jump back to.
+         *
+         */
+        std::string body_label;
+
+        /**
+         * @brief The size of the stack at `body_label`.
+         *
+         */
+        unsigned int body_stack_size;
+
+        /**
+         * @brief Assembly for this function's `.bss` reservations, such as a memoization cache.
+         *
+         */
+        std::stringstream bss_assembly;
+
+        /**
+         * @brief The number of entries in a memoization cache. Must be a power of two.
+         *
+         */
+        static constexpr long memo_cache_entries = 1024;
+
         //  Statements:
         //  -----------
 
@@ -555,15 +1585,69 @@ namespace generator {
         //  Misc. methods:
         //  --------------
 
+        /**
+         * @brief Generates assembly that returns the value of the given expression.
+         * @details At O1 and above, an `if` with a tail call in either arm is split into two returns, so that each tail
+         *     call can be generated as a jump.
+         *
+         * @param return_val The expression to return.
+         */
+        void generate_return(const std::shared_ptr<ast_node::expr_node>& return_val);
+
+        /**
+         * @brief Determines whether a call in tail position can reuse the current frame.
+         * @details Self calls always can; other calls can when their stack arguments fit in the space this function's
+         *     caller provided.
+         *
+         * @param expression The returned expression.
+         * @return True when the expression is a call that can be generated as a jump.
+         */
+        bool is_tail_call(const std::shared_ptr<ast_node::expr_node>& expression) const;
+
+        /**
+         * @brief Determines whether the given returned expression contains a tail call, through `if` arms.
+         *
+         * @param expression The returned expression.
+         * @return True when `generate_return` will generate a jump for some path through the expression.
+         */
+        bool has_tail_call(const std::shared_ptr<ast_node::expr_node>& expression) const;
+
+        /**
+         * @brief Generates a call in tail position as a jump.
+         * @details Self calls store the new arguments into the argument homes and jump back to `body_label`, which
+         *     turns self recursion into a loop. Other calls move their stack arguments over this function's own, tear
+         *     down the frame, and jump to the callee.
+         *
+         * @param call The call expression, which must satisfy `is_tail_call`.
+         */
+        void generate_tail_call(const std::shared_ptr<ast_node::call_expr_node>& call);
+
+        /**
+         * @brief Generates the entry point of a memoized function, which looks its arguments up in a cache.
+         * @details The cache is direct-mapped, with `memo_cache_entries` entries of {valid, arguments..., result},
+         *     indexed by a multiplicative hash of the argument bits. A miss calls the uncached function body and fills
+         *     the entry. Under `-fmemo-stats`, hits and misses are counted in the global data symbols
+         *     `jpl_memo_<fn>_hits` and `jpl_memo_<fn>_misses`, which the main program reports when it finishes.
+         *
+         * @param name The name of the function.
+         * @param call_sig The call signature of the function.
+         * @param body_name The label of the uncached function body.
+         */
+        void generate_memo_wrapper(const std::string& name, const call_signature::call_signature& call_sig,
+                                   const std::string& body_name);
+
         /**
          * @brief Handles a single register binding as a function argument.
+         * @details Arrays and tuples passed under the private convention are spilled into one contiguous block, so they
+         *     are laid out exactly as if they had been passed on the stack.
          *
          * @param binding The binding to handle.
          * @param r_type The resolved type of the argument.
-         * @param reg The name of the register.
+         * @param registers The registers holding the argument, as {byte offset, register} pairs.
          */
         void handle_reg_binding(const std::shared_ptr<ast_node::binding_node>& binding,
-                                const std::shared_ptr<resolved_type::resolved_type>& r_type, const std::string& reg);
+                                const std::shared_ptr<resolved_type::resolved_type>& r_type,
+                                const call_signature::call_signature::register_list& registers);
 
         /**
          * @brief Handles a single stack binding as a function argument.
@@ -582,16 +1666,26 @@ namespace generator {
          * @param function The `fn` AST node.
          * @param constants A pointer to the global constants table.
          * @param function_signatures A pointer to the set of function signatures.
+         * @param specializations A pointer to the table of functions and their specialized clones.
+         * @param shared_state A pointer to the state shared by every generator.
          * @param parent_variable_table A pointer to the parent generator's variable table.
          * @param debug Whether to generate extra debugging output.
          * @param opt_level The optimization level for the generated assembly.
+         * @param flags Fine-grained code generation options.
+         * @param constant_params For a specialized clone, the parameters known to be constant, with their values.
+         * @param symbol For a specialized clone, its symbol. Use the empty string for the function itself.
          */
         fn_generator(const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
                      const std::shared_ptr<ast_node::fn_cmd_node>& function,
                      const std::shared_ptr<const_table>& constants,
                      const std::shared_ptr<std::unordered_map<std::string, call_signature::call_signature>>&
                              function_signatures,
-                     const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level);
+                     const std::shared_ptr<specialization_table>& specializations,
+                     const std::shared_ptr<shared_generator_state>& shared_state,
+                     const std::shared_ptr<variable_table>& parent_variable_table, bool debug, unsigned int opt_level,
+                     const generator_flags& flags,
+                     const std::vector<std::pair<std::string, long>>& constant_params = {},
+                     const std::string& symbol = "");
 
         /**
          * @brief Returns the assembly generated by this instance.
@@ -599,6 +1693,13 @@ namespace generator {
          * @return The (string) assembly generated by this instance.
          */
         [[nodiscard]] std::string assem() const override;
+
+        /**
+         * @brief Returns the `.bss` reservations needed by the assembly generated by this instance.
+         *
+         * @return The (string) assembly to place in the `.bss` section.
+         */
+        [[nodiscard]] std::string bss_assem() const;
     };
 
     /**
@@ -607,6 +1708,30 @@ namespace generator {
      */
     class main_generator : public generator {
     private:
+        /**
+         * @brief A point-wise read of a pipeline stage.
+         *
+         */
+        struct stage_use {
+            /**
+             * @brief The indexing expression that reads the stage.
+             *
+             */
+            std::shared_ptr<ast_node::array_index_expr_node> array_index;
+
+            /**
+             * @brief The array loop the read is in.
+             *
+             */
+            std::shared_ptr<ast_node::array_loop_expr_node> loop;
+
+            /**
+             * @brief The tuple field read, or -1 for the whole element.
+             *
+             */
+            long field;
+        };
+
         /**
          * @brief The header linking preface.
          *
@@ -631,6 +1756,32 @@ namespace generator {
          */
         std::vector<std::string> function_assemblies;
 
+        /**
+         * @brief The `.bss` reservations needed by the functions defined in the program.
+         *
+         */
+        std::stringstream function_bss_assembly;
+
+        /**
+         * @brief The total size of the top-level bindings stored in the `.bss` section.
+         *
+         */
+        long globals_size;
+
+        /**
+         * @brief The dimension variables of the top-level arrays bound by array arguments, by array name.
+         * @details A call stage bound without them has those of the arguments that bound its loop, if any.
+         *
+         */
+        std::unordered_map<std::string, std::vector<std::string>> array_dimensions;
+
+        /**
+         * @brief The array loops bound by top-level `let` commands, by variable name.
+         * @details The loop of a call in `stage_calls` is the one its function returns.
+         *
+         */
+        std::unordered_map<std::string, std::shared_ptr<ast_node::array_loop_expr_node>> array_loops;
+
         //  Commands:
         //  ---------
 
@@ -707,6 +1858,121 @@ namespace generator {
         //  Misc. methods:
         //  --------------
 
+        /**
+         * @brief Binds a value already stored in the globals block to the given lvalue.
+         *
+         * @param lvalue The lvalue to bind.
+         * @param r_type The type of the value.
+         * @param offset The offset from the end of the globals block of the lowest address of the value.
+         */
+        void bind_global_lvalue(const std::shared_ptr<ast_node::lvalue_node>& lvalue,
+                                const std::shared_ptr<resolved_type::resolved_type>& r_type, long offset);
+
+        /**
+         * @brief Binds a value already stored in the globals block to the given argument.
+         *
+         * @param argument The argument to bind.
+         * @param offset The offset from the end of the globals block of the lowest address of the value.
+         */
+        void bind_global_argument(const std::shared_ptr<ast_node::argument_node>& argument, long offset);
+
+        /**
+         * @brief Finds the top-level arrays to fuse into the loops that read them, filling `pipeline_stages`.
+         * @details At -O2 and above, an array bound by a top-level `let` to an array loop whose body cannot fail is
+         *     fused when the rest of the program reads it only point-wise: indexed by exactly the variables of an
+         *     array loop that is not nested in another loop or a function. It may be read once, or once per field
+         *     when its body is a tuple literal. Its body is then computed where it is read, and only its header is
+         *     stored. A `let` of a call to a function whose body is only `return array[...]`, with arguments that
+         *     are variables or constants, is a stage too: the function's loop is computed in its place, with the
+         *     parameters bound to the arguments.
+         *
+         */
+        void find_pipeline_stages();
+
+        /**
+         * @brief Finds the top-level variables that hold the dimensions of a call stage.
+         * @details A bound of the function's loop that is a parameter, or a dimension variable of an array
+         *     parameter, is held by the argument or by the argument's dimension variable.
+         *
+         * @param name The name of the call stage.
+         * @return The variable of each dimension, or an empty name when it is unknown.
+         */
+        [[nodiscard]] std::vector<std::string> call_stage_dimensions(const std::string& name) const;
+
+        /**
+         * @brief Finds the array types nested in other arrays in a command, filling `interleaved_arrays`.
+         *
+         * @param command The command to search.
+         */
+        void find_interleaved_arrays(const std::shared_ptr<ast_node::cmd_node>& command);
+
+        /**
+         * @brief Finds the array types nested in other arrays in an expression, filling `interleaved_arrays`.
+         *
+         * @param expression The expression to search.
+         */
+        void find_interleaved_arrays(const std::shared_ptr<ast_node::expr_node>& expression);
+
+        /**
+         * @brief Determines whether the body of a pipeline stage cannot fail.
+         * @details Like `cannot_fail_except`, but also allows built-in functions and indices known to be in bounds.
+         *
+         * @param expression The expression to check.
+         * @param loop The loop of the stage.
+         * @return True when the expression cannot fail; false otherwise.
+         */
+        bool stage_cannot_fail(const std::shared_ptr<ast_node::expr_node>& expression,
+                               const std::shared_ptr<ast_node::array_loop_expr_node>& loop) const;
+
+        /**
+         * @brief Determines whether an array index by the variables of the given loop is known to be in bounds.
+         * @details Each bound must be a constant no larger than the known dimension, the dimension variable of the
+         *     array, or the same expression as the bound of the loop that built the array.
+         *
+         * @param array_index The array index expression.
+         * @param loop The loop whose variables index the array.
+         * @return True when the index is in bounds; false otherwise.
+         */
+        bool stage_index_in_bounds(const std::shared_ptr<ast_node::array_index_expr_node>& array_index,
+                                   const std::shared_ptr<ast_node::array_loop_expr_node>& loop) const;
+
+        /**
+         * @brief Collects the point-wise reads of the given array in a command.
+         * @details Functions are not inlined, so any mention in a function counts as a read that is not point-wise.
+         *
+         * @param command The command to search.
+         * @param name The name of the array.
+         * @param uses Appended with each point-wise read.
+         * @return True when every mention of the array is a point-wise read; false otherwise.
+         */
+        bool stage_uses(const std::shared_ptr<ast_node::cmd_node>& command, const std::string& name,
+                        std::vector<stage_use>& uses) const;
+
+        /**
+         * @brief Collects the point-wise reads of the given array in an expression.
+         *
+         * @param expression The expression to search.
+         * @param name The name of the array.
+         * @param loop The innermost enclosing array loop, or `nullptr` inside a sum loop.
+         * @param depth The number of enclosing loops.
+         * @param field The tuple field read from the expression, or -1.
+         * @param uses Appended with each point-wise read.
+         * @return True when every mention of the array is a point-wise read; false otherwise.
+         */
+        bool stage_uses(const std::shared_ptr<ast_node::expr_node>& expression, const std::string& name,
+                        const std::shared_ptr<ast_node::array_loop_expr_node>& loop, long depth, long field,
+                        std::vector<stage_use>& uses) const;
+
+        /**
+         * @brief Generates assembly that reports the cache hits and misses of every memoized function.
+         * @details Runs when the main program finishes, under `-fmemo-stats`. Each function writes a
+         *     `memoized <fn>: <hits> hits, <misses> misses` line to standard error, so that the program's own output
+         *     is unchanged. The runtime cannot write there, so the lines are formatted by `jpl_memo.report`, which
+         *     this also generates, and written with the `write` system call.
+         *
+         */
+        void generate_memo_stats();
+
         /**
          * @brief Generates the header linking preface for a JPL program.
          *
@@ -727,9 +1993,11 @@ namespace generator {
          * @param nodes The set of command nodes that compose the program.
          * @param debug Whether to generate extra debug output.
          * @param opt_level The optimization level for the generated assembly.
+         * @param flags Fine-grained code generation options.
          */
         main_generator(const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
-                       const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes, bool debug, unsigned opt_level);
+                       const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes, bool debug, unsigned opt_level,
+                       const generator_flags& flags);
 
         /**
          * @brief Returns the assembly generated by this instance.
@@ -746,11 +2014,12 @@ namespace generator {
      * @param nodes The set of AST nodes for which to generate the assembly.
      * @param debug Whether to generate extra comments for debugging.
      * @param opt_level The optimization level for the generated assembly.
+     * @param flags Fine-grained code generation options.
      * @return The string assembly output.
      */
     std::string generate(const std::shared_ptr<symbol_table::symbol_table>& global_symbol_table,
                          const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes, bool debug,
-                         unsigned int opt_level);
+                         unsigned int opt_level, const generator_flags& flags = {});
 }  //  namespace generator
 
 #endif
@@ -80,22 +80,24 @@ int lex_parse_and_check_only(const std::string& filename) {
  * @param filename The file to read.
  * @param debug Whether to include extra debugging output.
  * @param opt_level The optimization level of the assembly output.
+ * @param flags Fine-grained code generation options.
  * @return 0 on success; an exception is thrown otherwise.
  */
-int lex_parse_check_and_generate_only(const std::string& filename, bool debug, unsigned int opt_level) {
+int lex_parse_check_and_generate_only(const std::string& filename, bool debug, unsigned int opt_level,
+                                      const generator::generator_flags& flags) {
     const lexer::token_list_t tokens = lexer::lex_all(file::read_file(filename));
     const std::vector<parser::node_ptr_t> nodes = parser::parse(tokens);
     const symbol_table::symbol_table global_symbol_table = type_checker::check(nodes);
     if (opt_level >= 2) {
         visitor::const_prop_visitor const_prop;
-        for (const parser::node_ptr_t& node : nodes) { const_prop.visit_node(node); }
+        const_prop.propagate(nodes);
     }
     if (opt_level >= 3) {
         visitor::tensor_contraction_visitor tensor_contraction;
         for (const parser::node_ptr_t& node : nodes) { tensor_contraction.visit_node(node); }
     }
     std::cout << generator::generate(std::make_shared<symbol_table::symbol_table>(global_symbol_table), nodes, debug,
-                                     opt_level);
+                                     opt_level, flags);
 
     std::cout << "Compilation succeeded: assembly complete\n";
 
@@ -118,6 +120,7 @@ int main(int argc, char** argv) {
     bool o1_flag = false;
     bool o2_flag = false;
     bool o3_flag = false;
+    generator::generator_flags flags;
 
     for (unsigned int index = 1; index < (unsigned int)argc; index++) {
         const std::string arg(argv[index]);
@@ -136,7 +139,31 @@ int main(int argc, char** argv) {
             o2_flag = true;
         else if (arg == "-O3")
             o3_flag = true;
-        else
+        else if (arg.rfind("-funroll=", 0) == 0) {
+            const std::string factor = arg.substr(std::string("-funroll=").size());
+            if (factor.empty() || factor.size() > 3 || factor.find_first_not_of("0123456789") != std::string::npos) {
+                std::cout << "Compilation failed\n";
+                return 1;
+            }
+            flags.unroll_factor = (unsigned int)std::stoul(factor);
+        } else if (arg == "-ffast-math")
+            flags.fast_math = true;
+        else if (arg.rfind("-fmemoize=", 0) == 0)
+            flags.memoize.insert(arg.substr(std::string("-fmemoize=").size()));
+        else if (arg == "-fmemo-stats")
+            flags.memo_stats = true;
+        else if (arg == "-fremarks")
+            flags.remarks = true;
+        else if (arg == "-fplanar-tuples")
+            flags.planar_tuples = true;
+        else if (arg.rfind("-ftile-budget=", 0) == 0) {
+            const std::string budget = arg.substr(std::string("-ftile-budget=").size());
+            if (budget.empty() || budget.size() > 9 || budget.find_first_not_of("0123456789") != std::string::npos) {
+                std::cout << "Compilation failed\n";
+                return 1;
+            }
+            flags.tile_budget = std::stoul(budget);
+        } else
             filename = arg;
     }
 
@@ -153,7 +180,7 @@ int main(int argc, char** argv) {
 
     try {
         if (lex_parse_check_and_generate_only_flag)
-            return lex_parse_check_and_generate_only(filename, debug, opt_level);
+            return lex_parse_check_and_generate_only(filename, debug, opt_level, flags);
         if (lex_parse_and_check_only_flag) return lex_parse_and_check_only(filename);
         if (lex_and_parse_only_flag) return lex_and_parse_only(filename);
         if (lex_only_flag) return lex_only(filename);
@@ -2,13 +2,11 @@
  * @file stack_info.hpp
  * @package Assignments 9-10
  * @author Cayden Lund (u1182408)
- * @brief Defines the `stack_info` class and associated subtypes.
+ * @brief Defines the `stack_info` class.
  *
  */
 
-#include <memory>
-#include <string>
-#include <unordered_map>
+#include <vector>
 
 namespace stack_info {
     /**
@@ -17,71 +15,6 @@ namespace stack_info {
      */
     class stack_info {
     private:
-        /**
-         * @brief An integer stack.
-         *
-         */
-        class int_stack {
-        private:
-            /**
-             * @brief A data node.
-             *
-             */
-            struct node {
-                /**
-                 * @brief A pointer to the next node, or `nullptr`.
-                 *
-                 */
-                std::unique_ptr<node> last;
-
-                /**
-                 * @brief The value of this node.
-                 *
-                 */
-                const unsigned int value;
-            };
-
-            /**
-             * @brief A pointer to the top of the stack, or nullptr.
-             *
-             */
-            std::unique_ptr<node> last;
-
-            /**
-             * @brief The total of the elements in the stack.
-             *
-             */
-            unsigned int total;
-
-        public:
-            /**
-             * @brief Class constructor.
-             *
-             */
-            int_stack();
-
-            /**
-             * @brief Reports the total of the elements in the stack.
-             *
-             * @return The total of the elements in the stack.
-             */
-            [[nodiscard]] unsigned int get_total() const;
-
-            /**
-             * @brief Pops the top element from the stack.
-             *
-             * @return The value of the top element on the stack.
-             */
-            unsigned int pop();
-
-            /**
-             * @brief Pushes a value onto the stack.
-             *
-             * @param value The value to push onto the stack.
-             */
-            void push(unsigned int value);
-        };
-
         /**
          * @brief The default number of bytes to push onto the stack.
          *
@@ -95,18 +28,28 @@ namespace stack_info {
         static constexpr unsigned int stack_alignment = 16;
 
         /**
-         * @brief The stack of integers.
+         * @brief The size of each block pushed onto the stack, from the bottom up.
+         *
+         */
+        std::vector<unsigned int> blocks;
+
+        /**
+         * @brief The total of the sizes in `blocks`.
          *
          */
-        int_stack stack;
+        unsigned int total = 0;
 
     public:
         /**
-         * @brief Reports whether the stack needs to be 16-byte aligned.
+         * @brief Reports how many bytes of padding align the stack for a call.
+         * @details This is the only place where the code generator decides on alignment padding.
          *
-         * @return True if the stack needs to be 16-byte aligned.
+         * @param num_bytes The number of bytes that will be pushed after the padding and before the call, such as
+         *     stack arguments. Defaults to 0.
+         * @return The number of bytes of padding to push before those bytes, so that the stack is 16-byte aligned
+         *     at the call.
          */
-        [[nodiscard]] bool needs_alignment() const;
+        [[nodiscard]] unsigned int alignment_padding(unsigned int num_bytes = 0) const;
 
         /**
          * @brief Pops the top value from the stack.
@@ -10,6 +10,125 @@
 
 namespace visitor {
 
+    void const_prop_visitor::propagate(const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes) {
+        std::vector<std::pair<std::shared_ptr<ast_node::fn_cmd_node>,
+                              std::unordered_map<std::string, ast_node::cp_value>>>
+                functions;
+
+        for (const std::shared_ptr<ast_node::ast_node>& node : nodes) {
+            if (node->type != ast_node::node_type::FN_CMD) {
+                this->visit_node(node);
+                continue;
+            }
+
+            //  Bindings inside a function must not leak into the rest of the program.
+            const std::shared_ptr<ast_node::fn_cmd_node> function
+                    = std::reinterpret_pointer_cast<ast_node::fn_cmd_node>(node);
+            functions.emplace_back(function, this->context);
+
+            this->current_function = function->name;
+            this->bind_parameters(function, {});
+            this->visit_node(function);
+            this->context = functions.back().second;
+            this->current_function.clear();
+        }
+
+        //  A function can only be called after it is defined, so every caller of a function comes later.
+        for (auto function = functions.rbegin(); function != functions.rend(); ++function) {
+            std::vector<ast_node::cp_value> values;
+            if (!this->call_site_values(function->first, values)) continue;
+
+            this->context = function->second;
+            this->current_function = function->first->name;
+            this->bind_parameters(function->first, values);
+            this->visit_node(function->first);
+        }
+
+        this->current_function.clear();
+    }
+
+    ast_node::cp_value const_prop_visitor::meet(const ast_node::cp_value& left, const ast_node::cp_value& right) {
+        if (left.type != right.type) return {};
+
+        switch (left.type) {
+            case ast_node::INT_VALUE:
+                return (left.int_value == right.int_value) ? left : ast_node::cp_value();
+            case ast_node::ARRAY_VALUE: {
+                if (left.array_value.size() != right.array_value.size()) return {};
+
+                std::vector<ast_node::cp_value> dims;
+                for (unsigned long index = 0; index < left.array_value.size(); ++index) {
+                    dims.emplace_back(const_prop_visitor::meet(left.array_value[index], right.array_value[index]));
+                }
+                return dims;
+            }
+            default:
+                return {};
+        }
+    }
+
+    void const_prop_visitor::bind_parameters(const std::shared_ptr<ast_node::fn_cmd_node>& function,
+                                             const std::vector<ast_node::cp_value>& values) {
+        for (unsigned long index = 0; index < function->bindings.size(); ++index) {
+            if (function->bindings[index]->type != ast_node::node_type::VAR_BINDING) continue;
+
+            const ast_node::cp_value value = (index < values.size()) ? values[index] : ast_node::cp_value();
+            const std::shared_ptr<ast_node::argument_node> argument
+                    = std::reinterpret_pointer_cast<ast_node::var_binding_node>(function->bindings[index])->binding_arg;
+
+            if (argument->type == ast_node::node_type::VARIABLE_ARGUMENT) {
+                this->context[std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name] = value;
+            } else if (argument->type == ast_node::node_type::ARRAY_ARGUMENT) {
+                const std::shared_ptr<ast_node::array_argument_node> array_argument
+                        = std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument);
+
+                this->context[array_argument->name] = value;
+                for (unsigned long dim = 0; dim < array_argument->dimension_vars.size(); ++dim) {
+                    this->context[array_argument->dimension_vars[dim].text]
+                            = (dim < value.array_value.size()) ? value.array_value[dim] : ast_node::cp_value();
+                }
+            }
+        }
+    }
+
+    bool const_prop_visitor::call_site_values(const std::shared_ptr<ast_node::fn_cmd_node>& function,
+                                              std::vector<ast_node::cp_value>& values) const {
+        const auto function_calls = this->calls.find(function->name);
+        if (function_calls == this->calls.end() || function_calls->second.empty()) return false;
+
+        //  Whether some call site has constrained each parameter yet.
+        std::vector<bool> constrained(function->bindings.size(), false);
+        values.assign(function->bindings.size(), ast_node::cp_value());
+
+        for (const std::pair<std::shared_ptr<ast_node::call_expr_node>, std::string>& call : function_calls->second) {
+            for (unsigned long index = 0; index < call.first->call_args.size() && index < values.size(); ++index) {
+                const std::shared_ptr<ast_node::expr_node>& arg = call.first->call_args[index];
+
+                if (call.second == function->name && arg->type == ast_node::node_type::VARIABLE_EXPR
+                    && function->bindings[index]->type == ast_node::node_type::VAR_BINDING) {
+                    const std::shared_ptr<ast_node::argument_node> argument
+                            = std::reinterpret_pointer_cast<ast_node::var_binding_node>(function->bindings[index])
+                                      ->binding_arg;
+                    const std::string& arg_name
+                            = std::reinterpret_pointer_cast<ast_node::variable_expr_node>(arg)->name;
+                    const bool is_pass_through
+                            = (argument->type == ast_node::node_type::VARIABLE_ARGUMENT
+                               && std::reinterpret_pointer_cast<ast_node::variable_argument_node>(argument)->name
+                                          == arg_name)
+                           || (argument->type == ast_node::node_type::ARRAY_ARGUMENT
+                               && std::reinterpret_pointer_cast<ast_node::array_argument_node>(argument)->name
+                                          == arg_name);
+                    if (is_pass_through) continue;
+                }
+
+                values[index] = constrained[index] ? const_prop_visitor::meet(values[index], arg->cp_val) : arg->cp_val;
+                constrained[index] = true;
+            }
+        }
+
+        return true;
+    }
+
     std::shared_ptr<ast_node::ast_node>
     const_prop_visitor::handle_node(const std::shared_ptr<ast_node::ast_node>& node) {
         switch (node->type) {
@@ -23,6 +142,8 @@ namespace visitor {
             case ast_node::ARRAY_LOOP_EXPR:
                 return this->handle_node_expr_array_loop(
                         std::reinterpret_pointer_cast<ast_node::array_loop_expr_node>(node));
+            case ast_node::CALL_EXPR:
+                return this->handle_node_expr_call(std::reinterpret_pointer_cast<ast_node::call_expr_node>(node));
             case ast_node::INTEGER_EXPR:
                 return this->handle_node_expr_integer(std::reinterpret_pointer_cast<ast_node::integer_expr_node>(node));
             case ast_node::VARIABLE_EXPR:
@@ -106,6 +227,15 @@ namespace visitor {
         return {};
     }
 
+    std::shared_ptr<ast_node::ast_node>
+    const_prop_visitor::handle_node_expr_call(const std::shared_ptr<ast_node::call_expr_node>& node) {
+        if (this->recorded_calls.insert(node.get()).second) {
+            this->calls[node->name].emplace_back(node, this->current_function);
+        }
+
+        return {};
+    }
+
     std::shared_ptr<ast_node::ast_node>
     const_prop_visitor::handle_node_expr_integer(  //  NOLINT(readability-convert-member-functions-to-static)
             const std::shared_ptr<ast_node::integer_expr_node>& node) {
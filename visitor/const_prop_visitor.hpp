@@ -11,7 +11,11 @@
 #include "ast_node/ast_node.hpp"
 #include "visitor.hpp"
 
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace visitor {
 
@@ -21,6 +25,17 @@ namespace visitor {
      */
     class const_prop_visitor : public visitor {
     public:
+        /**
+         * @brief Propagates constants through a whole program.
+         * @details Each function is first visited with its parameters unknown. Then, from the last function to the
+         *     first (so every caller of a function has already been refined), the parameters are seeded with the meet
+         *     of the values passed at every call site, and the function is visited again. This gives callees the array
+         *     shapes, and thus the dimension variables, that all of their callers agree on.
+         *
+         * @param nodes The top-level commands of the program.
+         */
+        void propagate(const std::vector<std::shared_ptr<ast_node::ast_node>>& nodes);
+
         /**
          * @brief Visits the given AST node.
          *
@@ -36,6 +51,64 @@ namespace visitor {
          */
         std::unordered_map<std::string, ast_node::cp_value> context;
 
+        /**
+         * @brief The function whose body is being visited, or the empty string at the top level.
+         *
+         */
+        std::string current_function;
+
+        /**
+         * @brief Every call to a function, with the name of the function it appears in.
+         *
+         */
+        std::unordered_map<std::string,
+                           std::vector<std::pair<std::shared_ptr<ast_node::call_expr_node>, std::string>>>
+                calls;
+
+        /**
+         * @brief The calls already recorded in `calls`, since a function may be visited more than once.
+         *
+         */
+        std::unordered_set<const ast_node::call_expr_node*> recorded_calls;
+
+        /**
+         * @brief Combines two values that may flow into the same place, keeping only what they agree on.
+         *
+         * @param left The first value.
+         * @param right The second value.
+         * @return The most precise value true of both.
+         */
+        static ast_node::cp_value meet(const ast_node::cp_value& left, const ast_node::cp_value& right);
+
+        /**
+         * @brief Binds the parameters of the given function in the context.
+         *
+         * @param function The function.
+         * @param values The value of each parameter; unknown values may be omitted from the end.
+         */
+        void bind_parameters(const std::shared_ptr<ast_node::fn_cmd_node>& function,
+                             const std::vector<ast_node::cp_value>& values);
+
+        /**
+         * @brief Computes the meet of the arguments passed to the given function at every call site.
+         * @details A recursive call that passes a parameter straight through does not constrain it.
+         *
+         * @param function The function.
+         * @param values Set to the value of each parameter.
+         * @return True when the function is called at all; false otherwise.
+         */
+        bool call_site_values(const std::shared_ptr<ast_node::fn_cmd_node>& function,
+                              std::vector<ast_node::cp_value>& values) const;
+
+        /**
+         * @brief Handles the given call expression node.
+         *
+         * @param node The node to handle.
+         * @return A new node if a change was made; null otherwise.
+         */
+        std::shared_ptr<ast_node::ast_node>
+        handle_node_expr_call(const std::shared_ptr<ast_node::call_expr_node>& node);
+
         /**
          * @brief Handles the given `let` command node.
          *